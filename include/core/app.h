@@ -3,20 +3,46 @@
 
 #include <SDL2/SDL.h>
 #include <core/chip8.h>
+#include <core/chip8_audio.h>
+#include <core/chip8_display.h>
+#include <core/chip8_movie.h>
+#include <core/chip8_rewind.h>
+#include <core/chip8_trace.h>
 
 typedef struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    // The texture is big enough for hires and holds the display at its own
+    // resolution, in these colours.
+    CHIP8Palette palette;
 
+    // Both 0 and NULL when there is no sound.
     SDL_AudioDeviceID audioDeviceID;
-    uint8_t *wavBuffer;
-    uint32_t wavLenght;
+    CHIP8Audio *audio;
+    SDL_AudioSpec audioSpec;
+
+    uint32_t frameEventType;
+
+    // Sequence number of the frame the texture currently holds.
+    uint64_t textureSequence;
+    // Whether that frame was hires; the renderer's logical size follows it.
+    bool hires;
+    bool redraw;
+    uint64_t framesPresented;
+    uint64_t framesSkipped;
 } App;
 
-App *AppInit(int windowWidth, int windowHeight);
+// The window starts at windowWidth x windowHeight, or fullscreen, and can be
+// resized or toggled with F11; the display is scaled to fit either way. The
+// buzzer is a toneFrequency Hz square wave, or silent if 0 or there is no
+// audio device.
+App *AppInit(int windowWidth, int windowHeight, bool fullscreen, const CHIP8Palette *palette, uint32_t toneFrequency);
 void AppDestroy(App *app);
 
-void AppLoop(App *app, CHIP8 *chip8);
+// rewind may be NULL; otherwise holding backspace steps back through it.
+// recorder may be NULL; otherwise the run is recorded and the movie finished on exit.
+// trace may be NULL; otherwise chip8 is traced and the trace written to traceFileName on exit.
+void AppLoop(App *app, CHIP8 *chip8, uint32_t instructionsPerFrame, CHIP8Rewind *rewind, CHIP8MovieRecorder *recorder, CHIP8Trace *trace, const char *traceFileName);
 
 #endif
\ No newline at end of file
@@ -5,13 +5,48 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// What CHIP-8 and SUPER-CHIP programs can address; XO-CHIP ones see all 64 KB.
 #define CHIP8_MEMORY_SIZE 4096
+#define CHIP8_XO_MEMORY_SIZE 65536
+// Unit of copy-on-write sharing between machines.
+#define CHIP8_PAGE_SIZE 256
+#define CHIP8_NUM_PAGES (CHIP8_MEMORY_SIZE / CHIP8_PAGE_SIZE)
+#define CHIP8_XO_NUM_PAGES (CHIP8_XO_MEMORY_SIZE / CHIP8_PAGE_SIZE)
 #define CHIP8_STACK_SIZE 16
 #define CHIP8_NUM_V_REGISTERS 16 
 
+#define CHIP8_FONTSET_SIZE 80
+// The SUPER-CHIP font: 8x10 digits, with XO-CHIP's A to F after them.
+#define CHIP8_BIG_FONTSET_SIZE 160
+// ROMs are loaded at 0x200 and may fill memory up to its end: 0xFFF, or 0xFFFF for XO-CHIP.
+#define CHIP8_MAX_ROM_SIZE (CHIP8_XO_MEMORY_SIZE - 0x200)
+// RPL user flags saved and loaded by fx75 and fx85.
+#define CHIP8_NUM_FLAGS 16
+// XO-CHIP's audio pattern buffer, loaded by f002.
+#define CHIP8_PATTERN_SIZE 16
+
 #define CHIP8_NUM_KEYS 16			
-#define CHIP8_DISPLAY_WIDTH 600	
-#define CHIP8_DISPLAY_HEIGHT 600	
+// The low resolution display, the only one CHIP-8 has.
+#define CHIP8_DISPLAY_WIDTH 64	
+#define CHIP8_DISPLAY_HEIGHT 32	
+// SUPER-CHIP's high resolution display, which the framebuffer is sized for.
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_ROW_WORDS (CHIP8_HIRES_WIDTH / 64)
+// XO-CHIP draws into two bitplanes; the others only ever use the first.
+#define CHIP8_NUM_PLANES 2
+
+#define CHIP8_ERROR_MESSAGE_SIZE 64
+
+#define CHIP8_STATE_VERSION 3
+// The largest current version save state, an XO-CHIP machine's: header,
+// registers, random state, extended mode, both planes and all of memory.
+// CHIP8StateSize gives the size for a variant.
+#define CHIP8_STATE_SIZE ( \
+	8 + 2 * CHIP8_STACK_SIZE + CHIP8_NUM_V_REGISTERS + 7 + CHIP8_NUM_KEYS + 8 + \
+	3 + CHIP8_NUM_FLAGS + CHIP8_PATTERN_SIZE + \
+	8 * CHIP8_NUM_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_ROW_WORDS + CHIP8_XO_MEMORY_SIZE \
+)
 
 typedef enum {
 	CHIP8_KEY_NOT_PRESSED = 0, 
@@ -23,8 +58,155 @@ typedef enum {
 	CHIP8_PIXEL_ON
 } CHIP8Pixel;
 
-typedef struct {	
-	uint8_t memory[CHIP8_MEMORY_SIZE];
+typedef enum { 
+	CHIP8_ERROR_PROFILE_UNAVAILABLE = -14,
+	CHIP8_ERROR_OUT_OF_MEMORY,
+	CHIP8_ERROR_ROM_TOO_LARGE,
+	CHIP8_ERROR_MOVIE_DESYNC,
+	CHIP8_ERROR_INVALID_STATE,
+	CHIP8_ERROR_JIT_UNAVAILABLE,
+	CHIP8_ERROR_INSTRUCTION_NOT_FOUND,
+	CHIP8_ERROR_KEY_NOT_FOUND,	
+	CHIP8_ERROR_STACK_OVERFLOW,
+	CHIP8_ERROR_STACK_UNDERFLOW,
+	CHIP8_ERROR_SEGFAULT,
+	CHIP8_ERROR_OPEN_FILE_FAILED,
+	CHIP8_ERROR_INVALID_FONTSET,
+	CHIP8_ERROR_INIT_FAILED, 
+	CHIP8_SUCCESS
+} CHIP8Result;
+
+// Why a machine last failed. Recording it is a few stores; the message is only built by CHIP8GetError.
+typedef struct {
+	CHIP8Result code;
+	// Set when the failing instruction is known; pc and opcode are meaningless otherwise.
+	bool fault;
+	uint16_t pc;
+	uint16_t opcode;
+} CHIP8Error;
+
+typedef enum {
+	CHIP8_MODE_INTERPRETER = 0,
+	CHIP8_MODE_JIT
+} CHIP8Mode;
+
+// Which instruction set a machine runs. Every variant decodes every opcode, but
+// an extension's instructions fail with CHIP8_ERROR_INSTRUCTION_NOT_FOUND on a
+// machine without it, so a CHIP-8 machine runs exactly as it always has.
+typedef enum {
+	CHIP8_VARIANT_CHIP8 = 0,
+	// 128x64 high resolution, scrolling, 16x16 sprites, the big font and RPL flags.
+	CHIP8_VARIANT_SCHIP,
+	// SUPER-CHIP plus 64 KB of memory, two bitplanes, scrolling up, 5xy2/5xy3
+	// register ranges, f000 nnnn long loads and the audio pattern and pitch.
+	CHIP8_VARIANT_XOCHIP,
+	CHIP8_NUM_VARIANTS
+} CHIP8Variant;
+
+// Why CHIP8Run returned. The others are bits of its stopMask; BUDGET and ERROR
+// always stop it.
+typedef enum {
+	// maxCycles instructions ran.
+	CHIP8_STOP_BUDGET = 0x01,
+	// An instruction failed; chip8->error says why.
+	CHIP8_STOP_ERROR = 0x02,
+	// A frame ended and the timers ticked, see CHIP8SetFrameCycles.
+	CHIP8_STOP_FRAME = 0x04,
+	// pc is at a breakpoint, which has not run yet.
+	CHIP8_STOP_BREAKPOINT = 0x08,
+	// fx0a ran without a key pressed and pc is still at it.
+	CHIP8_STOP_KEY_WAIT = 0x10
+} CHIP8StopReason;
+
+// What CHIP8Decode made of an opcode, named after the handler that runs it.
+typedef enum {
+	CHIP8_OP_INVALID = 0,
+	CHIP8_OP_00E0,
+	CHIP8_OP_00EE,
+	CHIP8_OP_1NNN,
+	CHIP8_OP_2NNN,
+	CHIP8_OP_3XKK,
+	CHIP8_OP_4XKK,
+	CHIP8_OP_5XY0,
+	CHIP8_OP_6XKK,
+	CHIP8_OP_7XKK,
+	CHIP8_OP_8XY0,
+	CHIP8_OP_8XY1,
+	CHIP8_OP_8XY2,
+	CHIP8_OP_8XY3,
+	CHIP8_OP_8XY4,
+	CHIP8_OP_8XY5,
+	CHIP8_OP_8XY6,
+	CHIP8_OP_8XY7,
+	CHIP8_OP_8XYE,
+	CHIP8_OP_9XY0,
+	CHIP8_OP_ANNN,
+	CHIP8_OP_BNNN,
+	CHIP8_OP_CXKK,
+	CHIP8_OP_DXYN,
+	CHIP8_OP_EX9E,
+	CHIP8_OP_EXA1,
+	CHIP8_OP_FX07,
+	CHIP8_OP_FX0A,
+	CHIP8_OP_FX15,
+	CHIP8_OP_FX18,
+	CHIP8_OP_FX1E,
+	CHIP8_OP_FX29,
+	CHIP8_OP_FX33,
+	CHIP8_OP_FX55,
+	CHIP8_OP_FX65,
+	// SUPER-CHIP
+	CHIP8_OP_00CN,
+	CHIP8_OP_00FB,
+	CHIP8_OP_00FC,
+	CHIP8_OP_00FD,
+	CHIP8_OP_00FE,
+	CHIP8_OP_00FF,
+	CHIP8_OP_FX30,
+	CHIP8_OP_FX75,
+	CHIP8_OP_FX85,
+	// XO-CHIP
+	CHIP8_OP_00DN,
+	CHIP8_OP_5XY2,
+	CHIP8_OP_5XY3,
+	CHIP8_OP_F000,
+	CHIP8_OP_FN01,
+	CHIP8_OP_F002,
+	CHIP8_OP_FX3A,
+	CHIP8_NUM_OPS
+} CHIP8Op;
+
+typedef struct CHIP8 CHIP8;
+typedef struct CHIP8Page CHIP8Page;
+typedef struct CHIP8Instruction CHIP8Instruction;
+typedef struct CHIP8Jit CHIP8Jit;
+typedef struct CHIP8Trace CHIP8Trace;
+typedef struct CHIP8Profile CHIP8Profile;
+
+typedef CHIP8Result (*CHIP8Handler)(CHIP8 *chip8, const CHIP8Instruction *instruction);
+
+// Predecoded instruction: a null handler marks an entry that has not been decoded yet.
+struct CHIP8Instruction {
+	CHIP8Handler handler;
+	uint16_t nnn;
+	uint8_t x;
+	uint8_t y;
+	uint8_t kk;
+	uint8_t n;
+	// A CHIP8Op; handler is always CHIP8's handler for it.
+	uint8_t op;
+};
+
+struct CHIP8 {	
+	// Reference counted pages of memory, each with the decoded instructions that
+	// start in it. A page held by more than one machine is read only: the first
+	// write gives the writer its own copy. Go through CHIP8ReadMemory and
+	// CHIP8WriteMemory rather than touching them directly. pages is basePages,
+	// which covers CHIP8_MEMORY_SIZE, until an XO-CHIP machine needs all
+	// CHIP8_XO_NUM_PAGES; numPages is its length either way.
+	CHIP8Page **pages;
+	uint32_t numPages;
+	CHIP8Page *basePages[CHIP8_NUM_PAGES];
 	uint16_t stack[CHIP8_STACK_SIZE];
 
 	uint8_t v[CHIP8_NUM_V_REGISTERS];	
@@ -37,28 +219,174 @@ typedef struct {
 	uint8_t st; 			
 
 	CHIP8Key keyboard[CHIP8_NUM_KEYS];
-	CHIP8Pixel display[CHIP8_DISPLAY_WIDTH][CHIP8_DISPLAY_HEIGHT];
-} CHIP8;
+	// xorshift64* state behind cxkk.
+	uint64_t random;
 
-typedef enum { 
-	CHIP8_ERROR_INSTRUCTION_NOT_FOUND = -8,
-	CHIP8_ERROR_KEY_NOT_FOUND,	
-	CHIP8_ERROR_STACK_OVERFLOW,
-	CHIP8_ERROR_STACK_UNDERFLOW,
-	CHIP8_ERROR_SEGFAULT,
-	CHIP8_ERROR_OPEN_FILE_FAILED,
-	CHIP8_ERROR_INVALID_FONTSET,
-	CHIP8_ERROR_INIT_FAILED, 
-	CHIP8_SUCCESS
-} CHIP8Result;
+	// See CHIP8SetVariant; memorySize is CHIP8_XO_MEMORY_SIZE for XO-CHIP and
+	// CHIP8_MEMORY_SIZE otherwise.
+	CHIP8Variant variant;
+	uint32_t memorySize;
+	// Set by 00ff, cleared by 00fe. In low resolution only the top left 64x32
+	// pixels of the framebuffer are used.
+	bool hires;
+	// The bitplanes that drawing, clearing and scrolling apply to, bit p for plane p.
+	uint8_t planes;
+	uint8_t flags[CHIP8_NUM_FLAGS];
+	uint8_t pattern[CHIP8_PATTERN_SIZE];
+	uint8_t pitch;
+
+	// A CHIP-8 machine's display: one row per word, the most significant bit is column 0.
+	uint64_t display[CHIP8_DISPLAY_HEIGHT];
+	// What the other variants draw to instead, allocated when one is first
+	// selected: packed rows of CHIP8_ROW_WORDS words per plane, the most
+	// significant bit of the first word is column 0. Scrolling shifts whole words.
+	uint64_t (*framebuffer)[CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+	// Bit y is set when display row y may have changed since the last CHIP8TakeDirtyRows.
+	uint64_t dirtyRows;
 
-CHIP8 *CHIP8Init();
+	uint64_t cycles;
+	// Of cycles, those CHIP8Run skipped instead of running an idle loop.
+	uint64_t idleCycles;
+	// Instructions per 60 Hz frame when CHIP8Run ticks the timers itself, else 0;
+	// the current frame ends when cycles reaches frameEnd.
+	uint32_t frameCycles;
+	uint64_t frameEnd;
+	// Bit a % 64 of breakpoints[a / 64] is set when CHIP8Run stops at address a,
+	// for a below breakpointsSize. NULL until the first CHIP8SetBreakpoint, which
+	// most machines never call.
+	uint64_t *breakpoints;
+	uint32_t breakpointsSize;
+
+	CHIP8Jit *jit;
+	// Not owned; NULL unless tracing, see CHIP8SetTrace.
+	CHIP8Trace *trace;
+	// Not owned; NULL unless profiling, see CHIP8SetProfile.
+	CHIP8Profile *profile;
+
+	CHIP8Error error;
+	char errorMessage[CHIP8_ERROR_MESSAGE_SIZE];
+};
+
+extern const uint8_t CHIP8Fontset[CHIP8_FONTSET_SIZE];
+extern const uint8_t CHIP8BigFontset[CHIP8_BIG_FONTSET_SIZE];
+// "chip8", "schip" and "xochip", as command lines take them.
+extern const char *const CHIP8VariantNames[CHIP8_NUM_VARIANTS];
+
+// The seed drives cxkk: machines with the same seed and inputs run identically.
+CHIP8 *CHIP8Init(uint64_t seed);
 void CHIP8Destroy(CHIP8 *chip8);
 
 CHIP8Result CHIP8LoadFontset(CHIP8 *chip8, const uint8_t *fontset, size_t fontsetSize);
+// Switches instruction set, loading CHIP8BigFontset for the extended ones. Call
+// it before loading a ROM, which only an XO-CHIP machine has room for beyond
+// 0xFFF. A different variant starts from a clear low resolution screen. Fails
+// with CHIP8_ERROR_JIT_UNAVAILABLE for XO-CHIP in JIT mode, since the JIT only
+// knows 4 KB of memory, with CHIP8_ERROR_PROFILE_UNAVAILABLE for XO-CHIP with a
+// profile attached for the same reason, and with CHIP8_ERROR_OUT_OF_MEMORY if the framebuffer,
+// XO-CHIP's page table or the font's pages cannot be allocated. Leaves chip8
+// untouched if it fails.
+CHIP8Result CHIP8SetVariant(CHIP8 *chip8, CHIP8Variant variant);
+// For the other core modules: allocates what a machine of variant needs and
+// chip8 does not have yet, without switching to it, so that a restore can fail
+// before it has changed anything.
+CHIP8Result CHIP8PrepareVariant(CHIP8 *chip8, CHIP8Variant variant);
 CHIP8Result CHIP8LoadROM(CHIP8 *chip8, const char *fileName);
+// Copies a ROM image into memory at 0x200; it has to fit below memorySize.
+CHIP8Result CHIP8LoadROMFromMemory(CHIP8 *chip8, const uint8_t *rom, size_t size);
+// Reads a ROM file into rom, which must hold CHIP8_MAX_ROM_SIZE bytes, so that
+// it can be loaded into any number of machines with CHIP8LoadROMFromMemory.
+CHIP8Result CHIP8ReadROM(const char *fileName, uint8_t *rom, size_t *size);
+CHIP8Result CHIP8SetMode(CHIP8 *chip8, CHIP8Mode mode);
+void CHIP8Seed(CHIP8 *chip8, uint64_t seed);
+// Records every instruction into trace from now on, or stops with NULL. While
+// tracing, instructions are interpreted even in JIT mode.
+void CHIP8SetTrace(CHIP8 *chip8, CHIP8Trace *trace);
+// Counts every instruction into profile from now on, or stops with NULL. Like
+// tracing, profiling interprets even in JIT mode. A profile covers the first
+// CHIP8_MEMORY_SIZE bytes only, so this fails with
+// CHIP8_ERROR_PROFILE_UNAVAILABLE on an XO-CHIP machine, and a profiled machine
+// cannot become one.
+CHIP8Result CHIP8SetProfile(CHIP8 *chip8, CHIP8Profile *profile);
+
+// Makes chip8's memory the same pages as source's, e.g. a machine that has only
+// loaded the fontset and a ROM. source may be shared from on several threads at
+// once, but must not run meanwhile. Fails only if chip8 has to grow its page
+// table to XO-CHIP's size and cannot.
+CHIP8Result CHIP8ShareMemory(CHIP8 *chip8, const CHIP8 *source);
+// Decodes every instruction up front. Shared pages are never decoded into, so
+// this is worth doing on a machine before others share its memory.
+void CHIP8DecodeMemory(CHIP8 *chip8);
+// Pages that chip8 holds alone, i.e. the memory it costs on top of what it shares.
+size_t CHIP8PrivatePages(const CHIP8 *chip8);
+
+uint8_t CHIP8ReadByte(const CHIP8 *chip8, uint16_t address);
+void CHIP8ReadMemory(const CHIP8 *chip8, size_t address, uint8_t *data, size_t size);
+// Copies shared pages as needed and invalidates the decoded and compiled code that was overwritten.
+CHIP8Result CHIP8WriteMemory(CHIP8 *chip8, size_t address, const uint8_t *data, size_t size);
+// Copies the shared pages that writing data would change, without writing it,
+// so that the same CHIP8WriteMemory afterwards cannot fail. Lets a restore fail
+// before it has changed anything.
+CHIP8Result CHIP8PrepareWrite(CHIP8 *chip8, size_t address, const uint8_t *data, size_t size);
+
+// Runs one instruction, or one basic block when the JIT is enabled.
 CHIP8Result CHIP8Execute(CHIP8 *chip8);
+// Runs exactly one instruction with the interpreter, whatever the mode.
+CHIP8Result CHIP8Interpret(CHIP8 *chip8);
+// Runs up to maxCycles instructions in one loop, stopping early for an error or
+// for any CHIP8StopReason in stopMask. A breakpoint at pc does not stop the
+// first instruction, so that calling again steps over it. Watching breakpoints
+// on a machine that has any set, or key waits, interprets even in JIT mode; otherwise a JIT block may run past
+// maxCycles, as with CHIP8Execute. When neither is watched and chip8 is neither
+// traced nor profiled, the interpreter jumps over loops that can only end once
+// CHIP8Run returns: a jump to itself, 00fd, fx0a waiting for a key, and fx07 3x00
+// 1nnn polling dt. They leave the same state as running them, idleCycles aside.
+CHIP8StopReason CHIP8Run(CHIP8 *chip8, uint64_t maxCycles, uint32_t stopMask);
+// Has CHIP8Run tick the timers every frameCycles instructions from now on, or
+// leaves that to the caller with 0, e.g. when a CHIP8Scheduler paces chip8.
+void CHIP8SetFrameCycles(CHIP8 *chip8, uint32_t frameCycles);
+// The bitmap is allocated by the first breakpoint set, so this can fail with
+// CHIP8_ERROR_OUT_OF_MEMORY.
+CHIP8Result CHIP8SetBreakpoint(CHIP8 *chip8, uint16_t address, bool enabled);
+
+// Decrements dt and st; call at 60 Hz.
+void CHIP8UpdateTimers(CHIP8 *chip8);
+
+// Bytes in a current version save state of a machine of variant: only the
+// memory and display planes that variant has.
+size_t CHIP8StateSize(CHIP8Variant variant);
+// Serializes the architectural state into a CHIP8StateSize(chip8->variant) byte blob; the execution mode and cycle count are not part of it.
+CHIP8Result CHIP8SaveState(const CHIP8 *chip8, uint8_t *buffer, size_t size);
+// Leaves chip8 untouched if it fails: the blob is not a valid state of this
+// version, or copying the pages chip8 shares runs out of memory.
+CHIP8Result CHIP8LoadState(CHIP8 *chip8, const uint8_t *buffer, size_t size);
+
+// FNV-1a over the architectural state (memory, registers, stack, timers, random state and display).
+// Of a CHIP-8 machine only what CHIP-8 can change is hashed, so its hashes are the same as ever.
+uint64_t CHIP8Hash(const CHIP8 *chip8);
+
+void CHIP8Decode(uint8_t msbyte, uint8_t lsbyte, CHIP8Instruction *instruction);
+// Drops decoded and compiled code for [address, address + size); CHIP8WriteMemory already does.
+void CHIP8InvalidateCache(CHIP8 *chip8, size_t address, size_t size);
+
+// Of the first plane; x and y count framebuffer pixels in either resolution.
+CHIP8Pixel CHIP8GetPixel(const CHIP8 *chip8, uint8_t x, uint8_t y);
+// The left 64 pixels of row y of the first plane: the whole row in low resolution.
+uint64_t CHIP8GetDisplayRow(const CHIP8 *chip8, uint8_t y);
+// Copies the display out in the extended variants' framebuffer layout, whatever
+// chip8's variant: a CHIP-8 display is the top left 64x32 of the first plane.
+void CHIP8ReadDisplay(const CHIP8 *chip8, uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]);
+// The reverse, marking the rows that change as dirty. A CHIP-8 machine takes
+// only the part it has.
+void CHIP8WriteDisplay(CHIP8 *chip8, const uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]);
+// Returns the rows changed since the previous call and clears them.
+uint64_t CHIP8TakeDirtyRows(CHIP8 *chip8);
 
-const char *CHIP8GetError();
+// Describes chip8->error, formatting it into chip8 on demand. chip8 may be NULL
+// after CHIP8Init failed, the one error that has no machine to carry it.
+const char *CHIP8GetError(CHIP8 *chip8);
+// For the other core modules: records an error that is not tied to an instruction.
+void CHIP8SetError(CHIP8 *chip8, CHIP8Result result);
+// Records an error raised by the instruction at pc.
+void CHIP8SetFault(CHIP8 *chip8, CHIP8Result result, uint16_t pc);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef CORE_CHIP8_AUDIO_H
+#define CORE_CHIP8_AUDIO_H
+
+#include <core/chip8.h>
+
+#define CHIP8_AUDIO_DEFAULT_FREQUENCY 440
+#define CHIP8_AUDIO_DEFAULT_VOLUME 0.25
+
+// Must be a power of two.
+#define CHIP8_AUDIO_QUEUE_SIZE 8
+
+typedef struct {
+	// Frames played, and skipped to catch up.
+	uint64_t frames;
+	uint64_t skippedFrames;
+	// Samples rendered while waiting for a frame: the last state is held for up
+	// to a frame, then silence.
+	uint64_t underruns;
+	// From a frame being pushed to its first sample being rendered, in seconds.
+	double averageLatency;
+	double maxLatency;
+} CHIP8AudioMetrics;
+
+// The buzzer as a square wave, rendered by an audio callback. The emulation
+// thread pushes whether it sounds, st > 0, once per emulated frame; the
+// callback plays each frame for a 60th of a second of samples, so the tone
+// starts and stops on frame boundaries however the callback's buffers fall.
+// The queue between them is a fixed ring, one producer and one consumer with
+// no locks, and only the newest frame is ever played: frames queued behind it
+// are skipped, so the sound lags the emulation by at most about a frame.
+typedef struct CHIP8Audio CHIP8Audio;
+
+CHIP8Audio *CHIP8AudioInit(uint32_t sampleRate, uint32_t frequency, double volume);
+void CHIP8AudioDestroy(CHIP8Audio *audio);
+
+// Producer: the state of one emulated frame. Returns false if the queue is full.
+bool CHIP8AudioPushFrame(CHIP8Audio *audio, bool sounding);
+// Consumer: fills samples with signed 16-bit mono.
+void CHIP8AudioRender(CHIP8Audio *audio, int16_t *samples, size_t numSamples);
+
+// Only meaningful once the consumer has stopped, e.g. the device is closed.
+void CHIP8AudioGetMetrics(const CHIP8Audio *audio, CHIP8AudioMetrics *metrics);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef CORE_CHIP8_DISPLAY_H
+#define CORE_CHIP8_DISPLAY_H
+
+#include <core/chip8.h>
+
+// What the display has always looked like: lit pixels a light grey, the rest a
+// darker, slightly transparent one.
+#define CHIP8_PALETTE_DEFAULT_FOREGROUND 0xFFEEEEEE
+#define CHIP8_PALETTE_DEFAULT_BACKGROUND 0xCCAAAAAA
+// Pixels lit in XO-CHIP's second plane only, and in both.
+#define CHIP8_PALETTE_DEFAULT_SECONDARY 0xFF666666
+#define CHIP8_PALETTE_DEFAULT_OVERLAP 0xFF222222
+
+// ARGB8888 colours of pixels lit in the first plane, in neither, in the second
+// and in both.
+typedef struct {
+	uint32_t foreground;
+	uint32_t background;
+	uint32_t secondary;
+	uint32_t overlap;
+} CHIP8Palette;
+
+// Expands numRows display rows from firstRow into ARGB8888 pixels, every CHIP8
+// pixel a scale x scale block, e.g. straight into a locked streaming texture.
+// display is laid out as CHIP8ReadDisplay copies it out, and width how many of
+// each row's pixels to expand: CHIP8_DISPLAY_WIDTH in lores, CHIP8_HIRES_WIDTH
+// in hires. pixels is where the block of firstRow starts and pitch the bytes
+// from one pixel row to the next. Four pixels are coloured at a time in SSE2
+// vectors, and each scaled row is only built once and copied to the scale - 1
+// below it.
+void CHIP8ExpandDisplay(const uint64_t *display, uint32_t width, uint32_t firstRow, uint32_t numRows, const CHIP8Palette *palette, uint32_t scale, void *pixels, int pitch);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef CORE_CHIP8_JIT_H
+#define CORE_CHIP8_JIT_H
+
+#include <core/chip8.h>
+
+// Returns NULL when the host is not x86-64 or executable memory cannot be allocated.
+CHIP8Jit *CHIP8JitInit();
+void CHIP8JitDestroy(CHIP8Jit *jit);
+
+// Runs translated blocks until at least `budget` instructions have been executed.
+CHIP8Result CHIP8JitExecute(CHIP8Jit *jit, CHIP8 *chip8, int64_t budget);
+void CHIP8JitInvalidate(CHIP8Jit *jit, size_t address, size_t size);
+
+#endif
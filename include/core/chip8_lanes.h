@@ -0,0 +1,46 @@
+#ifndef CORE_CHIP8_LANES_H
+#define CORE_CHIP8_LANES_H
+
+#include <core/chip8.h>
+
+// One vector of bytes: a lane per machine for each 8-bit register.
+#define CHIP8_LANES_MAX 16
+
+typedef struct {
+	// Instructions run over all lanes, and how many of those ran in vector steps
+	// rather than one lane at a time through CHIP8Interpret.
+	uint64_t instructions;
+	uint64_t vectorInstructions;
+	// Each step runs one instruction on every lane whose pc agreed.
+	uint64_t steps;
+	// Share of the lanes busy in the average step: 1 when they never diverged.
+	double utilization;
+} CHIP8LanesMetrics;
+
+// Runs up to CHIP8_LANES_MAX interpreted machines in lockstep, e.g. one ROM
+// with different seeds or inputs. Their registers live in vector lanes, and
+// every lane at the same pc runs the instruction there at once: register
+// arithmetic, skips and jumps in vector kernels with the semantics of
+// CHIP8_7xkk, CHIP8_8xy* and friends, anything touching memory, the display,
+// the stack or the keys through CHIP8Interpret on each lane's own machine.
+// Lanes that take another branch wait until the others catch up with them.
+//
+// The machines stay the caller's, and hold the lanes' state after every
+// CHIP8LanesRun; in between, only their keys may change. They run best sharing
+// memory, as forks of one image do; memory that differs still runs, one lane at
+// a time. Tracing, profiling and the JIT are ignored. XO-CHIP machines, with
+// their 64 KB of memory, cannot run in lanes.
+typedef struct CHIP8Lanes CHIP8Lanes;
+
+CHIP8Lanes *CHIP8LanesInit(CHIP8 **machines, size_t numLanes);
+void CHIP8LanesDestroy(CHIP8Lanes *lanes);
+
+// Runs every lane as CHIP8SchedulerRunFrame would, frame by frame from the frame
+// that starts at frameStart until endCycle. A lane that fails stops there with
+// the error in its machine, while the others go on.
+void CHIP8LanesRun(CHIP8Lanes *lanes, uint64_t frameStart, uint64_t frameCycles, uint64_t endCycle);
+// CHIP8_SUCCESS, or why the lane stopped.
+CHIP8Result CHIP8LanesResult(const CHIP8Lanes *lanes, size_t lane);
+void CHIP8LanesGetMetrics(const CHIP8Lanes *lanes, CHIP8LanesMetrics *metrics);
+
+#endif
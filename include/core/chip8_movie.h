@@ -0,0 +1,35 @@
+#ifndef CORE_CHIP8_MOVIE_H
+#define CORE_CHIP8_MOVIE_H
+
+#include <core/chip8.h>
+
+// A movie is the input of one run: the seed, instructions per frame, mode and
+// variant it was started with, then every key change tagged with the number of frames
+// emulated before it. The state hashes at the start and the end let a replay
+// check that it reproduced the run exactly.
+typedef struct CHIP8MovieRecorder CHIP8MovieRecorder;
+typedef struct CHIP8Movie CHIP8Movie;
+
+// chip8 must be ready to run: seeded with seed, variant set, ROM loaded and mode set.
+CHIP8MovieRecorder *CHIP8MovieRecorderInit(const char *fileName, const CHIP8 *chip8, uint64_t seed, uint32_t instructionsPerFrame);
+// Records a key change applied before frame `frame` (counting from 0) runs.
+void CHIP8MovieRecorderKey(CHIP8MovieRecorder *recorder, uint64_t frame, uint8_t key, CHIP8Key state);
+// Ends the movie after `frames` frames, closes the file and frees the recorder.
+// Returns false if any of it could not be written.
+bool CHIP8MovieRecorderFinish(CHIP8MovieRecorder *recorder, const CHIP8 *chip8, uint64_t frames);
+
+// Returns NULL if the file cannot be read or is not a complete movie.
+CHIP8Movie *CHIP8MovieLoad(const char *fileName);
+void CHIP8MovieDestroy(CHIP8Movie *movie);
+
+uint64_t CHIP8MovieSeed(const CHIP8Movie *movie);
+CHIP8Mode CHIP8MovieMode(const CHIP8Movie *movie);
+CHIP8Variant CHIP8MovieVariant(const CHIP8Movie *movie);
+uint64_t CHIP8MovieFrames(const CHIP8Movie *movie);
+
+// Replays the whole movie as fast as possible into chip8, which must be in the
+// state the recording started from. Returns CHIP8_ERROR_MOVIE_DESYNC if the
+// start or end state does not match the recording.
+CHIP8Result CHIP8MoviePlay(const CHIP8Movie *movie, CHIP8 *chip8);
+
+#endif
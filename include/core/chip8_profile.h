@@ -0,0 +1,40 @@
+#ifndef CORE_CHIP8_PROFILE_H
+#define CORE_CHIP8_PROFILE_H
+
+#include <core/chip8.h>
+
+#define CHIP8_PROFILE_DEFAULT_SAMPLE_PERIOD 256
+#define CHIP8_PROFILE_DEFAULT_TOP 20
+
+// Where a machine spends its instructions and host time. Every instruction is
+// counted per CHIP8Op and per pc, and the memory it reads, writes or runs from
+// per address; 2nnn adds an edge to the call graph. Host time is only measured
+// on about one in samplePeriod instructions, picked at random so that it does
+// not beat with the ROM's loops, and scaled up by the exact counts; timing
+// every instruction would cost several times what the instructions do.
+// Attach one with CHIP8SetProfile. Only the machine's own thread may use it
+// while it is attached.
+typedef struct CHIP8Profile CHIP8Profile;
+
+CHIP8Profile *CHIP8ProfileInit(uint32_t samplePeriod);
+void CHIP8ProfileDestroy(CHIP8Profile *profile);
+
+// CHIP8Interpret's execute step while profiling: runs instruction, decoded from
+// chip8->pc, and counts it in chip8->profile. Lives here so the unprofiled path
+// stays small, and takes the handler's arguments so it can jump straight to it.
+CHIP8Result CHIP8ProfileExecute(CHIP8 *chip8, const CHIP8Instruction *instruction);
+// Forgets everything counted, e.g. before reusing the profile for another machine.
+void CHIP8ProfileClear(CHIP8Profile *profile);
+
+uint64_t CHIP8ProfileInstructions(const CHIP8Profile *profile);
+
+// Writes the top ops and pcs by host time, the call graph and each routine's
+// share of the time to fileName as text. chip8 supplies the opcodes at the pcs.
+// Returns false if it could not be written.
+bool CHIP8ProfileWriteReport(const CHIP8Profile *profile, const CHIP8 *chip8, const char *fileName, size_t top);
+// Writes the memory accesses as a binary PPM with one scale x scale block per
+// byte, 64 bytes to a row: writes in red, reads in green, instruction fetches in
+// blue, each on a log scale. Returns false if it could not be written.
+bool CHIP8ProfileWriteHeatmap(const CHIP8Profile *profile, const char *fileName, uint32_t scale);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef CORE_CHIP8_REWIND_H
+#define CORE_CHIP8_REWIND_H
+
+#include <core/chip8.h>
+
+#define CHIP8_REWIND_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+// History of recent frames for stepping backward. Only the newest frame is
+// kept as a full save state; every older one is an RLE-encoded XOR delta
+// against the frame after it, in a ring that drops the oldest frames first.
+typedef struct CHIP8Rewind CHIP8Rewind;
+
+// Keeps at most maxFrames frames and budget bytes of deltas, whichever runs out first.
+CHIP8Rewind *CHIP8RewindInit(size_t maxFrames, size_t budget);
+void CHIP8RewindDestroy(CHIP8Rewind *rewind);
+
+// Records chip8 as the newest frame; call once per emulated frame. A frame of
+// another variant than the one before starts the history over.
+CHIP8Result CHIP8RewindPush(CHIP8Rewind *rewind, const CHIP8 *chip8);
+// Drops the newest frame and restores the one recorded before it into chip8.
+// Returns false, leaving chip8 and the history untouched, when there is nothing
+// older or restoring it fails; chip8->error says why it failed.
+bool CHIP8RewindStepBack(CHIP8Rewind *rewind, CHIP8 *chip8);
+
+// Frames that CHIP8RewindStepBack can still go back.
+size_t CHIP8RewindFrames(const CHIP8Rewind *rewind);
+// Bytes of the budget taken by deltas.
+size_t CHIP8RewindBytes(const CHIP8Rewind *rewind);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CORE_CHIP8_SCHEDULER_H
+#define CORE_CHIP8_SCHEDULER_H
+
+#include <core/chip8.h>
+
+#define CHIP8_SCHEDULER_FRAME_RATE 60
+#define CHIP8_SCHEDULER_DEFAULT_INSTRUCTIONS_PER_FRAME 12
+// Frames emulated in one update before the rest of the backlog is dropped.
+#define CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES 4
+
+// Emulated time advances in whole 60 Hz frames: a frame runs a fixed number of
+// instructions, then ticks dt and st once. Deadlines are derived from the start
+// time so they do not drift; all times are in seconds on the caller's clock.
+typedef struct {
+	uint32_t instructionsPerFrame;
+
+	double startTime;
+	uint64_t frameIndex;		// frames emulated or dropped so far
+
+	uint64_t frames;
+	uint64_t skippedFrames;
+	uint64_t startCycles;
+	uint64_t cycleTarget;
+} CHIP8Scheduler;
+
+typedef struct {
+	double configuredIPS;
+	double achievedIPS;
+	uint64_t frames;
+	uint64_t skippedFrames;
+} CHIP8SchedulerMetrics;
+
+void CHIP8SchedulerInit(CHIP8Scheduler *scheduler, const CHIP8 *chip8, uint32_t instructionsPerFrame, double now);
+
+// Runs every frame that is due at `now`; `framesRun` is 0 when nothing was due,
+// otherwise the caller presents once.
+CHIP8Result CHIP8SchedulerUpdate(CHIP8Scheduler *scheduler, CHIP8 *chip8, double now, uint32_t *framesRun);
+// Lets the frames that are due at `now` pass without running them, e.g. while
+// rewinding; returns how many were due, capped like a catch-up.
+uint32_t CHIP8SchedulerHold(CHIP8Scheduler *scheduler, const CHIP8 *chip8, double now);
+double CHIP8SchedulerNextDeadline(const CHIP8Scheduler *scheduler);
+void CHIP8SchedulerGetMetrics(const CHIP8Scheduler *scheduler, const CHIP8 *chip8, double now, CHIP8SchedulerMetrics *metrics);
+
+// Runs instructions until chip8->cycles reaches endCycle, then ticks the timers once.
+CHIP8Result CHIP8SchedulerRunFrame(CHIP8 *chip8, uint64_t endCycle);
+
+#endif
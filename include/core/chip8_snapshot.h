@@ -0,0 +1,27 @@
+#ifndef CORE_CHIP8_SNAPSHOT_H
+#define CORE_CHIP8_SNAPSHOT_H
+
+#include <core/chip8.h>
+
+#define CHIP8_SNAPSHOT_PAGE_SIZE CHIP8_PAGE_SIZE
+
+// An in-memory copy of the architectural state. Memory is held in reference
+// counted pages: a snapshot shares every page that is unchanged from the one
+// it was captured against, so capturing every frame only copies what the
+// program wrote. Snapshots are immutable and can be restored into any number
+// of machines, from any thread.
+typedef struct CHIP8Snapshot CHIP8Snapshot;
+
+// previous may be NULL; otherwise its unchanged pages are shared instead of copied.
+CHIP8Snapshot *CHIP8SnapshotCapture(const CHIP8 *chip8, const CHIP8Snapshot *previous);
+// Only pages that differ from chip8's current memory are copied and invalidated.
+// Leaves chip8 untouched if it fails: chip8 is in JIT mode or profiled and the
+// snapshot is of an XO-CHIP machine, which CHIP8LoadState rejects too, or it
+// runs out of memory copying pages it shares.
+CHIP8Result CHIP8SnapshotRestore(const CHIP8Snapshot *snapshot, CHIP8 *chip8);
+void CHIP8SnapshotDestroy(CHIP8Snapshot *snapshot);
+
+// Pages owned by this snapshot alone, i.e. what it cost to capture.
+size_t CHIP8SnapshotUniquePages(const CHIP8Snapshot *snapshot);
+
+#endif
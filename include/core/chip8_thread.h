@@ -0,0 +1,52 @@
+#ifndef CORE_CHIP8_THREAD_H
+#define CORE_CHIP8_THREAD_H
+
+#include <core/chip8.h>
+#include <core/chip8_audio.h>
+#include <core/chip8_movie.h>
+#include <core/chip8_rewind.h>
+#include <core/chip8_scheduler.h>
+
+// Must be a power of two.
+#define CHIP8_THREAD_INPUT_QUEUE_SIZE 64
+
+// What the renderer needs from one emulated frame, copied out by the emulation thread.
+typedef struct {
+	uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+	bool hires;
+	// Rows changed since the frame with the previous sequence number; the reader
+	// has to redraw everything if it missed that frame.
+	uint64_t dirtyRows;
+	uint64_t sequence;
+	uint8_t st;
+
+	// Anything other than CHIP8_SUCCESS means the emulation thread has stopped.
+	CHIP8Result result;
+	CHIP8SchedulerMetrics metrics;
+} CHIP8Frame;
+
+typedef void (*CHIP8FrameCallback)(void *context);
+
+typedef struct CHIP8Thread CHIP8Thread;
+
+// Runs chip8 on its own thread, paced by a CHIP8Scheduler, until CHIP8ThreadStop.
+// The thread owns chip8, and rewind and recorder if not NULL, in between: other
+// threads talk to it only through the calls below. The recorder gets every key
+// change; rewinding is ignored while recording. audio, if not NULL, is pushed
+// the sound timer's state after every frame run or stepped back. onFrame, if
+// set, is called on the emulation thread after every published frame.
+CHIP8Thread *CHIP8ThreadStart(CHIP8 *chip8, uint32_t instructionsPerFrame, CHIP8Rewind *rewind, CHIP8MovieRecorder *recorder, CHIP8Audio *audio, CHIP8FrameCallback onFrame, void *context);
+// Joins the emulation thread; the last published frame can still be read afterwards.
+void CHIP8ThreadStop(CHIP8Thread *thread);
+void CHIP8ThreadDestroy(CHIP8Thread *thread);
+
+// Single producer: call from one thread only. Returns false if the queue is full.
+bool CHIP8ThreadPushKey(CHIP8Thread *thread, uint8_t key, CHIP8Key state);
+// While set, every due frame steps back through the rewind history instead of running.
+void CHIP8ThreadSetRewinding(CHIP8Thread *thread, bool rewinding);
+
+// Single consumer: points frame at the latest published frame, which stays valid
+// until the next call. Returns true if it is newer than the previous one.
+bool CHIP8ThreadReadFrame(CHIP8Thread *thread, const CHIP8Frame **frame);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef CORE_CHIP8_TRACE_H
+#define CORE_CHIP8_TRACE_H
+
+#include <core/chip8.h>
+
+#define CHIP8_TRACE_DEFAULT_CAPACITY 65536
+
+// Flags in CHIP8TraceRecord.changed, besides the V registers. MEMORY and
+// DISPLAY mark instructions that write there, whether or not a bit flipped.
+#define CHIP8_TRACE_CHANGED_I 0x01
+#define CHIP8_TRACE_CHANGED_SP 0x02
+#define CHIP8_TRACE_CHANGED_DT 0x04
+#define CHIP8_TRACE_CHANGED_ST 0x08
+#define CHIP8_TRACE_CHANGED_MEMORY 0x10
+#define CHIP8_TRACE_CHANGED_DISPLAY 0x20
+
+// One interpreted instruction.
+typedef struct {
+	// chip8->cycles before the instruction ran.
+	uint64_t cycle;
+	uint16_t pc;
+	uint16_t opcode;
+	// Bit x is set when Vx changed.
+	uint16_t changedV;
+	uint8_t changed;
+	// What the instruction returned; the last record of a failed run is the fault.
+	int8_t result;
+} CHIP8TraceRecord;
+
+// The newest instructions a machine ran, in a fixed size ring. Only the
+// machine's own thread writes to it; CHIP8TraceRead and CHIP8TraceDump may run
+// on any thread at the same time and simply miss the records overwritten while
+// they copy. Attach one with CHIP8SetTrace.
+typedef struct CHIP8Trace CHIP8Trace;
+
+// Keeps the newest capacity records, rounded up to a power of two.
+CHIP8Trace *CHIP8TraceInit(size_t capacity);
+void CHIP8TraceDestroy(CHIP8Trace *trace);
+
+void CHIP8TracePush(CHIP8Trace *trace, const CHIP8TraceRecord *record);
+// CHIP8Interpret's execute step while tracing: runs instruction, decoded from
+// chip8->pc, and pushes its record. Lives here so the untraced path stays small.
+CHIP8Result CHIP8TraceExecute(CHIP8Trace *trace, CHIP8 *chip8, const CHIP8Instruction *instruction);
+// Forgets every record, e.g. before reusing the trace for another machine.
+void CHIP8TraceClear(CHIP8Trace *trace);
+
+// Copies up to maxRecords of the newest records into records, oldest first, and returns how many.
+size_t CHIP8TraceRead(const CHIP8Trace *trace, CHIP8TraceRecord *records, size_t maxRecords);
+// Writes every record still held to fileName. Returns false if it could not be written.
+bool CHIP8TraceDump(const CHIP8Trace *trace, const char *fileName);
+// Reads a dump back; the array is freed with free(). Returns NULL if the file
+// cannot be read or is not a trace dump.
+CHIP8TraceRecord *CHIP8TraceLoad(const char *fileName, size_t *numRecords);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*ThreadPoolTask)(void *context, size_t index, size_t worker);
+
+// A numThreads of 0 uses one worker per online core.
+ThreadPool *threadPoolInit(size_t numThreads);
+void threadPoolDestroy(ThreadPool *pool);
+
+size_t threadPoolSize(const ThreadPool *pool);
+
+// Calls task for every index in [0, count) and returns when all of them are done.
+// The calling thread works as worker 0; idle workers steal half of another worker's range.
+void threadPoolRun(ThreadPool *pool, size_t count, ThreadPoolTask task, void *context);
+
+#endif
@@ -0,0 +1,864 @@
+#include <core/chip8.h>
+#include <core/chip8_lanes.h>
+#include <core/chip8_movie.h>
+#include <core/chip8_profile.h>
+#include <core/chip8_scheduler.h>
+#include <core/chip8_snapshot.h>
+#include <core/chip8_trace.h>
+#include <utils/thread_pool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH_DEFAULT_CYCLES 1000000
+#define BATCH_DEFAULT_FRAME_CYCLES CHIP8_SCHEDULER_DEFAULT_INSTRUCTIONS_PER_FRAME
+#define BATCH_MAX_LINE_SIZE 4096
+// Lanes running more than this share of their instructions one at a time cost
+// more than the machines would on their own.
+#define BATCH_LANES_MAX_SCALAR_SHARE 0.3
+// Instructions per lane between looks at that share.
+#define BATCH_LANES_CHECK_CYCLES 100000
+
+typedef struct {
+	const char *romFileName;
+	uint64_t seed;
+
+	CHIP8Result result;
+	CHIP8Error error;
+	uint64_t hash;
+	uint64_t cycles;
+	// Of cycles, those skipped over idle loops rather than run.
+	uint64_t idleCycles;
+	double seconds;
+	double bootSeconds;
+} BatchInstance;
+
+typedef struct {
+	CHIP8Result result;
+	// Fontset and ROM loaded and decoded; instances share its memory instead of copying it.
+	CHIP8 *chip8;
+} BatchImage;
+
+typedef struct {
+	CHIP8Result result;
+	CHIP8Error error;
+	CHIP8Snapshot *snapshot;
+	uint64_t cycles;
+} BatchCheckpoint;
+
+typedef struct {
+	BatchInstance *instances;
+	uint64_t cycleBudget;
+	uint64_t frameCycles;
+	bool jit;
+	CHIP8Variant variant;
+
+	// Every ROM file is read once into images[rom] and shared from there with its instances.
+	char **roms;
+	BatchImage *images;
+	size_t numSeeds;
+
+	// When checkpointCycles is set, every ROM is booted once and its seeds fork from checkpoints[rom].
+	uint64_t checkpointCycles;
+	BatchCheckpoint *checkpoints;
+
+	// When set, every instance replays the movie instead of running for cycleBudget.
+	CHIP8Movie *movie;
+
+	// When set, every worker traces the instance it runs into traces[worker], and
+	// the trace of each failed instance is written to traceDirectory.
+	const char *traceDirectory;
+	CHIP8Trace **traces;
+
+	// When set, every worker profiles the instance it runs into profiles[worker],
+	// and the profile of each instance is written to profileDirectory.
+	const char *profileDirectory;
+	CHIP8Profile **profiles;
+
+	// When set, the seeds of every ROM run in lockstep groups of up to
+	// CHIP8_LANES_MAX, group g's metrics going to laneMetrics[g], and whether it
+	// went on one machine at a time to scalarGroups[g].
+	bool lanes;
+	size_t groupsPerRom;
+	CHIP8LanesMetrics *laneMetrics;
+	bool *scalarGroups;
+} Batch;
+
+static void BatchUsage(const char *program);
+static void BatchFileName(const char *directory, const BatchInstance *instance, const char *extension, char *fileName, size_t size);
+static void BatchDumpTrace(const Batch *batch, const BatchInstance *instance, const CHIP8Trace *trace);
+static void BatchWriteProfile(const Batch *batch, const BatchInstance *instance, const CHIP8Profile *profile, const CHIP8 *chip8);
+static char **BatchReadList(const char *fileName, size_t *numRoms);
+static void BatchReadImage(void *context, size_t index, size_t worker);
+static void BatchRunCheckpoint(void *context, size_t index, size_t worker);
+static void BatchRunInstance(void *context, size_t index, size_t worker);
+static void BatchRunLanes(void *context, size_t index, size_t worker);
+static bool BatchRunLaneChecks(const Batch *batch, CHIP8Lanes *lanes, CHIP8 **machines, size_t numLanes, uint64_t frameStart, CHIP8Result *results);
+static CHIP8 *BatchStartInstance(Batch *batch, size_t index, uint64_t *frameStart);
+static void BatchFinishInstance(Batch *batch, size_t index, size_t worker, CHIP8 *chip8);
+static CHIP8Variant BatchParseVariant(const char *name);
+static CHIP8Result BatchBoot(const Batch *batch, const BatchImage *image, uint64_t seed, CHIP8 **chip8);
+static CHIP8Result BatchRunFrames(const Batch *batch, CHIP8 *chip8, uint64_t frameStart, uint64_t endCycle);
+static const char *BatchResultName(CHIP8Result result);
+static double BatchNow();
+
+int main(int argc, char *argv[]) {
+	Batch batch = { NULL, BATCH_DEFAULT_CYCLES, BATCH_DEFAULT_FRAME_CYCLES, false, CHIP8_VARIANT_CHIP8, NULL, NULL, 1, 0, NULL, NULL, NULL, NULL, NULL, NULL, false, 0, NULL, NULL };
+	size_t numThreads = 0;
+
+	char **roms = (char **) malloc(argc * sizeof(char *));
+	size_t numRoms = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+			batch.cycleBudget = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--frame-cycles") == 0 && i + 1 < argc) {
+			batch.frameCycles = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+			batch.numSeeds = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			numThreads = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+			batch.checkpointCycles = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc) {
+			batch.movie = CHIP8MovieLoad(argv[++i]);
+			if (batch.movie == NULL) {
+				fprintf(stderr, "Error: Cannot read movie %s.\n", argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			batch.traceDirectory = argv[++i];
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			batch.profileDirectory = argv[++i];
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			batch.jit = true;
+		} else if (strcmp(argv[i], "--lanes") == 0) {
+			batch.lanes = true;
+		} else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+			batch.variant = BatchParseVariant(argv[++i]);
+			if (batch.variant == CHIP8_NUM_VARIANTS) {
+				BatchUsage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		} else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+			size_t numListed;
+			char **listed = BatchReadList(argv[++i], &numListed);
+			if (listed == NULL) {
+				fprintf(stderr, "Error: Cannot read ROM list %s.\n", argv[i]);
+				exit(EXIT_FAILURE);
+			}
+
+			roms = (char **) realloc(roms, (argc + numRoms + numListed) * sizeof(char *));
+			memcpy(roms + numRoms, listed, numListed * sizeof(char *));
+			numRoms += numListed;
+			free(listed);
+		} else if (argv[i][0] == '-') {
+			BatchUsage(argv[0]);
+			exit(EXIT_FAILURE);
+		} else {
+			roms[numRoms++] = argv[i];
+		}
+	}
+
+	if (numRoms == 0 || batch.numSeeds == 0 || batch.frameCycles == 0) {
+		BatchUsage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (batch.lanes && (batch.jit || batch.movie != NULL || batch.traceDirectory != NULL || batch.profileDirectory != NULL)) {
+		fprintf(stderr, "Error: --lanes cannot be combined with --jit, --movie, --trace or --profile.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Checkpoints sit on a frame boundary so that forked runs tick the timers exactly where a full run would.
+	batch.checkpointCycles = (batch.checkpointCycles + batch.frameCycles - 1) / batch.frameCycles * batch.frameCycles;
+	if (batch.checkpointCycles >= batch.cycleBudget) {
+		batch.checkpointCycles = 0;
+	}
+
+	// A replay has to run exactly as it was recorded.
+	if (batch.movie != NULL) {
+		batch.jit = CHIP8MovieMode(batch.movie) == CHIP8_MODE_JIT;
+		batch.variant = CHIP8MovieVariant(batch.movie);
+		batch.checkpointCycles = 0;
+	}
+
+	if (batch.variant == CHIP8_VARIANT_XOCHIP && (batch.jit || batch.lanes || batch.profileDirectory != NULL)) {
+		fprintf(stderr, "Error: XO-CHIP cannot be combined with --jit, --lanes or --profile.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	batch.roms = roms;
+	batch.images = (BatchImage *) malloc(numRoms * sizeof(BatchImage));
+	if (batch.images == NULL) {
+		fprintf(stderr, "Error: Cannot allocate %zu ROM images.\n", numRoms);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t numSeeds = batch.numSeeds;
+	size_t numInstances = numRoms * numSeeds;
+	batch.instances = (BatchInstance *) malloc(numInstances * sizeof(BatchInstance));
+	if (batch.instances == NULL) {
+		fprintf(stderr, "Error: Cannot allocate %zu instances.\n", numInstances);
+		exit(EXIT_FAILURE);
+	}
+
+	for (size_t r = 0; r < numRoms; ++r) {
+		for (size_t s = 0; s < numSeeds; ++s) {
+			batch.instances[r * numSeeds + s].romFileName = roms[r];
+			batch.instances[r * numSeeds + s].seed = batch.movie != NULL ? CHIP8MovieSeed(batch.movie) : s;
+		}
+	}
+
+	ThreadPool *pool = threadPoolInit(numThreads);
+	if (pool == NULL) {
+		fprintf(stderr, "Error: Cannot start worker threads.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (batch.traceDirectory != NULL) {
+		batch.traces = (CHIP8Trace **) malloc(threadPoolSize(pool) * sizeof(CHIP8Trace *));
+		for (size_t t = 0; batch.traces != NULL && t < threadPoolSize(pool); ++t) {
+			batch.traces[t] = CHIP8TraceInit(CHIP8_TRACE_DEFAULT_CAPACITY);
+			if (batch.traces[t] == NULL) {
+				batch.traces = NULL;
+			}
+		}
+
+		if (batch.traces == NULL) {
+			fprintf(stderr, "Error: Cannot allocate the traces.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (batch.profileDirectory != NULL) {
+		batch.profiles = (CHIP8Profile **) malloc(threadPoolSize(pool) * sizeof(CHIP8Profile *));
+		for (size_t t = 0; batch.profiles != NULL && t < threadPoolSize(pool); ++t) {
+			batch.profiles[t] = CHIP8ProfileInit(CHIP8_PROFILE_DEFAULT_SAMPLE_PERIOD);
+			if (batch.profiles[t] == NULL) {
+				batch.profiles = NULL;
+			}
+		}
+
+		if (batch.profiles == NULL) {
+			fprintf(stderr, "Error: Cannot allocate the profiles.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	double start = BatchNow();
+
+	threadPoolRun(pool, numRoms, BatchReadImage, &batch);
+	fprintf(stderr, "%zu ROMs read in %.3f s\n", numRoms, BatchNow() - start);
+
+	if (batch.checkpointCycles > 0) {
+		batch.checkpoints = (BatchCheckpoint *) malloc(numRoms * sizeof(BatchCheckpoint));
+		if (batch.checkpoints == NULL) {
+			fprintf(stderr, "Error: Cannot allocate %zu checkpoints.\n", numRoms);
+			exit(EXIT_FAILURE);
+		}
+
+		threadPoolRun(pool, numRoms, BatchRunCheckpoint, &batch);
+		fprintf(stderr, "%zu checkpoints at %llu cycles in %.3f s\n", numRoms, (unsigned long long) batch.checkpointCycles, BatchNow() - start);
+	}
+
+	size_t numGroups = 0;
+	if (batch.lanes) {
+		batch.groupsPerRom = (numSeeds + CHIP8_LANES_MAX - 1) / CHIP8_LANES_MAX;
+		numGroups = numRoms * batch.groupsPerRom;
+
+		batch.laneMetrics = (CHIP8LanesMetrics *) calloc(numGroups, sizeof(CHIP8LanesMetrics));
+		batch.scalarGroups = (bool *) calloc(numGroups, sizeof(bool));
+		if (batch.laneMetrics == NULL || batch.scalarGroups == NULL) {
+			fprintf(stderr, "Error: Cannot allocate %zu lane groups.\n", numGroups);
+			exit(EXIT_FAILURE);
+		}
+
+		threadPoolRun(pool, numGroups, BatchRunLanes, &batch);
+	} else {
+		threadPoolRun(pool, numInstances, BatchRunInstance, &batch);
+	}
+	double seconds = BatchNow() - start;
+
+	uint64_t totalCycles = 0;
+	uint64_t totalIdleCycles = 0;
+	double bootSeconds = 0;
+	size_t numFailed = 0;
+
+	printf("rom\tseed\tresult\tfault\thash\tcycles\tcycles/s\tidle\n");
+	for (size_t i = 0; i < numInstances; ++i) {
+		BatchInstance *instance = &batch.instances[i];
+
+		// pc:opcode of the instruction that failed, if it was one.
+		char fault[16] = "-";
+		if (instance->result != CHIP8_SUCCESS && instance->error.fault) {
+			snprintf(fault, sizeof(fault), "%03x:%04x", instance->error.pc, instance->error.opcode);
+		}
+
+		printf(
+			"%s\t%llu\t%s\t%s\t%016llx\t%llu\t%.0f\t%llu\n",
+			instance->romFileName,
+			(unsigned long long) instance->seed,
+			BatchResultName(instance->result),
+			fault,
+			(unsigned long long) instance->hash,
+			(unsigned long long) instance->cycles,
+			instance->seconds > 0 ? instance->cycles / instance->seconds : 0.0,
+			(unsigned long long) instance->idleCycles
+		);
+
+		totalCycles += instance->cycles;
+		totalIdleCycles += instance->idleCycles;
+		bootSeconds += instance->bootSeconds;
+		if (instance->result != CHIP8_SUCCESS) {
+			++numFailed;
+		}
+	}
+
+	fprintf(
+		stderr,
+		"%zu instances (%zu failed) on %zu threads: %llu cycles (%llu idle) in %.3f s, %.0f cycles/s; %.1f ms booting\n",
+		numInstances,
+		numFailed,
+		threadPoolSize(pool),
+		(unsigned long long) totalCycles,
+		(unsigned long long) totalIdleCycles,
+		seconds,
+		seconds > 0 ? totalCycles / seconds : 0.0,
+		bootSeconds * 1e3
+	);
+
+	if (batch.laneMetrics != NULL) {
+		uint64_t instructions = 0;
+		uint64_t vectorInstructions = 0;
+		double laneSteps = 0;
+		size_t numScalarGroups = 0;
+
+		// Utilization weighted by steps, over the lanes each group actually had.
+		for (size_t g = 0; g < numGroups; ++g) {
+			numScalarGroups += batch.scalarGroups[g];
+			instructions += batch.laneMetrics[g].instructions;
+			vectorInstructions += batch.laneMetrics[g].vectorInstructions;
+			laneSteps += batch.laneMetrics[g].utilization > 0 ? batch.laneMetrics[g].instructions / batch.laneMetrics[g].utilization : 0.0;
+		}
+
+		fprintf(
+			stderr,
+			"%zu lane groups (%zu went on without lanes): %.1f%% of instructions in lanes vectorized, %.1f%% lane utilization\n",
+			numGroups,
+			numScalarGroups,
+			instructions > 0 ? 100.0 * vectorInstructions / instructions : 0.0,
+			laneSteps > 0 ? 100.0 * instructions / laneSteps : 0.0
+		);
+
+		free(batch.laneMetrics);
+		free(batch.scalarGroups);
+	}
+
+	if (batch.movie != NULL) {
+		uint64_t frames = CHIP8MovieFrames(batch.movie);
+
+		fprintf(
+			stderr,
+			"replayed %llu frames per instance, %.0fx real time\n",
+			(unsigned long long) frames,
+			seconds > 0 ? numInstances * frames / (seconds * CHIP8_SCHEDULER_FRAME_RATE) : 0.0
+		);
+
+		CHIP8MovieDestroy(batch.movie);
+	}
+
+	if (batch.traces != NULL) {
+		for (size_t t = 0; t < threadPoolSize(pool); ++t) {
+			CHIP8TraceDestroy(batch.traces[t]);
+		}
+		free(batch.traces);
+	}
+
+	if (batch.profiles != NULL) {
+		for (size_t t = 0; t < threadPoolSize(pool); ++t) {
+			CHIP8ProfileDestroy(batch.profiles[t]);
+		}
+		free(batch.profiles);
+	}
+
+	threadPoolDestroy(pool);
+
+	if (batch.checkpoints != NULL) {
+		for (size_t r = 0; r < numRoms; ++r) {
+			if (batch.checkpoints[r].snapshot != NULL) {
+				CHIP8SnapshotDestroy(batch.checkpoints[r].snapshot);
+			}
+		}
+		free(batch.checkpoints);
+	}
+
+	for (size_t r = 0; r < numRoms; ++r) {
+		if (batch.images[r].chip8 != NULL) {
+			CHIP8Destroy(batch.images[r].chip8);
+		}
+	}
+
+	free(batch.instances);
+	free(batch.images);
+	free(roms);
+
+	return numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void BatchUsage(const char *program) {
+	fprintf(
+		stderr,
+		"Usage: %s [options] <rom>...\n"
+		"  --list <file>         read ROM paths from <file>, one per line\n"
+		"  --seeds <n>           run every ROM <n> times with random seeds 0..n-1 (default 1)\n"
+		"  --cycles <n>          instructions per instance (default %d)\n"
+		"  --frame-cycles <n>    instructions per 60 Hz timer tick (default %d)\n"
+		"  --checkpoint <n>      boot every ROM once with seed 0, run <n> instructions and fork all seeds from there\n"
+		"  --movie <file>        replay a recorded movie on every ROM instead of running --cycles;\n"
+		"                        seed, mode and variant come from the movie, --seeds repeats it\n"
+		"  --variant <name>      chip8, schip or xochip (default chip8); xochip cannot be combined\n"
+		"                        with --jit, --lanes or --profile\n"
+		"  --threads <n>         worker threads, 0 for one per core (default 0)\n"
+		"  --jit                 run with the JIT compiler\n"
+		"  --lanes               run the seeds of every ROM in lockstep, up to %d at a time in vector lanes;\n"
+		"                        a group that runs mostly one lane at a time goes on without them;\n"
+		"                        cannot be combined with --jit, --movie, --trace or --profile\n"
+		"  --trace <dir>         trace every instance and write the last %d instructions of\n"
+		"                        each failed one to <dir>/<rom>-<seed>.c8tr; implies interpreting\n"
+		"  --profile <dir>       profile every instance and write its report to <dir>/<rom>-<seed>.profile\n"
+		"                        and its memory heatmap to <dir>/<rom>-<seed>.ppm; implies interpreting\n",
+		program,
+		BATCH_DEFAULT_CYCLES,
+		BATCH_DEFAULT_FRAME_CYCLES,
+		CHIP8_LANES_MAX,
+		CHIP8_TRACE_DEFAULT_CAPACITY
+	);
+}
+
+// <directory>/<rom>-<seed>.<extension>, with the ROM's own directory left out.
+void BatchFileName(const char *directory, const BatchInstance *instance, const char *extension, char *fileName, size_t size) {
+	const char *romName = instance->romFileName;
+	for (const char *c = romName; *c != '\0'; ++c) {
+		if (*c == '/' || *c == '\\') {
+			romName = c + 1;
+		}
+	}
+
+	snprintf(fileName, size, "%s/%s-%llu.%s", directory, romName, (unsigned long long) instance->seed, extension);
+}
+
+void BatchDumpTrace(const Batch *batch, const BatchInstance *instance, const CHIP8Trace *trace) {
+	char fileName[1024];
+	BatchFileName(batch->traceDirectory, instance, "c8tr", fileName, sizeof(fileName));
+
+	if (!CHIP8TraceDump(trace, fileName)) {
+		fprintf(stderr, "Error: Cannot write trace %s.\n", fileName);
+	}
+}
+
+void BatchWriteProfile(const Batch *batch, const BatchInstance *instance, const CHIP8Profile *profile, const CHIP8 *chip8) {
+	char fileName[1024];
+	BatchFileName(batch->profileDirectory, instance, "profile", fileName, sizeof(fileName));
+
+	if (!CHIP8ProfileWriteReport(profile, chip8, fileName, CHIP8_PROFILE_DEFAULT_TOP)) {
+		fprintf(stderr, "Error: Cannot write profile %s.\n", fileName);
+	}
+
+	BatchFileName(batch->profileDirectory, instance, "ppm", fileName, sizeof(fileName));
+
+	if (!CHIP8ProfileWriteHeatmap(profile, fileName, 8)) {
+		fprintf(stderr, "Error: Cannot write heatmap %s.\n", fileName);
+	}
+}
+
+char **BatchReadList(const char *fileName, size_t *numRoms) {
+	FILE *file = fopen(fileName, "r");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	size_t capacity = 16;
+	char **roms = (char **) malloc(capacity * sizeof(char *));
+	char line[BATCH_MAX_LINE_SIZE];
+
+	*numRoms = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		size_t length = strcspn(line, "\r\n");
+		if (length == 0) {
+			continue;
+		}
+
+		if (*numRoms == capacity) {
+			capacity *= 2;
+			roms = (char **) realloc(roms, capacity * sizeof(char *));
+		}
+
+		roms[*numRoms] = (char *) malloc(length + 1);
+		memcpy(roms[*numRoms], line, length);
+		roms[*numRoms][length] = '\0';
+		++*numRoms;
+	}
+
+	fclose(file);
+
+	return roms;
+}
+
+void BatchReadImage(void *context, size_t index, size_t worker) {
+	Batch *batch = (Batch *) context;
+	BatchImage *image = &batch->images[index];
+
+	uint8_t rom[CHIP8_MAX_ROM_SIZE];
+	size_t size;
+
+	image->chip8 = NULL;
+	image->result = CHIP8ReadROM(batch->roms[index], rom, &size);
+	if (image->result != CHIP8_SUCCESS) {
+		return;
+	}
+
+	image->chip8 = CHIP8Init(0);
+	if (image->chip8 == NULL) {
+		image->result = CHIP8_ERROR_INIT_FAILED;
+		return;
+	}
+
+	image->result = CHIP8LoadFontset(image->chip8, CHIP8Fontset, CHIP8_FONTSET_SIZE);
+	if (image->result == CHIP8_SUCCESS) {
+		image->result = CHIP8SetVariant(image->chip8, batch->variant);
+	}
+	if (image->result == CHIP8_SUCCESS) {
+		image->result = CHIP8LoadROMFromMemory(image->chip8, rom, size);
+	}
+
+	CHIP8DecodeMemory(image->chip8);
+}
+
+void BatchRunCheckpoint(void *context, size_t index, size_t worker) {
+	Batch *batch = (Batch *) context;
+	BatchCheckpoint *checkpoint = &batch->checkpoints[index];
+
+	checkpoint->snapshot = NULL;
+	checkpoint->cycles = 0;
+	checkpoint->error.fault = false;
+
+	CHIP8 *chip8;
+	checkpoint->result = BatchBoot(batch, &batch->images[index], 0, &chip8);
+	if (chip8 == NULL) {
+		return;
+	}
+
+	if (checkpoint->result == CHIP8_SUCCESS) {
+		checkpoint->result = BatchRunFrames(batch, chip8, 0, batch->checkpointCycles);
+	}
+
+	if (checkpoint->result == CHIP8_SUCCESS) {
+		checkpoint->snapshot = CHIP8SnapshotCapture(chip8, NULL);
+		if (checkpoint->snapshot == NULL) {
+			checkpoint->result = CHIP8_ERROR_INIT_FAILED;
+		}
+	}
+
+	checkpoint->cycles = chip8->cycles;
+	checkpoint->error = chip8->error;
+
+	CHIP8Destroy(chip8);
+}
+
+void BatchRunInstance(void *context, size_t index, size_t worker) {
+	Batch *batch = (Batch *) context;
+	BatchInstance *instance = &batch->instances[index];
+
+	uint64_t frameStart;
+	CHIP8 *chip8 = BatchStartInstance(batch, index, &frameStart);
+	if (chip8 == NULL) {
+		return;
+	}
+
+	if (batch->traces != NULL) {
+		CHIP8TraceClear(batch->traces[worker]);
+		CHIP8SetTrace(chip8, batch->traces[worker]);
+	}
+	if (batch->profiles != NULL) {
+		CHIP8ProfileClear(batch->profiles[worker]);
+
+		CHIP8Result result = CHIP8SetProfile(chip8, batch->profiles[worker]);
+		if (instance->result == CHIP8_SUCCESS) {
+			instance->result = result;
+		}
+	}
+
+	double start = BatchNow();
+
+	if (instance->result == CHIP8_SUCCESS) {
+		if (batch->movie != NULL) {
+			instance->result = CHIP8MoviePlay(batch->movie, chip8);
+		} else {
+			instance->result = BatchRunFrames(batch, chip8, frameStart, batch->cycleBudget);
+		}
+	}
+
+	instance->seconds = BatchNow() - start;
+
+	BatchFinishInstance(batch, index, worker, chip8);
+}
+
+// Runs the seeds of one group of one ROM in lockstep. Each is charged an equal
+// share of the time the group took.
+void BatchRunLanes(void *context, size_t index, size_t worker) {
+	Batch *batch = (Batch *) context;
+
+	size_t first = (index / batch->groupsPerRom) * batch->numSeeds + (index % batch->groupsPerRom) * CHIP8_LANES_MAX;
+	size_t end = (index / batch->groupsPerRom + 1) * batch->numSeeds;
+	if (end > first + CHIP8_LANES_MAX) {
+		end = first + CHIP8_LANES_MAX;
+	}
+
+	CHIP8 *chip8s[CHIP8_LANES_MAX];
+	CHIP8 *machines[CHIP8_LANES_MAX];
+	size_t numLanes = 0;
+	uint64_t frameStart = 0;
+
+	for (size_t i = first; i < end; ++i) {
+		chip8s[i - first] = BatchStartInstance(batch, i, &frameStart);
+		if (chip8s[i - first] != NULL && batch->instances[i].result == CHIP8_SUCCESS) {
+			machines[numLanes++] = chip8s[i - first];
+		}
+	}
+
+	if (numLanes > 0) {
+		double start = BatchNow();
+
+		CHIP8Result results[CHIP8_LANES_MAX];
+		CHIP8Lanes *lanes = CHIP8LanesInit(machines, numLanes);
+		if (lanes != NULL) {
+			batch->scalarGroups[index] = BatchRunLaneChecks(batch, lanes, machines, numLanes, frameStart, results);
+			CHIP8LanesGetMetrics(lanes, &batch->laneMetrics[index]);
+		}
+
+		double seconds = (BatchNow() - start) / numLanes;
+
+		for (size_t i = first, l = 0; i < end; ++i) {
+			BatchInstance *instance = &batch->instances[i];
+			if (chip8s[i - first] != NULL && instance->result == CHIP8_SUCCESS) {
+				instance->result = lanes != NULL ? results[l++] : CHIP8_ERROR_INIT_FAILED;
+				instance->seconds = seconds;
+			}
+		}
+
+		if (lanes != NULL) {
+			CHIP8LanesDestroy(lanes);
+		}
+	}
+
+	for (size_t i = first; i < end; ++i) {
+		if (chip8s[i - first] != NULL) {
+			BatchFinishInstance(batch, i, worker, chip8s[i - first]);
+		}
+	}
+}
+
+// Runs the lanes a check of about BATCH_LANES_CHECK_CYCLES at a time, and once
+// a check ran more than BATCH_LANES_MAX_SCALAR_SHARE of its instructions one
+// lane at a time, the rest one machine at a time. Returns whether it came to
+// that, with each lane's result in results.
+bool BatchRunLaneChecks(const Batch *batch, CHIP8Lanes *lanes, CHIP8 **machines, size_t numLanes, uint64_t frameStart, CHIP8Result *results) {
+	// Checks end with a frame, so that the frames go on across them.
+	uint64_t checkCycles = (BATCH_LANES_CHECK_CYCLES + batch->frameCycles - 1) / batch->frameCycles * batch->frameCycles;
+	uint64_t checkStart = frameStart;
+	CHIP8LanesMetrics before = { 0, 0, 0, 0.0 };
+	bool scalar = false;
+
+	while (!scalar && checkStart < batch->cycleBudget) {
+		uint64_t checkEnd = batch->cycleBudget - checkStart > checkCycles ? checkStart + checkCycles : batch->cycleBudget;
+		CHIP8LanesRun(lanes, checkStart, batch->frameCycles, checkEnd);
+
+		CHIP8LanesMetrics metrics;
+		CHIP8LanesGetMetrics(lanes, &metrics);
+
+		uint64_t instructions = metrics.instructions - before.instructions;
+		uint64_t vectorInstructions = metrics.vectorInstructions - before.vectorInstructions;
+		scalar = instructions - vectorInstructions > BATCH_LANES_MAX_SCALAR_SHARE * instructions;
+
+		before = metrics;
+		checkStart = checkEnd;
+	}
+
+	for (size_t l = 0; l < numLanes; ++l) {
+		results[l] = CHIP8LanesResult(lanes, l);
+
+		if (scalar && results[l] == CHIP8_SUCCESS) {
+			results[l] = BatchRunFrames(batch, machines[l], checkStart, batch->cycleBudget);
+		}
+	}
+
+	return scalar;
+}
+
+// Boots instance index, or forks it from its ROM's checkpoint, and returns its
+// machine with the frame it resumes at in frameStart. Returns NULL, with the
+// result recorded, when there is no machine to run or report on.
+CHIP8 *BatchStartInstance(Batch *batch, size_t index, uint64_t *frameStart) {
+	BatchInstance *instance = &batch->instances[index];
+
+	instance->cycles = 0;
+	instance->idleCycles = 0;
+	instance->hash = 0;
+	instance->seconds = 0;
+	instance->bootSeconds = 0;
+	instance->error.fault = false;
+
+	CHIP8 *chip8;
+	*frameStart = 0;
+
+	double bootStart = BatchNow();
+
+	if (batch->checkpoints != NULL) {
+		BatchCheckpoint *checkpoint = &batch->checkpoints[index / batch->numSeeds];
+
+		instance->result = checkpoint->result;
+		if (instance->result != CHIP8_SUCCESS) {
+			instance->cycles = checkpoint->cycles;
+			instance->error = checkpoint->error;
+			return NULL;
+		}
+
+		chip8 = CHIP8Init(instance->seed);
+		if (chip8 == NULL) {
+			instance->result = CHIP8_ERROR_INIT_FAILED;
+			return NULL;
+		}
+
+		if (batch->jit) {
+			instance->result = CHIP8SetMode(chip8, CHIP8_MODE_JIT);
+		}
+
+		// The checkpoint was reached with seed 0; each fork diverges from there with its own seed.
+		if (instance->result == CHIP8_SUCCESS) {
+			instance->result = CHIP8SnapshotRestore(checkpoint->snapshot, chip8);
+		}
+		CHIP8Seed(chip8, instance->seed);
+		chip8->cycles = checkpoint->cycles;
+		*frameStart = batch->checkpointCycles;
+	} else {
+		instance->result = BatchBoot(batch, &batch->images[index / batch->numSeeds], instance->seed, &chip8);
+		if (chip8 == NULL) {
+			return NULL;
+		}
+	}
+
+	instance->bootSeconds = BatchNow() - bootStart;
+
+	return chip8;
+}
+
+// Records how instance index ended up, with its trace and profile, and destroys its machine.
+void BatchFinishInstance(Batch *batch, size_t index, size_t worker, CHIP8 *chip8) {
+	BatchInstance *instance = &batch->instances[index];
+
+	instance->cycles = chip8->cycles;
+	instance->idleCycles = chip8->idleCycles;
+	instance->hash = CHIP8Hash(chip8);
+	instance->error = chip8->error;
+
+	if (batch->traces != NULL && instance->result != CHIP8_SUCCESS) {
+		BatchDumpTrace(batch, instance, batch->traces[worker]);
+	}
+	if (batch->profiles != NULL) {
+		BatchWriteProfile(batch, instance, batch->profiles[worker], chip8);
+	}
+
+	CHIP8Destroy(chip8);
+}
+
+CHIP8Result BatchBoot(const Batch *batch, const BatchImage *image, uint64_t seed, CHIP8 **chip8) {
+	*chip8 = CHIP8Init(seed);
+	if (*chip8 == NULL) {
+		return CHIP8_ERROR_INIT_FAILED;
+	}
+
+	if (image->result != CHIP8_SUCCESS) {
+		CHIP8SetError(*chip8, image->result);
+		return image->result;
+	}
+
+	CHIP8Result result = CHIP8ShareMemory(*chip8, image->chip8);
+
+	// The image already holds the big font, so this shares rather than copies its page.
+	if (result == CHIP8_SUCCESS) {
+		result = CHIP8SetVariant(*chip8, batch->variant);
+	}
+	if (result == CHIP8_SUCCESS && batch->jit) {
+		result = CHIP8SetMode(*chip8, CHIP8_MODE_JIT);
+	}
+
+	return result;
+}
+
+// CHIP8_NUM_VARIANTS if name is none of CHIP8VariantNames.
+CHIP8Variant BatchParseVariant(const char *name) {
+	for (int variant = 0; variant < CHIP8_NUM_VARIANTS; ++variant) {
+		if (strcmp(name, CHIP8VariantNames[variant]) == 0) {
+			return (CHIP8Variant) variant;
+		}
+	}
+
+	return CHIP8_NUM_VARIANTS;
+}
+
+// Runs whole frames, counting from the frame that starts at frameStart, until endCycle.
+CHIP8Result BatchRunFrames(const Batch *batch, CHIP8 *chip8, uint64_t frameStart, uint64_t endCycle) {
+	CHIP8Result result = CHIP8_SUCCESS;
+
+	for (uint64_t frameEnd = frameStart + batch->frameCycles; result == CHIP8_SUCCESS && chip8->cycles < endCycle; frameEnd += batch->frameCycles) {
+		result = CHIP8SchedulerRunFrame(chip8, frameEnd < endCycle ? frameEnd : endCycle);
+	}
+
+	return result;
+}
+
+const char *BatchResultName(CHIP8Result result) {
+	switch (result) {
+		case CHIP8_SUCCESS:
+			return "ok";
+		case CHIP8_ERROR_INIT_FAILED:
+			return "init-failed";
+		case CHIP8_ERROR_INVALID_FONTSET:
+			return "invalid-fontset";
+		case CHIP8_ERROR_OPEN_FILE_FAILED:
+			return "open-failed";
+		case CHIP8_ERROR_SEGFAULT:
+			return "segfault";
+		case CHIP8_ERROR_STACK_UNDERFLOW:
+			return "stack-underflow";
+		case CHIP8_ERROR_STACK_OVERFLOW:
+			return "stack-overflow";
+		case CHIP8_ERROR_KEY_NOT_FOUND:
+			return "key-not-found";
+		case CHIP8_ERROR_INSTRUCTION_NOT_FOUND:
+			return "instruction-not-found";
+		case CHIP8_ERROR_JIT_UNAVAILABLE:
+			return "jit-unavailable";
+		case CHIP8_ERROR_INVALID_STATE:
+			return "invalid-state";
+		case CHIP8_ERROR_MOVIE_DESYNC:
+			return "desync";
+		case CHIP8_ERROR_ROM_TOO_LARGE:
+			return "rom-too-large";
+		case CHIP8_ERROR_OUT_OF_MEMORY:
+			return "out-of-memory";
+		case CHIP8_ERROR_PROFILE_UNAVAILABLE:
+			return "profile-unavailable";
+		default:
+			return "unknown";
+	}
+}
+
+double BatchNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
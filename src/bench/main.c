@@ -0,0 +1,685 @@
+#include <core/chip8.h>
+#include <core/chip8_display.h>
+#include <core/chip8_lanes.h>
+#include <core/chip8_profile.h>
+#include <core/chip8_scheduler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_DEFAULT_CYCLES 20000000
+#define BENCH_DEFAULT_REPEAT 5
+#define BENCH_DEFAULT_FRAME_CYCLES CHIP8_SCHEDULER_DEFAULT_INSTRUCTIONS_PER_FRAME
+#define BENCH_DISPLAY_FRAMES 256
+
+// A synthetic ROM that loops forever over the path it is named after.
+typedef struct {
+	const char *name;
+	const uint8_t *rom;
+	size_t size;
+} BenchWorkload;
+
+typedef struct {
+	const BenchWorkload *workload;
+	CHIP8Mode mode;
+	// Runs CHIP8_LANES_MAX interpreted machines with seeds 0.. in lockstep, each
+	// for the whole budget, instead of one machine in mode.
+	bool lanes;
+
+	CHIP8Result result;
+	// Instructions and time of the fastest repetition.
+	uint64_t cycles;
+	double seconds;
+	// Over the fastest repetition; -1 when the counter is unavailable.
+	int64_t cacheMisses;
+	// Share of the lanes busy in the average step; -1 without lanes.
+	double laneUtilization;
+} BenchRun;
+
+// Expanding a whole frame into ARGB8888 pixels at one scale.
+typedef struct {
+	uint32_t scale;
+	// Per frame, in the fastest repetition.
+	double seconds;
+} BenchDisplayRun;
+
+typedef struct {
+	uint64_t cycleBudget;
+	uint64_t frameCycles;
+	size_t repeat;
+	// Runs every machine with a profile attached, to see what profiling costs.
+	bool profile;
+} Bench;
+
+// Ten 8xy* per jump.
+static const uint8_t BenchALU[] = {
+	0x60, 0x01,		// 200: LD V0, 01
+	0x61, 0x03,		// 202: LD V1, 03
+	0x80, 0x14,		// 204: ADD V0, V1
+	0x81, 0x05,		// 206: SUB V1, V0
+	0x82, 0x01,		// 208: OR V2, V0
+	0x83, 0x12,		// 20a: AND V3, V1
+	0x84, 0x23,		// 20c: XOR V4, V2
+	0x85, 0x36,		// 20e: SHR V5, V3
+	0x86, 0x47,		// 210: SUBN V6, V4
+	0x87, 0x5E,		// 212: SHL V7, V5
+	0x88, 0x70,		// 214: LD V8, V7
+	0x80, 0x84,		// 216: ADD V0, V8
+	0x12, 0x04		// 218: JP 204
+};
+
+// Three nested calls and their returns per jump.
+static const uint8_t BenchCall[] = {
+	0x22, 0x04,		// 200: CALL 204
+	0x12, 0x00,		// 202: JP 200
+	0x22, 0x08,		// 204: CALL 208
+	0x00, 0xEE,		// 206: RET
+	0x22, 0x0C,		// 208: CALL 20c
+	0x00, 0xEE,		// 20a: RET
+	0x00, 0xEE		// 20c: RET
+};
+
+// A 15 and an 8 row sprite per jump, walking across the screen so that they wrap and collide.
+static const uint8_t BenchDraw[] = {
+	0xA2, 0x10,		// 200: LD I, 210
+	0xD0, 0x1F,		// 202: DRW V0, V1, F
+	0x70, 0x05,		// 204: ADD V0, 05
+	0x71, 0x03,		// 206: ADD V1, 03
+	0xD0, 0x18,		// 208: DRW V0, V1, 8
+	0x12, 0x02,		// 20a: JP 202
+	0x00, 0x00,
+	0x00, 0x00,
+	0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF,		// 210: sprite
+	0x3C, 0x42, 0x99, 0xA5, 0x99, 0x42, 0x3C
+};
+
+// Stores and loads all sixteen registers per jump; V0 changes every time, so every store really writes.
+static const uint8_t BenchMemory[] = {
+	0xA8, 0x00,		// 200: LD I, 800
+	0x70, 0x01,		// 202: ADD V0, 01
+	0xFF, 0x55,		// 204: LD [I], VF
+	0xFF, 0x65,		// 206: LD VF, [I]
+	0x12, 0x02		// 208: JP 202
+};
+
+static const BenchWorkload BenchWorkloads[] = {
+	{ "alu", BenchALU, sizeof(BenchALU) },
+	{ "call", BenchCall, sizeof(BenchCall) },
+	{ "draw", BenchDraw, sizeof(BenchDraw) },
+	{ "memory", BenchMemory, sizeof(BenchMemory) }
+};
+
+#define BENCH_NUM_WORKLOADS (sizeof(BenchWorkloads) / sizeof(BenchWorkloads[0]))
+
+// From the bare display up to a 1920x960 window.
+static const uint32_t BenchDisplayScales[] = { 1, 4, 10, 20, 30 };
+
+#define BENCH_NUM_DISPLAY_SCALES (sizeof(BenchDisplayScales) / sizeof(BenchDisplayScales[0]))
+
+static void BenchUsage(const char *program);
+static void BenchRunWorkload(const Bench *bench, BenchRun *run);
+static CHIP8Result BenchRunOnce(const Bench *bench, const BenchRun *run, uint64_t *cycles, double *seconds, int64_t *cacheMisses);
+static CHIP8Result BenchRunLanes(const Bench *bench, const BenchRun *run, uint64_t *cycles, double *seconds, int64_t *cacheMisses, double *utilization);
+static bool BenchRunDisplay(const Bench *bench, BenchDisplayRun *run);
+static void BenchPrintText(const BenchRun *runs, size_t numRuns);
+static void BenchPrintDisplayText(const BenchDisplayRun *runs, size_t numRuns);
+static void BenchPrintDisplayJSON(const Bench *bench, const char *label, const BenchDisplayRun *runs, size_t numRuns);
+static void BenchPrintJSON(const Bench *bench, const char *label, const BenchRun *runs, size_t numRuns);
+static void BenchPrintJSONString(const char *text);
+static int BenchCounterOpen();
+static void BenchCounterStart(int counter);
+static int64_t BenchCounterStop(int counter);
+static const char *BenchModeName(const BenchRun *run);
+static const char *BenchResultName(CHIP8Result result);
+static double BenchNow();
+
+int main(int argc, char *argv[]) {
+	Bench bench = { BENCH_DEFAULT_CYCLES, BENCH_DEFAULT_FRAME_CYCLES, BENCH_DEFAULT_REPEAT, false };
+	const char *filter = NULL;
+	const char *label = NULL;
+	bool json = false;
+	bool display = false;
+	bool interpreter = true;
+	bool jit = true;
+	bool lanes = true;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+			bench.cycleBudget = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--frame-cycles") == 0 && i + 1 < argc) {
+			bench.frameCycles = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			bench.repeat = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+			++i;
+			interpreter = strcmp(argv[i], "interpreter") == 0 || strcmp(argv[i], "all") == 0;
+			jit = strcmp(argv[i], "jit") == 0 || strcmp(argv[i], "all") == 0;
+			lanes = strcmp(argv[i], "lanes") == 0 || strcmp(argv[i], "all") == 0;
+		} else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+			label = argv[++i];
+		} else if (strcmp(argv[i], "--json") == 0) {
+			json = true;
+		} else if (strcmp(argv[i], "--display") == 0) {
+			display = true;
+		} else if (strcmp(argv[i], "--profile") == 0) {
+			bench.profile = true;
+		} else if (argv[i][0] == '-') {
+			BenchUsage(argv[0]);
+			exit(EXIT_FAILURE);
+		} else {
+			filter = argv[i];
+		}
+	}
+
+	// Lanes run no profiles.
+	lanes = lanes && !bench.profile;
+
+	if (bench.cycleBudget == 0 || bench.frameCycles == 0 || bench.repeat == 0 || (!interpreter && !jit && !lanes)) {
+		BenchUsage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (display) {
+		BenchDisplayRun displayRuns[BENCH_NUM_DISPLAY_SCALES];
+
+		for (size_t r = 0; r < BENCH_NUM_DISPLAY_SCALES; ++r) {
+			displayRuns[r].scale = BenchDisplayScales[r];
+
+			if (!BenchRunDisplay(&bench, &displayRuns[r])) {
+				fprintf(stderr, "Error: Cannot allocate a %ux display.\n", displayRuns[r].scale);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		if (json) {
+			BenchPrintDisplayJSON(&bench, label, displayRuns, BENCH_NUM_DISPLAY_SCALES);
+		} else {
+			BenchPrintDisplayText(displayRuns, BENCH_NUM_DISPLAY_SCALES);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	BenchRun runs[3 * BENCH_NUM_WORKLOADS];
+	size_t numRuns = 0;
+
+	for (size_t w = 0; w < BENCH_NUM_WORKLOADS; ++w) {
+		if (filter != NULL && strcmp(filter, BenchWorkloads[w].name) != 0) {
+			continue;
+		}
+
+		for (int m = 0; m < 3; ++m) {
+			if ((m == 0 && !interpreter) || (m == 1 && !jit) || (m == 2 && !lanes)) {
+				continue;
+			}
+
+			BenchRun *run = &runs[numRuns++];
+			run->workload = &BenchWorkloads[w];
+			run->mode = m == 1 ? CHIP8_MODE_JIT : CHIP8_MODE_INTERPRETER;
+			run->lanes = m == 2;
+
+			BenchRunWorkload(&bench, run);
+		}
+	}
+
+	if (numRuns == 0) {
+		fprintf(stderr, "Error: No benchmark is called %s.\n", filter);
+		exit(EXIT_FAILURE);
+	}
+
+	if (json) {
+		BenchPrintJSON(&bench, label, runs, numRuns);
+	} else {
+		BenchPrintText(runs, numRuns);
+	}
+
+	size_t numFailed = 0;
+	for (size_t r = 0; r < numRuns; ++r) {
+		if (runs[r].result != CHIP8_SUCCESS) {
+			++numFailed;
+		}
+	}
+
+	return numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void BenchUsage(const char *program) {
+	fprintf(
+		stderr,
+		"Usage: %s [options] [benchmark]\n"
+		"  Runs every synthetic ROM (alu, call, draw, memory), or only [benchmark].\n"
+		"  --cycles <n>          instructions per repetition (default %d)\n"
+		"  --frame-cycles <n>    instructions per 60 Hz timer tick (default %d)\n"
+		"  --repeat <n>          repetitions, of which the fastest is reported (default %d)\n"
+		"  --mode <mode>         interpreter, jit, lanes or all (default all); lanes runs %d machines\n"
+		"                        in lockstep and counts all of their instructions\n"
+		"  --json                print JSON instead of a table\n"
+		"  --profile             attach a profile to every machine; implies interpreting, without lanes\n"
+		"  --display             time expanding a frame into ARGB8888 pixels at several window sizes\n"
+		"                        instead of running ROMs\n"
+		"  --label <text>        tag the JSON with <text>, e.g. the commit\n",
+		program,
+		BENCH_DEFAULT_CYCLES,
+		BENCH_DEFAULT_FRAME_CYCLES,
+		BENCH_DEFAULT_REPEAT,
+		CHIP8_LANES_MAX
+	);
+}
+
+void BenchRunWorkload(const Bench *bench, BenchRun *run) {
+	run->result = CHIP8_SUCCESS;
+	run->cycles = 0;
+	run->seconds = 0;
+	run->cacheMisses = -1;
+	run->laneUtilization = -1;
+
+	// The machine is noisy; the fastest repetition is the one least disturbed by it.
+	for (size_t r = 0; r < bench->repeat && run->result == CHIP8_SUCCESS; ++r) {
+		uint64_t cycles;
+		double seconds;
+		int64_t cacheMisses;
+		double laneUtilization = -1;
+
+		if (run->lanes) {
+			run->result = BenchRunLanes(bench, run, &cycles, &seconds, &cacheMisses, &laneUtilization);
+		} else {
+			run->result = BenchRunOnce(bench, run, &cycles, &seconds, &cacheMisses);
+		}
+
+		// JIT blocks may overshoot the budget, so compare time per instruction.
+		if (r == 0 || seconds * run->cycles < run->seconds * cycles) {
+			run->cycles = cycles;
+			run->seconds = seconds;
+			run->cacheMisses = cacheMisses;
+			run->laneUtilization = laneUtilization;
+		}
+	}
+}
+
+CHIP8Result BenchRunOnce(const Bench *bench, const BenchRun *run, uint64_t *cycles, double *seconds, int64_t *cacheMisses) {
+	*cycles = 0;
+	*seconds = 0;
+	*cacheMisses = -1;
+
+	CHIP8 *chip8 = CHIP8Init(0);
+	if (chip8 == NULL) {
+		return CHIP8_ERROR_INIT_FAILED;
+	}
+
+	CHIP8Result result = CHIP8LoadFontset(chip8, CHIP8Fontset, CHIP8_FONTSET_SIZE);
+	if (result == CHIP8_SUCCESS) {
+		result = CHIP8LoadROMFromMemory(chip8, run->workload->rom, run->workload->size);
+	}
+	if (result == CHIP8_SUCCESS) {
+		result = CHIP8SetMode(chip8, run->mode);
+	}
+
+	CHIP8Profile *profile = NULL;
+	if (bench->profile) {
+		profile = CHIP8ProfileInit(CHIP8_PROFILE_DEFAULT_SAMPLE_PERIOD);
+		if (profile == NULL) {
+			CHIP8Destroy(chip8);
+			return CHIP8_ERROR_INIT_FAILED;
+		}
+
+		if (result == CHIP8_SUCCESS) {
+			result = CHIP8SetProfile(chip8, profile);
+		}
+	}
+
+	int counter = BenchCounterOpen();
+	BenchCounterStart(counter);
+	double start = BenchNow();
+
+	for (uint64_t frameEnd = bench->frameCycles; result == CHIP8_SUCCESS && chip8->cycles < bench->cycleBudget; frameEnd += bench->frameCycles) {
+		result = CHIP8SchedulerRunFrame(chip8, frameEnd < bench->cycleBudget ? frameEnd : bench->cycleBudget);
+	}
+
+	*seconds = BenchNow() - start;
+	*cacheMisses = BenchCounterStop(counter);
+	*cycles = chip8->cycles;
+
+	CHIP8Destroy(chip8);
+	if (profile != NULL) {
+		CHIP8ProfileDestroy(profile);
+	}
+
+	return result;
+}
+
+CHIP8Result BenchRunLanes(const Bench *bench, const BenchRun *run, uint64_t *cycles, double *seconds, int64_t *cacheMisses, double *utilization) {
+	*cycles = 0;
+	*seconds = 0;
+	*cacheMisses = -1;
+
+	CHIP8 *machines[CHIP8_LANES_MAX];
+	CHIP8Result result = CHIP8_SUCCESS;
+
+	for (size_t l = 0; l < CHIP8_LANES_MAX; ++l) {
+		machines[l] = CHIP8Init(l);
+		if (machines[l] == NULL) {
+			result = CHIP8_ERROR_INIT_FAILED;
+		}
+
+		if (result == CHIP8_SUCCESS) {
+			result = CHIP8LoadFontset(machines[l], CHIP8Fontset, CHIP8_FONTSET_SIZE);
+		}
+		if (result == CHIP8_SUCCESS) {
+			result = CHIP8LoadROMFromMemory(machines[l], run->workload->rom, run->workload->size);
+		}
+	}
+
+	CHIP8Lanes *lanes = result == CHIP8_SUCCESS ? CHIP8LanesInit(machines, CHIP8_LANES_MAX) : NULL;
+	if (lanes != NULL) {
+		int counter = BenchCounterOpen();
+		BenchCounterStart(counter);
+		double start = BenchNow();
+
+		CHIP8LanesRun(lanes, 0, bench->frameCycles, bench->cycleBudget);
+
+		*seconds = BenchNow() - start;
+		*cacheMisses = BenchCounterStop(counter);
+
+		CHIP8LanesMetrics metrics;
+		CHIP8LanesGetMetrics(lanes, &metrics);
+		*utilization = metrics.utilization;
+
+		for (size_t l = 0; l < CHIP8_LANES_MAX; ++l) {
+			if (result == CHIP8_SUCCESS) {
+				result = CHIP8LanesResult(lanes, l);
+			}
+			*cycles += machines[l]->cycles;
+		}
+
+		CHIP8LanesDestroy(lanes);
+	} else if (result == CHIP8_SUCCESS) {
+		result = CHIP8_ERROR_INIT_FAILED;
+	}
+
+	for (size_t l = 0; l < CHIP8_LANES_MAX; ++l) {
+		if (machines[l] != NULL) {
+			CHIP8Destroy(machines[l]);
+		}
+	}
+
+	return result;
+}
+
+// Expands a full, fresh frame BENCH_DISPLAY_FRAMES times per repetition, as the
+// app does into its texture. Returns false if the pixels cannot be allocated.
+bool BenchRunDisplay(const Bench *bench, BenchDisplayRun *run) {
+	CHIP8Palette palette = { CHIP8_PALETTE_DEFAULT_FOREGROUND, CHIP8_PALETTE_DEFAULT_BACKGROUND, CHIP8_PALETTE_DEFAULT_SECONDARY, CHIP8_PALETTE_DEFAULT_OVERLAP };
+	int pitch = (int) (CHIP8_DISPLAY_WIDTH * run->scale * sizeof(uint32_t));
+
+	uint32_t *pixels = (uint32_t *) malloc((size_t) pitch * CHIP8_DISPLAY_HEIGHT * run->scale);
+	if (pixels == NULL) {
+		return false;
+	}
+
+	// A CHIP-8 frame: lores, one plane.
+	uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+	memset(display, 0, sizeof(display));
+	uint64_t pattern = 0x9e3779b97f4a7c15;
+
+	run->seconds = 0;
+
+	for (size_t r = 0; r < bench->repeat; ++r) {
+		double start = BenchNow();
+
+		for (size_t f = 0; f < BENCH_DISPLAY_FRAMES; ++f) {
+			for (size_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+				pattern ^= pattern << 13;
+				pattern ^= pattern >> 7;
+				pattern ^= pattern << 17;
+				display[0][y][0] = pattern;
+			}
+
+			CHIP8ExpandDisplay(&display[0][0][0], CHIP8_DISPLAY_WIDTH, 0, CHIP8_DISPLAY_HEIGHT, &palette, run->scale, pixels, pitch);
+		}
+
+		double seconds = (BenchNow() - start) / BENCH_DISPLAY_FRAMES;
+		if (r == 0 || seconds < run->seconds) {
+			run->seconds = seconds;
+		}
+	}
+
+	free(pixels);
+
+	return true;
+}
+
+void BenchPrintText(const BenchRun *runs, size_t numRuns) {
+	printf("benchmark\tmode\tresult\tinstructions/s\tns/instruction\tcache misses\tlane utilization\n");
+
+	for (size_t r = 0; r < numRuns; ++r) {
+		const BenchRun *run = &runs[r];
+
+		char cacheMisses[32] = "-";
+		if (run->cacheMisses >= 0) {
+			snprintf(cacheMisses, sizeof(cacheMisses), "%lld", (long long) run->cacheMisses);
+		}
+
+		char laneUtilization[32] = "-";
+		if (run->laneUtilization >= 0) {
+			snprintf(laneUtilization, sizeof(laneUtilization), "%.1f%%", 100.0 * run->laneUtilization);
+		}
+
+		printf(
+			"%s\t%s\t%s\t%.0f\t%.2f\t%s\t%s\n",
+			run->workload->name,
+			BenchModeName(run),
+			BenchResultName(run->result),
+			run->seconds > 0 ? run->cycles / run->seconds : 0.0,
+			run->cycles > 0 ? run->seconds * 1e9 / run->cycles : 0.0,
+			cacheMisses,
+			laneUtilization
+		);
+	}
+}
+
+// One object per run, so that a script can compare them by name and mode across commits.
+void BenchPrintJSON(const Bench *bench, const char *label, const BenchRun *runs, size_t numRuns) {
+	printf("{\n\t\"label\": ");
+	if (label != NULL) {
+		BenchPrintJSONString(label);
+	} else {
+		printf("null");
+	}
+
+	printf(
+		",\n\t\"cycles\": %llu,\n\t\"frame_cycles\": %llu,\n\t\"repeat\": %zu,\n\t\"profile\": %s,\n\t\"benchmarks\": [\n",
+		(unsigned long long) bench->cycleBudget,
+		(unsigned long long) bench->frameCycles,
+		bench->repeat,
+		bench->profile ? "true" : "false"
+	);
+
+	for (size_t r = 0; r < numRuns; ++r) {
+		const BenchRun *run = &runs[r];
+
+		printf(
+			"\t\t{\"name\": \"%s\", \"mode\": \"%s\", \"result\": \"%s\", \"instructions\": %llu, \"seconds\": %.6f, "
+			"\"instructions_per_second\": %.0f, \"ns_per_instruction\": %.3f, \"cache_misses\": ",
+			run->workload->name,
+			BenchModeName(run),
+			BenchResultName(run->result),
+			(unsigned long long) run->cycles,
+			run->seconds,
+			run->seconds > 0 ? run->cycles / run->seconds : 0.0,
+			run->cycles > 0 ? run->seconds * 1e9 / run->cycles : 0.0
+		);
+
+		if (run->cacheMisses >= 0) {
+			printf("%lld", (long long) run->cacheMisses);
+		} else {
+			printf("null");
+		}
+
+		printf(", \"lane_utilization\": ");
+		if (run->laneUtilization >= 0) {
+			printf("%.4f", run->laneUtilization);
+		} else {
+			printf("null");
+		}
+
+		printf("}%s\n", r + 1 < numRuns ? "," : "");
+	}
+
+	printf("\t]\n}\n");
+}
+
+void BenchPrintDisplayText(const BenchDisplayRun *runs, size_t numRuns) {
+	printf("window\tscale\tus/frame\tpixels/s\n");
+
+	for (size_t r = 0; r < numRuns; ++r) {
+		const BenchDisplayRun *run = &runs[r];
+		uint32_t width = CHIP8_DISPLAY_WIDTH * run->scale;
+		uint32_t height = CHIP8_DISPLAY_HEIGHT * run->scale;
+
+		printf(
+			"%ux%u\t%u\t%.2f\t%.0f\n",
+			width,
+			height,
+			run->scale,
+			run->seconds * 1e6,
+			run->seconds > 0 ? (double) width * height / run->seconds : 0.0
+		);
+	}
+}
+
+void BenchPrintDisplayJSON(const Bench *bench, const char *label, const BenchDisplayRun *runs, size_t numRuns) {
+	printf("{\n\t\"label\": ");
+	if (label != NULL) {
+		BenchPrintJSONString(label);
+	} else {
+		printf("null");
+	}
+
+	printf(",\n\t\"frames\": %d,\n\t\"repeat\": %zu,\n\t\"display\": [\n", BENCH_DISPLAY_FRAMES, bench->repeat);
+
+	for (size_t r = 0; r < numRuns; ++r) {
+		const BenchDisplayRun *run = &runs[r];
+
+		printf(
+			"\t\t{\"width\": %u, \"height\": %u, \"scale\": %u, \"us_per_frame\": %.3f}%s\n",
+			CHIP8_DISPLAY_WIDTH * run->scale,
+			CHIP8_DISPLAY_HEIGHT * run->scale,
+			run->scale,
+			run->seconds * 1e6,
+			r + 1 < numRuns ? "," : ""
+		);
+	}
+
+	printf("\t]\n}\n");
+}
+
+void BenchPrintJSONString(const char *text) {
+	putchar('"');
+
+	for (const char *c = text; *c != '\0'; ++c) {
+		if (*c == '"' || *c == '\\') {
+			printf("\\%c", *c);
+		} else if ((unsigned char) *c < 0x20) {
+			printf("\\u%04x", (unsigned char) *c);
+		} else {
+			putchar(*c);
+		}
+	}
+
+	putchar('"');
+}
+
+// Last level cache misses of this thread in user space, where the hardware and
+// the kernel let us count them; -1 everywhere else.
+int BenchCounterOpen() {
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+void BenchCounterStart(int counter) {
+#ifdef __linux__
+	if (counter >= 0) {
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+int64_t BenchCounterStop(int counter) {
+	int64_t count = -1;
+
+#ifdef __linux__
+	if (counter >= 0) {
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+
+		uint64_t value;
+		if (read(counter, &value, sizeof(value)) == sizeof(value)) {
+			count = (int64_t) value;
+		}
+
+		close(counter);
+	}
+#endif
+
+	return count;
+}
+
+const char *BenchModeName(const BenchRun *run) {
+	if (run->lanes) {
+		return "lanes";
+	}
+
+	return run->mode == CHIP8_MODE_JIT ? "jit" : "interpreter";
+}
+
+const char *BenchResultName(CHIP8Result result) {
+	switch (result) {
+		case CHIP8_SUCCESS:
+			return "ok";
+		case CHIP8_ERROR_INIT_FAILED:
+			return "init-failed";
+		case CHIP8_ERROR_SEGFAULT:
+			return "segfault";
+		case CHIP8_ERROR_STACK_UNDERFLOW:
+			return "stack-underflow";
+		case CHIP8_ERROR_STACK_OVERFLOW:
+			return "stack-overflow";
+		case CHIP8_ERROR_INSTRUCTION_NOT_FOUND:
+			return "instruction-not-found";
+		case CHIP8_ERROR_JIT_UNAVAILABLE:
+			return "jit-unavailable";
+		case CHIP8_ERROR_OUT_OF_MEMORY:
+			return "out-of-memory";
+		case CHIP8_ERROR_PROFILE_UNAVAILABLE:
+			return "profile-unavailable";
+		default:
+			return "error";
+	}
+}
+
+double BenchNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
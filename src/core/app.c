@@ -1,30 +1,38 @@
 #include <core/app.h>
+#include <core/chip8_thread.h>
 #include <stdio.h>
 
-#define SDL_APP_WINDOW_NAME "CHIP-8 Emulator"
-#define APP_AUDIO_FILE_NAME "media/audio.wav"
-
-#define DISPLAY_SPRITE_COLOUR 0xFFCCCCCC
-#define DISPLAY_BACKGROUND_COLOUR 0xCCAAAAAA
-
-#define APP_SHOW_TIME 14
-#define APP_EXECUTE_TIME 1
-#define APP_UPDATE_TIME_REGISTER_TIME 14
-
-typedef struct {
-	App *app;
-	CHIP8 *chip8;
-} AppCallbackParameter;
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
 
-static int AppShowFrame(App *app, CHIP8 *chip8);
-static void AppOnKeyDown(App *app, CHIP8 *chip8, SDL_KeyboardEvent *event);
-static void AppOnKeyUp(App *app, CHIP8 *chip8, SDL_KeyboardEvent *event);
-
-static uint32_t AppShowFrameCallback(uint32_t interval, void *parameter);
-static uint32_t AppExecuteCallback(uint32_t interval, void *parameter);
-static uint32_t AppUpdateTimeRegisterCallback(uint32_t interval, void *parameter);
-
-App *AppInit(int windowWidth, int windowHeight) {
+#define SDL_APP_WINDOW_NAME "CHIP-8 Emulator"
+#define APP_AUDIO_SAMPLE_RATE 48000
+// About 5 ms a buffer at 48 kHz.
+#define APP_AUDIO_BUFFER_SAMPLES 256
+
+#define APP_METRICS_INTERVAL 1.0
+#define APP_TITLE_SIZE 128
+
+static int AppShowFrame(App *app, const CHIP8Frame *frame);
+static void AppOpenAudio(App *app, uint32_t toneFrequency);
+static void AppShowAudioMetrics(App *app);
+static void AppAudioCallback(void *userdata, Uint8 *stream, int len);
+static void AppToggleFullscreen(App *app);
+static void AppShowMetrics(App *app, const CHIP8SchedulerMetrics *metrics, double cpuUsage);
+static void AppFinishMovie(CHIP8MovieRecorder *recorder, const CHIP8 *chip8, const CHIP8Frame *frame);
+static void AppDumpTrace(const CHIP8Trace *trace, const char *traceFileName);
+static void AppOnFrameReady(void *context);
+static bool AppOnEvent(App *app, CHIP8Thread *thread, SDL_Event *event);
+static void AppOnKeyDown(App *app, CHIP8Thread *thread, SDL_KeyboardEvent *event);
+static void AppOnKeyUp(App *app, CHIP8Thread *thread, SDL_KeyboardEvent *event);
+
+static double AppNow();
+static double AppCPUTime();
+
+App *AppInit(int windowWidth, int windowHeight, bool fullscreen, const CHIP8Palette *palette, uint32_t toneFrequency) {
     App *app = (App *) malloc(sizeof(App));
 
     if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
@@ -41,7 +49,7 @@ App *AppInit(int windowWidth, int windowHeight) {
 		SDL_WINDOWPOS_UNDEFINED,
         windowWidth,
 		windowHeight,
-        0
+        SDL_WINDOW_RESIZABLE | (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0)
     );
 
     if (app->window == NULL) {
@@ -53,41 +61,102 @@ App *AppInit(int windowWidth, int windowHeight) {
         return NULL;
     }
 
-	// SDL_RenderSetLogicalSize(app->renderer, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+	// The texture stays at the display's resolution and the renderer scales it, with sharp pixels,
+	// to whatever the window is, leaving bars where the aspect ratio differs. A frame costs the
+	// same in any window.
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
 
-    if (SDL_RenderSetScale(app->renderer, windowWidth/64, windowHeight/32) < 0) {
-        return NULL;
-    }
+	if (SDL_RenderSetLogicalSize(app->renderer, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT) < 0) {
+		return NULL;
+	}
+
+	app->palette = *palette;
 
 	app->texture = SDL_CreateTexture(
         app->renderer,
         SDL_PIXELFORMAT_ARGB8888, 
 		SDL_TEXTUREACCESS_STREAMING,
-        CHIP8_DISPLAY_WIDTH,
-		CHIP8_DISPLAY_HEIGHT
+        CHIP8_HIRES_WIDTH,
+		CHIP8_HIRES_HEIGHT
     );
 
 	if (app->texture == NULL) {
 		return NULL;
 	}
 
-	SDL_AudioSpec wavSpec;
+	app->textureSequence = 0;
+	app->hires = false;
+	app->redraw = true;
+	app->framesPresented = 0;
+	app->framesSkipped = 0;
 
-	if (SDL_LoadWAV(APP_AUDIO_FILE_NAME, &wavSpec, &app->wavBuffer, &app->wavLenght) == NULL) {
+	app->frameEventType = SDL_RegisterEvents(1);
+	if (app->frameEventType == (uint32_t) -1) {
 		return NULL;
 	}
 
-	app->audioDeviceID = SDL_OpenAudioDevice(NULL, 0, &wavSpec, NULL, 0);
+	AppOpenAudio(app, toneFrequency);
+
+    return app;
+}
+
+// The tone is generated in the device's callback, so nothing is queued ahead of it but the
+// device's own buffer. Without a device the emulator just runs silent.
+void AppOpenAudio(App *app, uint32_t toneFrequency) {
+	app->audioDeviceID = 0;
+	app->audio = NULL;
+
+	if (toneFrequency == 0) {
+		return;
+	}
+
+	SDL_AudioSpec desired;
+	SDL_zero(desired);
+	desired.freq = APP_AUDIO_SAMPLE_RATE;
+	desired.format = AUDIO_S16SYS;
+	desired.channels = 1;
+	desired.samples = APP_AUDIO_BUFFER_SAMPLES;
+	desired.callback = AppAudioCallback;
+	// Devices start paused, so the callback cannot run before app->audio is set.
+	desired.userdata = app;
+
+	app->audioDeviceID = SDL_OpenAudioDevice(NULL, 0, &desired, &app->audioSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
 	if (app->audioDeviceID == 0) {
-		return NULL;
+		fprintf(stderr, "Warning: No sound: %s.\n", SDL_GetError());
+		return;
 	}
 
-    return app;
+	app->audio = CHIP8AudioInit((uint32_t) app->audioSpec.freq, toneFrequency, CHIP8_AUDIO_DEFAULT_VOLUME);
+	if (app->audio == NULL) {
+		fprintf(stderr, "Warning: No sound: cannot play %u Hz at %d Hz.\n", toneFrequency, app->audioSpec.freq);
+		SDL_CloseAudioDevice(app->audioDeviceID);
+		app->audioDeviceID = 0;
+		return;
+	}
+}
+
+// Called on SDL's audio thread.
+void AppAudioCallback(void *userdata, Uint8 *stream, int len) {
+	App *app = (App *) userdata;
+
+	CHIP8AudioRender(app->audio, (int16_t *) stream, (size_t) len / sizeof(int16_t));
+}
+
+void AppDumpTrace(const CHIP8Trace *trace, const char *traceFileName) {
+	if (trace == NULL) {
+		return;
+	}
+
+	if (!CHIP8TraceDump(trace, traceFileName)) {
+		fprintf(stderr, "Error: Cannot write the trace.\n");
+	}
 }
 
 void AppDestroy(App *app) {
-	SDL_CloseAudioDevice(app->audioDeviceID);
-	SDL_FreeWAV(app->wavBuffer);
+	if (app->audioDeviceID != 0) {
+		SDL_CloseAudioDevice(app->audioDeviceID);
+	}
+	CHIP8AudioDestroy(app->audio);
 
 	SDL_DestroyTexture(app->texture);
 	SDL_DestroyRenderer(app->renderer);
@@ -97,221 +166,401 @@ void AppDestroy(App *app) {
     free(app);
 }
 
-void AppLoop(App *app, CHIP8 *chip8) {
-	bool quit = false;
+void AppLoop(App *app, CHIP8 *chip8, uint32_t instructionsPerFrame, CHIP8Rewind *rewind, CHIP8MovieRecorder *recorder, CHIP8Trace *trace, const char *traceFileName) {
+	CHIP8SetTrace(chip8, trace);
+
+	// From here until CHIP8ThreadStop, chip8, rewind and recorder belong to the emulation thread.
+	CHIP8Thread *thread = CHIP8ThreadStart(chip8, instructionsPerFrame, rewind, recorder, app->audio, AppOnFrameReady, app);
+	if (thread == NULL) {
+		fprintf(stderr, "Error: Cannot start the emulation thread.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (app->audioDeviceID != 0) {
+		SDL_PauseAudioDevice(app->audioDeviceID, 0);
+	}
 
-	AppCallbackParameter callbackParameter = { app, chip8 };
+	double startTime = AppNow();
+	double startCPUTime = AppCPUTime();
+	double metricsTime = startTime;
+	double metricsCPUTime = startCPUTime;
 
-	SDL_TimerID showFrameTimer = SDL_AddTimer(APP_SHOW_TIME, AppShowFrameCallback, (void *) &callbackParameter);
-	SDL_TimerID executeTimer = SDL_AddTimer(APP_EXECUTE_TIME, AppExecuteCallback, (void *) chip8);
-	SDL_TimerID updateTimeRegisterTimer = SDL_AddTimer(APP_UPDATE_TIME_REGISTER_TIME, AppUpdateTimeRegisterCallback, (void *) &callbackParameter);
+	const CHIP8Frame *frame;
+	bool quit = false;
 
+	// Frames arrive as events too, so this sleeps whenever there is nothing to do.
 	while (!quit) {
 		SDL_Event event;
+		if (!SDL_WaitEvent(&event)) {
+			break;
+		}
+
+		if (event.type != app->frameEventType) {
+			quit = !AppOnEvent(app, thread, &event);
+			continue;
+		}
+
+		if (!CHIP8ThreadReadFrame(thread, &frame)) {
+			continue;
+		}
+
+		if (frame->result != CHIP8_SUCCESS) {
+			// chip8 carries the error, and is only ours again once the thread has stopped.
+			CHIP8ThreadStop(thread);
+			fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
+
+			// A movie that ends in the error is exactly what a bug report needs.
+			AppFinishMovie(recorder, chip8, frame);
+			AppDumpTrace(trace, traceFileName);
+			exit(EXIT_FAILURE);
+		}
 
-		while (SDL_PollEvent(&event)) {
-			switch(event.type) {
-				case SDL_QUIT:
-					quit = true;
-					break;
-				case SDL_KEYDOWN:
-					AppOnKeyDown(app, chip8, &event.key);
-					break;
-				case SDL_KEYUP:
-					AppOnKeyUp(app, chip8, &event.key);
-					break;
-				default:
-					break;
-			}
+		if (AppShowFrame(app, frame) < 0) {
+			exit(EXIT_FAILURE);
 		}
+
+		double now = AppNow();
+		if (now >= metricsTime + APP_METRICS_INTERVAL) {
+			double cpuTime = AppCPUTime();
+
+			AppShowMetrics(app, &frame->metrics, (cpuTime - metricsCPUTime) / (now - metricsTime));
+			metricsTime = now;
+			metricsCPUTime = cpuTime;
+		}
+	}
+
+	CHIP8ThreadStop(thread);
+	CHIP8ThreadReadFrame(thread, &frame);
+	AppFinishMovie(recorder, chip8, frame);
+	AppDumpTrace(trace, traceFileName);
+
+	double now = AppNow();
+
+	printf(
+		"Configured %.0f IPS, achieved %.0f IPS; %llu frames, %llu skipped; %llu presented, %llu unchanged; %.1f%% host CPU.\n",
+		frame->metrics.configuredIPS,
+		frame->metrics.achievedIPS,
+		(unsigned long long) frame->metrics.frames,
+		(unsigned long long) frame->metrics.skippedFrames,
+		(unsigned long long) app->framesPresented,
+		(unsigned long long) app->framesSkipped,
+		now > startTime ? 100.0 * (AppCPUTime() - startCPUTime) / (now - startTime) : 0.0
+	);
+
+	if (rewind != NULL) {
+		printf("Rewind holds %zu frames in %zu bytes.\n", CHIP8RewindFrames(rewind), CHIP8RewindBytes(rewind));
+	}
+
+	AppShowAudioMetrics(app);
+
+	CHIP8ThreadDestroy(thread);
+}
+
+void AppFinishMovie(CHIP8MovieRecorder *recorder, const CHIP8 *chip8, const CHIP8Frame *frame) {
+	if (recorder == NULL) {
+		return;
+	}
+
+	// A failed frame is not counted as run, but the replay has to run it to fail the same way.
+	uint64_t frames = frame->metrics.frames + (frame->result != CHIP8_SUCCESS);
+
+	if (!CHIP8MovieRecorderFinish(recorder, chip8, frames)) {
+		fprintf(stderr, "Error: Cannot write the movie.\n");
+	}
+}
+
+// Called on the emulation thread; SDL_PushEvent is safe from any thread.
+void AppOnFrameReady(void *context) {
+	App *app = (App *) context;
+
+	SDL_Event event;
+	SDL_zero(event);
+	event.type = app->frameEventType;
+
+	SDL_PushEvent(&event);
+}
+
+// Returns false when the application should quit.
+bool AppOnEvent(App *app, CHIP8Thread *thread, SDL_Event *event) {
+	switch(event->type) {
+		case SDL_QUIT:
+			return false;
+		case SDL_KEYDOWN:
+			AppOnKeyDown(app, thread, &event->key);
+			break;
+		case SDL_KEYUP:
+			AppOnKeyUp(app, thread, &event->key);
+			break;
+		case SDL_WINDOWEVENT:
+			// The window contents may have been lost; present the next frame even if it is unchanged.
+			app->redraw = true;
+			break;
+		default:
+			break;
 	}
 
-	SDL_RemoveTimer(showFrameTimer);
-	SDL_RemoveTimer(executeTimer);
-	SDL_RemoveTimer(updateTimeRegisterTimer);
+	return true;
 }
 
-int AppShowFrame(App *app, CHIP8 *chip8) {
-    uint32_t buffer[CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT];
+int AppShowFrame(App *app, const CHIP8Frame *frame) {
+    // Without the previous frame's dirty rows, every row has to be assumed dirty.
+    uint64_t dirtyRows = frame->sequence == app->textureSequence + 1 ? frame->dirtyRows : UINT64_MAX;
+    app->textureSequence = frame->sequence;
 
-    for (uint32_t i = 0; i < CHIP8_DISPLAY_WIDTH; ++i) {
-        for (uint32_t j = 0; j < CHIP8_DISPLAY_HEIGHT; ++j) {
-            buffer[j * CHIP8_DISPLAY_HEIGHT + i] = ((DISPLAY_SPRITE_COLOUR * chip8->display[i][j]) | DISPLAY_BACKGROUND_COLOUR);
+    if (frame->hires != app->hires) {
+        app->hires = frame->hires;
+        dirtyRows = UINT64_MAX;
+
+        int result = app->hires ?
+            SDL_RenderSetLogicalSize(app->renderer, CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT) :
+            SDL_RenderSetLogicalSize(app->renderer, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+        if (result < 0) {
+            return result;
         }
     }
 
-    int result = SDL_UpdateTexture(app->texture, NULL, buffer, CHIP8_DISPLAY_WIDTH * 4);
-    if (result < 0) {
-        return result;
+    // Only the top-left corner of the texture is in use in lores.
+    SDL_Rect displayRectangle = {0, 0, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT};
+    if (app->hires) {
+        displayRectangle.w = CHIP8_HIRES_WIDTH;
+        displayRectangle.h = CHIP8_HIRES_HEIGHT;
+    } else {
+        dirtyRows &= UINT32_MAX;
+    }
+
+    if (dirtyRows == 0 && !app->redraw) {
+        ++app->framesSkipped;
+        return 0;
+    }
+
+    if (dirtyRows != 0) {
+        // Expand straight into the texture, covering the rows from the first dirty one to the last.
+        int firstRow = __builtin_ctzll(dirtyRows);
+        int lastRow = 63 - __builtin_clzll(dirtyRows);
+        SDL_Rect dirtyRectangle = {0, firstRow, displayRectangle.w, lastRow - firstRow + 1};
+
+        void *pixels;
+        int pitch;
+        int result = SDL_LockTexture(app->texture, &dirtyRectangle, &pixels, &pitch);
+        if (result < 0) {
+            return result;
+        }
+
+        CHIP8ExpandDisplay(&frame->display[0][0][0], displayRectangle.w, firstRow, lastRow - firstRow + 1, &app->palette, 1, pixels, pitch);
+
+        SDL_UnlockTexture(app->texture);
     }
 
-    result = SDL_RenderClear(app->renderer);
+    int result = SDL_RenderClear(app->renderer);
     if (result < 0) {
         return result;
     }
 
-    SDL_Rect destinationRectangle = {0, 0, CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT};
-
-    result = SDL_RenderCopy(app->renderer, app->texture, NULL, &destinationRectangle);
+    // Onto the whole logical size, which the renderer fits into the window.
+    result = SDL_RenderCopy(app->renderer, app->texture, &displayRectangle, NULL);
     if (result < 0) {
         return result;
     }
 
     SDL_RenderPresent(app->renderer);
 
+    app->redraw = false;
+    ++app->framesPresented;
+
     return 0;
 }
 
-void AppOnKeyDown(App *app, CHIP8 *chip8, SDL_KeyboardEvent *event) {
+void AppToggleFullscreen(App *app) {
+	bool fullscreen = (SDL_GetWindowFlags(app->window) & SDL_WINDOW_FULLSCREEN_DESKTOP) != 0;
+
+	if (SDL_SetWindowFullscreen(app->window, fullscreen ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP) < 0) {
+		fprintf(stderr, "Error: %s.\n", SDL_GetError());
+	}
+
+	app->redraw = true;
+}
+
+void AppOnKeyDown(App *app, CHIP8Thread *thread, SDL_KeyboardEvent *event) {
     if (event->repeat == 0) {
+        if (event->keysym.scancode == SDL_SCANCODE_BACKSPACE) {
+            CHIP8ThreadSetRewinding(thread, true);
+        }
+        if (event->keysym.scancode == SDL_SCANCODE_F11) {
+            AppToggleFullscreen(app);
+        }
         if (event->keysym.scancode == SDL_SCANCODE_0) {
-            chip8->keyboard[0x0] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x0, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_1) {
-            chip8->keyboard[0x1] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x1, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_2) {
-            chip8->keyboard[0x2] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x2, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_3) {
-            chip8->keyboard[0x3] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x3, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_4) {
-            chip8->keyboard[0x4] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x4, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_5) {
-            chip8->keyboard[0x5] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x5, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_6) {
-            chip8->keyboard[0x6] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x6, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_7) {
-            chip8->keyboard[0x7] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x7, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_8) {
-            chip8->keyboard[0x8] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x8, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_9) {
-            chip8->keyboard[0x9] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x9, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_A) {
-            chip8->keyboard[0xA] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xA, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_B) {
-            chip8->keyboard[0xB] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xB, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_C) {
-            chip8->keyboard[0xC] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xC, CHIP8_KEY_PRESSED);
         }
         if (event->keysym.scancode == SDL_SCANCODE_D) {
-            chip8->keyboard[0xD] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xD, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_E) {
-            chip8->keyboard[0xE] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xE, CHIP8_KEY_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_F) {
-            chip8->keyboard[0xF] = CHIP8_KEY_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xF, CHIP8_KEY_PRESSED);
         }
     }
 }
 
-void AppOnKeyUp(App *app, CHIP8 *chip8, SDL_KeyboardEvent *event) {
+void AppOnKeyUp(App *app, CHIP8Thread *thread, SDL_KeyboardEvent *event) {
     if (event->repeat == 0) {
+        if (event->keysym.scancode == SDL_SCANCODE_BACKSPACE) {
+            CHIP8ThreadSetRewinding(thread, false);
+        }
         if (event->keysym.scancode == SDL_SCANCODE_0) {
-            chip8->keyboard[0x0] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x0, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_1) {
-            chip8->keyboard[0x1] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x1, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_2) {
-            chip8->keyboard[0x2] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x2, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_3) {
-            chip8->keyboard[0x3] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x3, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_4) {
-            chip8->keyboard[0x4] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x4, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_5) {
-            chip8->keyboard[0x5] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x5, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_6) {
-            chip8->keyboard[0x6] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x6, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_7) {
-            chip8->keyboard[0x7] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x7, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_8) {
-            chip8->keyboard[0x8] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x8, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_9) {
-            chip8->keyboard[0x9] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0x9, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_A) {
-            chip8->keyboard[0xA] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xA, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_B) {
-            chip8->keyboard[0xB] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xB, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_C) {
-            chip8->keyboard[0xC] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xC, CHIP8_KEY_NOT_PRESSED);
         }
         if (event->keysym.scancode == SDL_SCANCODE_D) {
-            chip8->keyboard[0xD] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xD, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_E) {
-            chip8->keyboard[0xE] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xE, CHIP8_KEY_NOT_PRESSED);
         } 
         if (event->keysym.scancode == SDL_SCANCODE_F) {
-            chip8->keyboard[0xF] = CHIP8_KEY_NOT_PRESSED;
+            CHIP8ThreadPushKey(thread, 0xF, CHIP8_KEY_NOT_PRESSED);
         }
     }
 }
 
-uint32_t AppShowFrameCallback(uint32_t interval, void *parameter) {
-	AppCallbackParameter *callbackParameter = (AppCallbackParameter *) parameter;
-
-	App *app = callbackParameter->app;
-	CHIP8 *chip8 = callbackParameter->chip8;
-
-	if (AppShowFrame(app, chip8) < 0)  {
-		exit(EXIT_FAILURE);
+// Latency is from the emulation thread finishing a frame to the callback rendering its first
+// sample, plus the device buffer that sample still has to wait behind.
+void AppShowAudioMetrics(App *app) {
+	if (app->audio == NULL) {
+		return;
 	}
 
-	return interval;
-}
+	// Once paused the callback no longer runs, so the metrics are ours to read.
+	SDL_PauseAudioDevice(app->audioDeviceID, 1);
 
-uint32_t AppExecuteCallback(uint32_t interval, void *parameter) {
-	CHIP8 *chip8 = (CHIP8 *) parameter;
+	CHIP8AudioMetrics metrics;
+	CHIP8AudioGetMetrics(app->audio, &metrics);
 
-	if (CHIP8Execute(chip8) != CHIP8_SUCCESS) {
-		fprintf(stderr, "Error: %s.\n", CHIP8GetError());
-		exit(EXIT_FAILURE);
-	}
+	double bufferLatency = (double) app->audioSpec.samples / app->audioSpec.freq;
 
-	return interval;
+	printf(
+		"Audio at %d Hz: %llu frames, %llu skipped, %llu samples held; latency %.1f ms average, %.1f ms max.\n",
+		app->audioSpec.freq,
+		(unsigned long long) metrics.frames,
+		(unsigned long long) metrics.skippedFrames,
+		(unsigned long long) metrics.underruns,
+		1000 * (metrics.averageLatency + bufferLatency),
+		1000 * (metrics.maxLatency + bufferLatency)
+	);
 }
 
-uint32_t AppUpdateTimeRegisterCallback(uint32_t interval, void *parameter) {
-	AppCallbackParameter *callbackParameter = (AppCallbackParameter *) parameter;
+void AppShowMetrics(App *app, const CHIP8SchedulerMetrics *metrics, double cpuUsage) {
+	char title[APP_TITLE_SIZE];
+	snprintf(
+		title,
+		sizeof(title),
+		"%s - %.0f/%.0f IPS, %llu frames skipped, %llu/%llu presented, %.1f%% CPU",
+		SDL_APP_WINDOW_NAME,
+		metrics->achievedIPS,
+		metrics->configuredIPS,
+		(unsigned long long) metrics->skippedFrames,
+		(unsigned long long) app->framesPresented,
+		(unsigned long long) (app->framesPresented + app->framesSkipped),
+		100.0 * cpuUsage
+	);
+
+	SDL_SetWindowTitle(app->window, title);
+}
 
-	App *app = callbackParameter->app;
-	CHIP8 *chip8 = callbackParameter->chip8;
+double AppNow() {
+	return (double) SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
 
-	if (chip8->dt > 0) {
-		--chip8->dt;
+// User plus system time consumed by this process, in seconds.
+double AppCPUTime() {
+	#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		return 0.0;
 	}
 
-	if (chip8->st > 0) {
-		if (SDL_QueueAudio(app->audioDeviceID, app->wavBuffer,app->wavLenght) < 0) {
-			return 0;
-		}
-		SDL_PauseAudioDevice(app->audioDeviceID, 0);
+	ULARGE_INTEGER kernel = { .LowPart = kernelTime.dwLowDateTime, .HighPart = kernelTime.dwHighDateTime };
+	ULARGE_INTEGER user = { .LowPart = userTime.dwLowDateTime, .HighPart = userTime.dwHighDateTime };
 
-		--chip8->st;
-	} else {
-		SDL_PauseAudioDevice(app->audioDeviceID, 1);
+	return (kernel.QuadPart + user.QuadPart) / 1e7;
+	#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) < 0) {
+		return 0.0;
 	}
 
-	return interval;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	#endif
 }
\ No newline at end of file
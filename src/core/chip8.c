@@ -1,20 +1,104 @@
 #include <core/chip8.h>
-#include <utils/safe_string.h>
+#include <core/chip8_jit.h>
+#include <core/chip8_profile.h>
+#include <core/chip8_trace.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-
-#define CHIP8_ERROR_MESSAGE_SIZE 50
+#include <string.h>
 
 #define CHIP8_INTERPRETER_START_ADDRESS 0
 #define CHIP8_INTERPRETER_END_ADDRESS 0x1ff
 
 #define CHIP8_FONTSET_START_ADDRESS 0x50
+#define CHIP8_BIG_FONTSET_START_ADDRESS (CHIP8_FONTSET_START_ADDRESS + CHIP8_FONTSET_SIZE)
 #define CHIP8_ROM_START_ADDRESS 0x200
 
-static char CHIP8ErrorMessage[CHIP8_ERROR_MESSAGE_SIZE] = "";
-
-static void CHIP8SetError(CHIP8Result result);
+// XO-CHIP's default pitch, 4000 Hz.
+#define CHIP8_DEFAULT_PITCH 64
+
+#define CHIP8_STATE_MAGIC "C8ST"
+// Versions 1 and 2 had the 64x32 display alone and 4 KB of memory; version 1 had no random state either.
+#define CHIP8_STATE_V2_SIZE (8 + 2 * CHIP8_STACK_SIZE + CHIP8_NUM_V_REGISTERS + 7 + CHIP8_NUM_KEYS + 8 + 8 * CHIP8_DISPLAY_HEIGHT + CHIP8_MEMORY_SIZE)
+// What comes before the display in a version 3 state, whatever the variant.
+#define CHIP8_STATE_REGISTERS_SIZE (CHIP8_STATE_SIZE - 8 * CHIP8_NUM_PLANES * CHIP8_HIRES_HEIGHT * CHIP8_ROW_WORDS - CHIP8_XO_MEMORY_SIZE)
+
+struct CHIP8Page {
+	// Machines sharing a page may run, write and be destroyed on different threads.
+	_Atomic uint32_t references;
+	uint8_t data[CHIP8_PAGE_SIZE];
+	// Only instructions that lie entirely inside the page are cached, so a page's
+	// cache never depends on what another machine has in the next one.
+	CHIP8Instruction cache[CHIP8_PAGE_SIZE];
+};
+
+// Fresh machines start out with every page here. It holds a reference of its
+// own, so it is never written to and never freed.
+static CHIP8Page CHIP8ZeroPage = { .references = 1 };
+
+const uint8_t CHIP8Fontset[CHIP8_FONTSET_SIZE] = {
+	0xF0, 0x90, 0x90, 0x90, 0xF0,
+	0x20, 0x60, 0x20, 0x20, 0x70,
+	0xF0, 0x10, 0xF0, 0x80, 0xF0,
+	0xF0, 0x10, 0xF0, 0x10, 0xF0,
+	0x90, 0x90, 0xF0, 0x10, 0x10,
+	0xF0, 0x80, 0xF0, 0x10, 0xF0,
+	0xF0, 0x80, 0xF0, 0x90, 0xF0,
+	0xF0, 0x10, 0x20, 0x40, 0x40,
+	0xF0, 0x90, 0xF0, 0x90, 0xF0,
+	0xF0, 0x90, 0xF0, 0x10, 0xF0,
+	0xF0, 0x90, 0xF0, 0x90, 0x90,
+	0xE0, 0x90, 0xE0, 0x90, 0xE0, 
+	0xF0, 0x80, 0x80, 0x80, 0xF0,
+	0xE0, 0x90, 0x90, 0x90, 0xE0,
+	0xF0, 0x80, 0xF0, 0x80, 0xF0,
+	0xF0, 0x80, 0xF0, 0x80, 0x80
+};
+
+const uint8_t CHIP8BigFontset[CHIP8_BIG_FONTSET_SIZE] = {
+	0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,
+	0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+	0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+	0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+	0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+	0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+	0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0
+};
+
+const char *const CHIP8VariantNames[CHIP8_NUM_VARIANTS] = {
+	[CHIP8_VARIANT_CHIP8] = "chip8",
+	[CHIP8_VARIANT_SCHIP] = "schip",
+	[CHIP8_VARIANT_XOCHIP] = "xochip"
+};
+
+static const char *CHIP8ErrorName(CHIP8Result result);
+static uint8_t *CHIP8StatePut(uint8_t *out, uint64_t value, size_t size);
+static uint64_t CHIP8StateGet(const uint8_t **in, size_t size);
+static size_t CHIP8StateDisplayWords(CHIP8Variant variant);
+static uint64_t CHIP8HashBytes(uint64_t hash, const uint8_t *bytes, size_t size);
+static bool CHIP8PageIsShared(const CHIP8Page *page);
+static CHIP8Page *CHIP8PageForWrite(CHIP8 *chip8, size_t p);
+static void CHIP8PageRelease(CHIP8Page *page);
+static CHIP8Result CHIP8GrowPages(CHIP8 *chip8);
+static CHIP8StopReason CHIP8RunInterpreter(CHIP8 *chip8, uint64_t endCycle, uint32_t stopMask, uint64_t startCycle);
+static bool CHIP8IsKeyWait(const CHIP8 *chip8, uint16_t pc);
+static void CHIP8SkipIdle(CHIP8 *chip8, uint16_t pc, uint64_t endCycle);
+static uint16_t CHIP8ReadOpcode(const CHIP8 *chip8, uint16_t address);
+static CHIP8Result CHIP8SkipNext(CHIP8 *chip8);
+static void CHIP8PlaceSprite(uint32_t sprite, uint32_t width, uint32_t x, uint64_t *row);
+static void CHIP8ScrollVertical(CHIP8 *chip8, int rows);
+static void CHIP8ScrollHorizontal(CHIP8 *chip8, int columns);
+static void CHIP8ClearPlanes(CHIP8 *chip8, uint8_t planes);
+static void CHIP8DrawFramebuffer(CHIP8 *chip8, uint8_t x, uint8_t y, uint8_t n);
 
 // instructions
 static void CHIP8_00e0(CHIP8 *chip8);
@@ -48,17 +132,151 @@ static void CHIP8_fx15(CHIP8 *chip8, uint8_t x);
 static void CHIP8_fx18(CHIP8 *chip8, uint8_t x);
 static CHIP8Result CHIP8_fx1e(CHIP8 *chip8, uint8_t x);
 static CHIP8Result CHIP8_fx29(CHIP8 *chip8, uint8_t x);
-static void CHIP8_fx33(CHIP8 *chip8, uint8_t x);
+static CHIP8Result CHIP8_fx33(CHIP8 *chip8, uint8_t x);
 static CHIP8Result CHIP8_fx55(CHIP8 *chip8, uint8_t x);
 static CHIP8Result CHIP8_fx65(CHIP8 *chip8, uint8_t x);
-
-CHIP8 *CHIP8Init() {
+static void CHIP8_00cn(CHIP8 *chip8, uint8_t n);
+static void CHIP8_00fb(CHIP8 *chip8);
+static void CHIP8_00fc(CHIP8 *chip8);
+static void CHIP8_00fd(CHIP8 *chip8);
+static void CHIP8_00fe(CHIP8 *chip8);
+static void CHIP8_00ff(CHIP8 *chip8);
+static CHIP8Result CHIP8_fx30(CHIP8 *chip8, uint8_t x);
+static void CHIP8_fx75(CHIP8 *chip8, uint8_t x);
+static void CHIP8_fx85(CHIP8 *chip8, uint8_t x);
+static void CHIP8_00dn(CHIP8 *chip8, uint8_t n);
+static CHIP8Result CHIP8_5xy2(CHIP8 *chip8, uint8_t x, uint8_t y);
+static CHIP8Result CHIP8_5xy3(CHIP8 *chip8, uint8_t x, uint8_t y);
+static CHIP8Result CHIP8_f000(CHIP8 *chip8);
+static void CHIP8_fn01(CHIP8 *chip8, uint8_t n);
+static CHIP8Result CHIP8_f002(CHIP8 *chip8);
+static void CHIP8_fx3a(CHIP8 *chip8, uint8_t x);
+
+// handlers with the uniform CHIP8Handler signature, bound by CHIP8Decode
+static CHIP8Result CHIP8Handle_invalid(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00e0(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00ee(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_1nnn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_2nnn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_3xkk(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_4xkk(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_5xy0(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_6xkk(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_7xkk(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy0(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy1(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy2(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy3(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy4(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy5(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy6(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xy7(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_8xye(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_9xy0(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_annn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_bnnn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_cxkk(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_dxyn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_ex9e(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_exa1(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx07(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx0a(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx15(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx18(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx1e(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx29(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx33(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx55(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx65(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00cn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00fb(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00fc(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00fd(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00fe(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00ff(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx30(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx75(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx85(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_00dn(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_5xy2(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_5xy3(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_f000(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fn01(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_f002(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static CHIP8Result CHIP8Handle_fx3a(CHIP8 *chip8, const CHIP8Instruction *instruction);
+
+// Indexed by CHIP8Op.
+static const CHIP8Handler CHIP8Handlers[CHIP8_NUM_OPS] = {
+	[CHIP8_OP_INVALID] = CHIP8Handle_invalid,
+	[CHIP8_OP_00E0] = CHIP8Handle_00e0,
+	[CHIP8_OP_00EE] = CHIP8Handle_00ee,
+	[CHIP8_OP_1NNN] = CHIP8Handle_1nnn,
+	[CHIP8_OP_2NNN] = CHIP8Handle_2nnn,
+	[CHIP8_OP_3XKK] = CHIP8Handle_3xkk,
+	[CHIP8_OP_4XKK] = CHIP8Handle_4xkk,
+	[CHIP8_OP_5XY0] = CHIP8Handle_5xy0,
+	[CHIP8_OP_6XKK] = CHIP8Handle_6xkk,
+	[CHIP8_OP_7XKK] = CHIP8Handle_7xkk,
+	[CHIP8_OP_8XY0] = CHIP8Handle_8xy0,
+	[CHIP8_OP_8XY1] = CHIP8Handle_8xy1,
+	[CHIP8_OP_8XY2] = CHIP8Handle_8xy2,
+	[CHIP8_OP_8XY3] = CHIP8Handle_8xy3,
+	[CHIP8_OP_8XY4] = CHIP8Handle_8xy4,
+	[CHIP8_OP_8XY5] = CHIP8Handle_8xy5,
+	[CHIP8_OP_8XY6] = CHIP8Handle_8xy6,
+	[CHIP8_OP_8XY7] = CHIP8Handle_8xy7,
+	[CHIP8_OP_8XYE] = CHIP8Handle_8xye,
+	[CHIP8_OP_9XY0] = CHIP8Handle_9xy0,
+	[CHIP8_OP_ANNN] = CHIP8Handle_annn,
+	[CHIP8_OP_BNNN] = CHIP8Handle_bnnn,
+	[CHIP8_OP_CXKK] = CHIP8Handle_cxkk,
+	[CHIP8_OP_DXYN] = CHIP8Handle_dxyn,
+	[CHIP8_OP_EX9E] = CHIP8Handle_ex9e,
+	[CHIP8_OP_EXA1] = CHIP8Handle_exa1,
+	[CHIP8_OP_FX07] = CHIP8Handle_fx07,
+	[CHIP8_OP_FX0A] = CHIP8Handle_fx0a,
+	[CHIP8_OP_FX15] = CHIP8Handle_fx15,
+	[CHIP8_OP_FX18] = CHIP8Handle_fx18,
+	[CHIP8_OP_FX1E] = CHIP8Handle_fx1e,
+	[CHIP8_OP_FX29] = CHIP8Handle_fx29,
+	[CHIP8_OP_FX33] = CHIP8Handle_fx33,
+	[CHIP8_OP_FX55] = CHIP8Handle_fx55,
+	[CHIP8_OP_FX65] = CHIP8Handle_fx65,
+	[CHIP8_OP_00CN] = CHIP8Handle_00cn,
+	[CHIP8_OP_00FB] = CHIP8Handle_00fb,
+	[CHIP8_OP_00FC] = CHIP8Handle_00fc,
+	[CHIP8_OP_00FD] = CHIP8Handle_00fd,
+	[CHIP8_OP_00FE] = CHIP8Handle_00fe,
+	[CHIP8_OP_00FF] = CHIP8Handle_00ff,
+	[CHIP8_OP_FX30] = CHIP8Handle_fx30,
+	[CHIP8_OP_FX75] = CHIP8Handle_fx75,
+	[CHIP8_OP_FX85] = CHIP8Handle_fx85,
+	[CHIP8_OP_00DN] = CHIP8Handle_00dn,
+	[CHIP8_OP_5XY2] = CHIP8Handle_5xy2,
+	[CHIP8_OP_5XY3] = CHIP8Handle_5xy3,
+	[CHIP8_OP_F000] = CHIP8Handle_f000,
+	[CHIP8_OP_FN01] = CHIP8Handle_fn01,
+	[CHIP8_OP_F002] = CHIP8Handle_f002,
+	[CHIP8_OP_FX3A] = CHIP8Handle_fx3a
+};
+
+CHIP8 *CHIP8Init(uint64_t seed) {
 	CHIP8 *chip8 = (CHIP8 *) malloc(sizeof(CHIP8));
 	if (chip8 == NULL) {
-		CHIP8SetError(CHIP8_ERROR_INIT_FAILED);
 		return NULL;
 	}
 
+	chip8->pages = chip8->basePages;
+	chip8->numPages = CHIP8_NUM_PAGES;
+	for (size_t p = 0; p < CHIP8_NUM_PAGES; ++p) {
+		chip8->pages[p] = &CHIP8ZeroPage;
+	}
+	atomic_fetch_add_explicit(&CHIP8ZeroPage.references, CHIP8_NUM_PAGES, memory_order_relaxed);
+
+	memset(chip8->stack, 0, sizeof(chip8->stack));
+	memset(chip8->v, 0, sizeof(chip8->v));
+	chip8->i = 0;
+
 	chip8->pc = CHIP8_ROM_START_ADDRESS;
 	chip8->sp = 0;
 	chip8->dt = 0;
@@ -68,288 +286,1664 @@ CHIP8 *CHIP8Init() {
 		chip8->keyboard[i] = CHIP8_KEY_NOT_PRESSED;
 	}
 
-	for (size_t i = 0; i < 64; ++i) {
-		for (size_t j = 0; j < 32; ++j) {
-			chip8->display[i][j] = CHIP8_PIXEL_OFF;
-		}
+	CHIP8Seed(chip8, seed);
+
+	chip8->variant = CHIP8_VARIANT_CHIP8;
+	chip8->memorySize = CHIP8_MEMORY_SIZE;
+	chip8->hires = false;
+	chip8->planes = 0x1;
+	memset(chip8->flags, 0, sizeof(chip8->flags));
+	memset(chip8->pattern, 0, sizeof(chip8->pattern));
+	chip8->pitch = CHIP8_DEFAULT_PITCH;
+
+	memset(chip8->display, 0, sizeof(chip8->display));
+	chip8->framebuffer = NULL;
+	chip8->dirtyRows = UINT64_MAX;
+
+	chip8->cycles = 0;
+	chip8->idleCycles = 0;
+	chip8->frameCycles = 0;
+	chip8->frameEnd = 0;
+	chip8->breakpoints = NULL;
+	chip8->breakpointsSize = 0;
+
+	chip8->jit = NULL;
+	chip8->trace = NULL;
+	chip8->profile = NULL;
+
+	chip8->error.code = CHIP8_SUCCESS;
+	chip8->error.fault = false;
+	chip8->errorMessage[0] = '\0';
+
+	return chip8;
+}
+
+void CHIP8Destroy(CHIP8 *chip8) {
+	if (chip8->jit != NULL) {
+		CHIP8JitDestroy(chip8->jit);
+	}
+
+	for (size_t p = 0; p < chip8->numPages; ++p) {
+		CHIP8PageRelease(chip8->pages[p]);
+	}
+
+	if (chip8->pages != chip8->basePages) {
+		free(chip8->pages);
+	}
+
+	free(chip8->framebuffer);
+	free(chip8->breakpoints);
+	free(chip8);
+}
+
+CHIP8Result CHIP8LoadFontset(CHIP8 *chip8, const uint8_t *fontset, size_t fontsetSize) {
+	if (fontsetSize != CHIP8_FONTSET_SIZE) {
+		CHIP8SetError(chip8, CHIP8_ERROR_INVALID_FONTSET);
+		return CHIP8_ERROR_INVALID_FONTSET;
+	}
+
+	return CHIP8WriteMemory(chip8, CHIP8_FONTSET_START_ADDRESS, fontset, CHIP8_FONTSET_SIZE);
+}
+
+CHIP8Result CHIP8SetVariant(CHIP8 *chip8, CHIP8Variant variant) {
+	if (variant == CHIP8_VARIANT_XOCHIP && chip8->jit != NULL) {
+		CHIP8SetError(chip8, CHIP8_ERROR_JIT_UNAVAILABLE);
+		return CHIP8_ERROR_JIT_UNAVAILABLE;
+	}
+
+	if (variant == CHIP8_VARIANT_XOCHIP && chip8->profile != NULL) {
+		CHIP8SetError(chip8, CHIP8_ERROR_PROFILE_UNAVAILABLE);
+		return CHIP8_ERROR_PROFILE_UNAVAILABLE;
+	}
+
+	// Allocate everything first, so that running out of memory leaves chip8 as it was.
+	CHIP8Result result = CHIP8PrepareVariant(chip8, variant);
+	if (result == CHIP8_SUCCESS && variant != CHIP8_VARIANT_CHIP8) {
+		result = CHIP8PrepareWrite(chip8, CHIP8_BIG_FONTSET_START_ADDRESS, CHIP8BigFontset, CHIP8_BIG_FONTSET_SIZE);
+	}
+	if (result != CHIP8_SUCCESS) {
+		return result;
+	}
+
+	if (variant != chip8->variant) {
+		memset(chip8->display, 0, sizeof(chip8->display));
+		if (chip8->framebuffer != NULL) {
+			memset(chip8->framebuffer, 0, CHIP8_NUM_PLANES * sizeof(chip8->framebuffer[0]));
+		}
+
+		chip8->hires = false;
+		chip8->planes = 0x1;
+		chip8->dirtyRows = UINT64_MAX;
+	}
+
+	chip8->variant = variant;
+	chip8->memorySize = variant == CHIP8_VARIANT_XOCHIP ? CHIP8_XO_MEMORY_SIZE : CHIP8_MEMORY_SIZE;
+
+	if (variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_SUCCESS;
+	}
+
+	// Machines sharing memory all load the same font, which leaves their pages shared.
+	CHIP8WriteMemory(chip8, CHIP8_BIG_FONTSET_START_ADDRESS, CHIP8BigFontset, CHIP8_BIG_FONTSET_SIZE);
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8PrepareVariant(CHIP8 *chip8, CHIP8Variant variant) {
+	// Both are kept once allocated, even if the machine goes back to a smaller variant.
+	if (variant == CHIP8_VARIANT_XOCHIP && chip8->numPages < CHIP8_XO_NUM_PAGES) {
+		CHIP8Result result = CHIP8GrowPages(chip8);
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+	}
+
+	if (variant != CHIP8_VARIANT_CHIP8 && chip8->framebuffer == NULL) {
+		chip8->framebuffer = (uint64_t (*)[CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]) calloc(CHIP8_NUM_PLANES, sizeof(chip8->framebuffer[0]));
+		if (chip8->framebuffer == NULL) {
+			CHIP8SetError(chip8, CHIP8_ERROR_OUT_OF_MEMORY);
+			return CHIP8_ERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8LoadROM(CHIP8 *chip8, const char *fileName) {
+	uint8_t rom[CHIP8_MAX_ROM_SIZE];
+	size_t size;
+
+	CHIP8Result result = CHIP8ReadROM(fileName, rom, &size);
+	if (result != CHIP8_SUCCESS) {
+		CHIP8SetError(chip8, result);
+		return result;
+	}
+
+	return CHIP8LoadROMFromMemory(chip8, rom, size);
+}
+
+CHIP8Result CHIP8LoadROMFromMemory(CHIP8 *chip8, const uint8_t *rom, size_t size) {
+	if (size > chip8->memorySize - CHIP8_ROM_START_ADDRESS) {
+		CHIP8SetError(chip8, CHIP8_ERROR_ROM_TOO_LARGE);
+		return CHIP8_ERROR_ROM_TOO_LARGE;
+	}
+
+	return CHIP8WriteMemory(chip8, CHIP8_ROM_START_ADDRESS, rom, size);
+}
+
+CHIP8Result CHIP8ReadROM(const char *fileName, uint8_t *rom, size_t *size) {
+	FILE *file;
+	if ((file = fopen(fileName, "rb")) == NULL) {
+		return CHIP8_ERROR_OPEN_FILE_FAILED;
+	}
+
+	// Unbuffered, so the whole ROM goes straight into rom in one read.
+	setvbuf(file, NULL, _IONBF, 0);
+
+	*size = fread(rom, 1, CHIP8_MAX_ROM_SIZE, file);
+
+	// One byte more would not fit below 0x10000.
+	bool tooLarge = *size == CHIP8_MAX_ROM_SIZE && fgetc(file) != EOF;
+	bool failed = ferror(file) != 0;
+
+	fclose(file);
+
+	if (failed) {
+		return CHIP8_ERROR_OPEN_FILE_FAILED;
+	}
+
+	if (tooLarge) {
+		return CHIP8_ERROR_ROM_TOO_LARGE;
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8SetMode(CHIP8 *chip8, CHIP8Mode mode) {
+	if (mode == CHIP8_MODE_INTERPRETER) {
+		if (chip8->jit != NULL) {
+			CHIP8JitDestroy(chip8->jit);
+			chip8->jit = NULL;
+		}
+
+		return CHIP8_SUCCESS;
+	}
+
+	if (chip8->variant == CHIP8_VARIANT_XOCHIP) {
+		CHIP8SetError(chip8, CHIP8_ERROR_JIT_UNAVAILABLE);
+		return CHIP8_ERROR_JIT_UNAVAILABLE;
+	}
+
+	if (chip8->jit == NULL) {
+		chip8->jit = CHIP8JitInit();
+		if (chip8->jit == NULL) {
+			CHIP8SetError(chip8, CHIP8_ERROR_JIT_UNAVAILABLE);
+			return CHIP8_ERROR_JIT_UNAVAILABLE;
+		}
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8Seed(CHIP8 *chip8, uint64_t seed) {
+	// splitmix64 spreads nearby seeds apart; xorshift must not start from zero.
+	uint64_t z = seed + 0x9e3779b97f4a7c15;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	z ^= z >> 31;
+
+	chip8->random = z != 0 ? z : 0x9e3779b97f4a7c15;
+}
+
+void CHIP8SetTrace(CHIP8 *chip8, CHIP8Trace *trace) {
+	chip8->trace = trace;
+}
+
+CHIP8Result CHIP8SetProfile(CHIP8 *chip8, CHIP8Profile *profile) {
+	if (profile != NULL && chip8->variant == CHIP8_VARIANT_XOCHIP) {
+		CHIP8SetError(chip8, CHIP8_ERROR_PROFILE_UNAVAILABLE);
+		return CHIP8_ERROR_PROFILE_UNAVAILABLE;
+	}
+
+	chip8->profile = profile;
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8SetFrameCycles(CHIP8 *chip8, uint32_t frameCycles) {
+	chip8->frameCycles = frameCycles;
+	chip8->frameEnd = chip8->cycles + frameCycles;
+}
+
+CHIP8Result CHIP8SetBreakpoint(CHIP8 *chip8, uint16_t address, bool enabled) {
+	if (address >= chip8->breakpointsSize) {
+		// Nothing to clear past the end of the bitmap.
+		if (!enabled) {
+			return CHIP8_SUCCESS;
+		}
+
+		// 4 KB covers CHIP-8 and SUPER-CHIP; only XO-CHIP addresses need all 64 KB.
+		uint32_t size = address < CHIP8_MEMORY_SIZE ? CHIP8_MEMORY_SIZE : CHIP8_XO_MEMORY_SIZE;
+		uint64_t *breakpoints = (uint64_t *) realloc(chip8->breakpoints, size / 64 * sizeof(uint64_t));
+		if (breakpoints == NULL) {
+			CHIP8SetError(chip8, CHIP8_ERROR_OUT_OF_MEMORY);
+			return CHIP8_ERROR_OUT_OF_MEMORY;
+		}
+
+		memset(&breakpoints[chip8->breakpointsSize / 64], 0, (size - chip8->breakpointsSize) / 64 * sizeof(uint64_t));
+		chip8->breakpoints = breakpoints;
+		chip8->breakpointsSize = size;
+	}
+
+	if (enabled) {
+		chip8->breakpoints[address / 64] |= 1ull << (address % 64);
+	} else {
+		chip8->breakpoints[address / 64] &= ~(1ull << (address % 64));
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8ShareMemory(CHIP8 *chip8, const CHIP8 *source) {
+	if (chip8 == source) {
+		return CHIP8_SUCCESS;
+	}
+
+	if (chip8->numPages < source->numPages) {
+		CHIP8Result result = CHIP8GrowPages(chip8);
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+	}
+
+	// Pages past the end of a smaller source are cleared.
+	for (size_t p = 0; p < chip8->numPages; ++p) {
+		CHIP8Page *page = p < source->numPages ? source->pages[p] : &CHIP8ZeroPage;
+
+		atomic_fetch_add_explicit(&page->references, 1, memory_order_relaxed);
+		CHIP8PageRelease(chip8->pages[p]);
+		chip8->pages[p] = page;
+	}
+
+	if (chip8->jit != NULL) {
+		CHIP8JitInvalidate(chip8->jit, 0, CHIP8_MEMORY_SIZE);
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8DecodeMemory(CHIP8 *chip8) {
+	for (size_t p = 0; p < chip8->numPages; ++p) {
+		CHIP8Page *page = chip8->pages[p];
+		if (CHIP8PageIsShared(page)) {
+			continue;
+		}
+
+		for (size_t k = 0; k < CHIP8_PAGE_SIZE - 1; ++k) {
+			CHIP8Decode(page->data[k], page->data[k + 1], &page->cache[k]);
+		}
+	}
+}
+
+size_t CHIP8PrivatePages(const CHIP8 *chip8) {
+	size_t privatePages = 0;
+
+	for (size_t p = 0; p < chip8->numPages; ++p) {
+		privatePages += !CHIP8PageIsShared(chip8->pages[p]);
+	}
+
+	return privatePages;
+}
+
+uint8_t CHIP8ReadByte(const CHIP8 *chip8, uint16_t address) {
+	return chip8->pages[address / CHIP8_PAGE_SIZE]->data[address % CHIP8_PAGE_SIZE];
+}
+
+void CHIP8ReadMemory(const CHIP8 *chip8, size_t address, uint8_t *data, size_t size) {
+	while (size > 0) {
+		size_t offset = address % CHIP8_PAGE_SIZE;
+		size_t count = size < CHIP8_PAGE_SIZE - offset ? size : CHIP8_PAGE_SIZE - offset;
+
+		memcpy(data, &chip8->pages[address / CHIP8_PAGE_SIZE]->data[offset], count);
+
+		address += count;
+		data += count;
+		size -= count;
+	}
+}
+
+CHIP8Result CHIP8WriteMemory(CHIP8 *chip8, size_t address, const uint8_t *data, size_t size) {
+	// Any page chip8 has, e.g. for a save state; instructions check against memorySize themselves.
+	size_t end = chip8->numPages * CHIP8_PAGE_SIZE;
+	if (address > end || size > end - address) {
+		CHIP8SetError(chip8, CHIP8_ERROR_SEGFAULT);
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	bool changed = false;
+
+	for (size_t done = 0; done < size;) {
+		size_t offset = (address + done) % CHIP8_PAGE_SIZE;
+		size_t count = size - done < CHIP8_PAGE_SIZE - offset ? size - done : CHIP8_PAGE_SIZE - offset;
+		size_t p = (address + done) / CHIP8_PAGE_SIZE;
+
+		// Writing what is already there must not cost a shared page or any decoded code.
+		if (memcmp(&chip8->pages[p]->data[offset], data + done, count) != 0) {
+			CHIP8Page *page = CHIP8PageForWrite(chip8, p);
+			if (page == NULL) {
+				CHIP8SetError(chip8, CHIP8_ERROR_OUT_OF_MEMORY);
+				return CHIP8_ERROR_OUT_OF_MEMORY;
+			}
+
+			memcpy(&page->data[offset], data + done, count);
+			changed = true;
+		}
+
+		done += count;
+	}
+
+	if (changed) {
+		CHIP8InvalidateCache(chip8, address, size);
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8PrepareWrite(CHIP8 *chip8, size_t address, const uint8_t *data, size_t size) {
+	size_t end = chip8->numPages * CHIP8_PAGE_SIZE;
+	if (address > end || size > end - address) {
+		CHIP8SetError(chip8, CHIP8_ERROR_SEGFAULT);
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	for (size_t done = 0; done < size;) {
+		size_t offset = (address + done) % CHIP8_PAGE_SIZE;
+		size_t count = size - done < CHIP8_PAGE_SIZE - offset ? size - done : CHIP8_PAGE_SIZE - offset;
+		size_t p = (address + done) / CHIP8_PAGE_SIZE;
+
+		if (memcmp(&chip8->pages[p]->data[offset], data + done, count) != 0 && CHIP8PageForWrite(chip8, p) == NULL) {
+			CHIP8SetError(chip8, CHIP8_ERROR_OUT_OF_MEMORY);
+			return CHIP8_ERROR_OUT_OF_MEMORY;
+		}
+
+		done += count;
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Execute(CHIP8 *chip8) {
+	if (chip8->jit != NULL && chip8->trace == NULL && chip8->profile == NULL) {
+		return CHIP8JitExecute(chip8->jit, chip8, 1);
+	}
+
+	return CHIP8Interpret(chip8);
+}
+
+CHIP8Result CHIP8Interpret(CHIP8 *chip8) {
+	if (chip8->pc > chip8->memorySize - 2) {
+		CHIP8SetFault(chip8, CHIP8_ERROR_SEGFAULT, chip8->pc);
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	// Fetch
+	CHIP8Page *page = chip8->pages[chip8->pc / CHIP8_PAGE_SIZE];
+	CHIP8Instruction *instruction = &page->cache[chip8->pc % CHIP8_PAGE_SIZE];
+	CHIP8Instruction decoded;
+
+	// Decode (only the first time this address is executed, unless another machine can see the page
+	// or the instruction runs into the next one)
+	if (instruction->handler == NULL) {
+		if (CHIP8PageIsShared(page) || chip8->pc % CHIP8_PAGE_SIZE == CHIP8_PAGE_SIZE - 1) {
+			instruction = &decoded;
+		}
+		CHIP8Decode(CHIP8ReadByte(chip8, chip8->pc), CHIP8ReadByte(chip8, chip8->pc + 1), instruction);
+	}
+
+	// Execute
+	CHIP8Result result;
+	if (chip8->trace == NULL && chip8->profile == NULL) {
+		chip8->pc += 2;
+		++chip8->cycles;
+
+		result = instruction->handler(chip8, instruction);
+	} else if (chip8->profile != NULL) {
+		result = CHIP8ProfileExecute(chip8, instruction);
+	} else {
+		result = CHIP8TraceExecute(chip8->trace, chip8, instruction);
+	}
+
+	if (result != CHIP8_SUCCESS) {
+		// Handlers fail before they touch pc, so it still points past the instruction.
+		CHIP8SetFault(chip8, result, chip8->pc - 2);
+	}
+
+	return result;
+}
+
+CHIP8StopReason CHIP8Run(CHIP8 *chip8, uint64_t maxCycles, uint32_t stopMask) {
+	uint64_t startCycle = chip8->cycles;
+	uint64_t endCycle = maxCycles < UINT64_MAX - startCycle ? startCycle + maxCycles : UINT64_MAX;
+
+	// A machine without breakpoints cannot stop at one, so watching for them need not cost the fast paths.
+	if (chip8->breakpoints == NULL) {
+		stopMask &= ~(uint32_t) CHIP8_STOP_BREAKPOINT;
+	}
+
+	// Blocks cannot stop in the middle, so only the budget and frames can be watched with the JIT.
+	bool jit = chip8->jit != NULL && chip8->trace == NULL && chip8->profile == NULL && (stopMask & (CHIP8_STOP_BREAKPOINT | CHIP8_STOP_KEY_WAIT)) == 0;
+
+	while (chip8->cycles < endCycle) {
+		uint64_t runEnd = chip8->frameCycles != 0 && chip8->frameEnd < endCycle ? chip8->frameEnd : endCycle;
+
+		if (jit) {
+			if (chip8->cycles < runEnd && CHIP8JitExecute(chip8->jit, chip8, (int64_t) (runEnd - chip8->cycles)) != CHIP8_SUCCESS) {
+				return CHIP8_STOP_ERROR;
+			}
+		} else {
+			CHIP8StopReason reason = CHIP8RunInterpreter(chip8, runEnd, stopMask, startCycle);
+			if (reason != CHIP8_STOP_BUDGET) {
+				return reason;
+			}
+		}
+
+		// A block that overshot the frame shortens the next one, as with CHIP8Scheduler.
+		if (chip8->frameCycles != 0 && chip8->cycles >= chip8->frameEnd) {
+			CHIP8UpdateTimers(chip8);
+			chip8->frameEnd += chip8->frameCycles;
+
+			if ((stopMask & CHIP8_STOP_FRAME) != 0) {
+				return CHIP8_STOP_FRAME;
+			}
+		}
+	}
+
+	return CHIP8_STOP_BUDGET;
+}
+
+void CHIP8UpdateTimers(CHIP8 *chip8) {
+	if (chip8->dt > 0) {
+		--chip8->dt;
+	}
+
+	if (chip8->st > 0) {
+		--chip8->st;
+	}
+}
+
+size_t CHIP8StateSize(CHIP8Variant variant) {
+	size_t memorySize = variant == CHIP8_VARIANT_XOCHIP ? CHIP8_XO_MEMORY_SIZE : CHIP8_MEMORY_SIZE;
+
+	return CHIP8_STATE_REGISTERS_SIZE + 8 * CHIP8StateDisplayWords(variant) + memorySize;
+}
+
+CHIP8Result CHIP8SaveState(const CHIP8 *chip8, uint8_t *buffer, size_t size) {
+	if (size < CHIP8StateSize(chip8->variant)) {
+		return CHIP8_ERROR_INVALID_STATE;
+	}
+
+	uint8_t *out = buffer;
+
+	// The variant is in the header, since it decides how big the rest is.
+	memcpy(out, CHIP8_STATE_MAGIC, 4);
+	out = CHIP8StatePut(out + 4, CHIP8_STATE_VERSION, 2);
+	out = CHIP8StatePut(out, chip8->variant, 1);
+	out = CHIP8StatePut(out, 0, 1);
+
+	for (size_t i = 0; i < CHIP8_STACK_SIZE; ++i) {
+		out = CHIP8StatePut(out, chip8->stack[i], 2);
+	}
+
+	memcpy(out, chip8->v, CHIP8_NUM_V_REGISTERS);
+	out += CHIP8_NUM_V_REGISTERS;
+
+	out = CHIP8StatePut(out, chip8->i, 2);
+	out = CHIP8StatePut(out, chip8->pc, 2);
+	out = CHIP8StatePut(out, chip8->sp, 1);
+	out = CHIP8StatePut(out, chip8->dt, 1);
+	out = CHIP8StatePut(out, chip8->st, 1);
+
+	for (size_t i = 0; i < CHIP8_NUM_KEYS; ++i) {
+		out = CHIP8StatePut(out, chip8->keyboard[i], 1);
+	}
+
+	out = CHIP8StatePut(out, chip8->random, 8);
+
+	out = CHIP8StatePut(out, chip8->hires, 1);
+	out = CHIP8StatePut(out, chip8->planes, 1);
+	out = CHIP8StatePut(out, chip8->pitch, 1);
+
+	memcpy(out, chip8->flags, CHIP8_NUM_FLAGS);
+	out += CHIP8_NUM_FLAGS;
+	memcpy(out, chip8->pattern, CHIP8_PATTERN_SIZE);
+	out += CHIP8_PATTERN_SIZE;
+
+	const uint64_t *display = chip8->variant == CHIP8_VARIANT_CHIP8 ? chip8->display : &chip8->framebuffer[0][0][0];
+	for (size_t w = 0; w < CHIP8StateDisplayWords(chip8->variant); ++w) {
+		out = CHIP8StatePut(out, display[w], 8);
+	}
+
+	CHIP8ReadMemory(chip8, 0, out, chip8->memorySize);
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8LoadState(CHIP8 *chip8, const uint8_t *buffer, size_t size) {
+	const uint8_t *in = buffer;
+
+	if (size < 8 || memcmp(in, CHIP8_STATE_MAGIC, 4) != 0) {
+		CHIP8SetError(chip8, CHIP8_ERROR_INVALID_STATE);
+		return CHIP8_ERROR_INVALID_STATE;
+	}
+
+	in += 4;
+	uint16_t version = (uint16_t) CHIP8StateGet(&in, 2);
+	// Older versions are of CHIP-8 machines.
+	uint8_t variant = version >= 3 ? (uint8_t) CHIP8StateGet(&in, 1) : CHIP8_VARIANT_CHIP8;
+	in += version >= 3 ? 1 : 2;
+
+	size_t versionSize = version == 1 ? CHIP8_STATE_V2_SIZE - 8 : version == 2 ? CHIP8_STATE_V2_SIZE : CHIP8StateSize((CHIP8Variant) variant);
+	if (version < 1 || version > CHIP8_STATE_VERSION || variant >= CHIP8_NUM_VARIANTS || size < versionSize) {
+		CHIP8SetError(chip8, CHIP8_ERROR_INVALID_STATE);
+		return CHIP8_ERROR_INVALID_STATE;
+	}
+
+	// Decode the registers first so that a corrupt blob is rejected before anything is overwritten.
+	uint16_t stack[CHIP8_STACK_SIZE];
+	for (size_t i = 0; i < CHIP8_STACK_SIZE; ++i) {
+		stack[i] = (uint16_t) CHIP8StateGet(&in, 2);
+	}
+
+	const uint8_t *v = in;
+	in += CHIP8_NUM_V_REGISTERS;
+
+	uint16_t i = (uint16_t) CHIP8StateGet(&in, 2);
+	uint16_t pc = (uint16_t) CHIP8StateGet(&in, 2);
+	uint8_t sp = (uint8_t) CHIP8StateGet(&in, 1);
+	uint8_t dt = (uint8_t) CHIP8StateGet(&in, 1);
+	uint8_t st = (uint8_t) CHIP8StateGet(&in, 1);
+
+	const uint8_t *keyboard = in;
+	in += CHIP8_NUM_KEYS;
+
+	uint64_t random = version >= 2 ? CHIP8StateGet(&in, 8) : chip8->random;
+
+	// Nothing else to restore for older versions.
+	uint8_t hires = 0;
+	uint8_t planes = 0x1;
+	uint8_t pitch = CHIP8_DEFAULT_PITCH;
+	const uint8_t *flags = NULL;
+	const uint8_t *pattern = NULL;
+
+	if (version >= 3) {
+		hires = (uint8_t) CHIP8StateGet(&in, 1);
+		planes = (uint8_t) CHIP8StateGet(&in, 1);
+		pitch = (uint8_t) CHIP8StateGet(&in, 1);
+
+		flags = in;
+		in += CHIP8_NUM_FLAGS;
+		pattern = in;
+		in += CHIP8_PATTERN_SIZE;
+	}
+
+	bool valid = sp <= CHIP8_STACK_SIZE && hires <= 1 && planes < 1 << CHIP8_NUM_PLANES;
+	for (size_t k = 0; k < CHIP8_NUM_KEYS; ++k) {
+		valid &= keyboard[k] <= CHIP8_KEY_PRESSED;
+	}
+	valid &= variant != CHIP8_VARIANT_XOCHIP || (chip8->jit == NULL && chip8->profile == NULL);
+	// Nor would anything else fit in the planes the state has.
+	valid &= variant != CHIP8_VARIANT_CHIP8 || hires == 0;
+	valid &= variant == CHIP8_VARIANT_XOCHIP || planes == 0x1;
+
+	if (!valid) {
+		CHIP8SetError(chip8, CHIP8_ERROR_INVALID_STATE);
+		return CHIP8_ERROR_INVALID_STATE;
+	}
+
+	// Memory past the variant's is cleared.
+	size_t stateMemorySize = variant == CHIP8_VARIANT_XOCHIP ? CHIP8_XO_MEMORY_SIZE : CHIP8_MEMORY_SIZE;
+	const uint8_t *memory = in + 8 * CHIP8StateDisplayWords((CHIP8Variant) variant);
+
+	// Allocate what the variant needs and copy the shared pages that are about to change while failing still leaves
+	// chip8 as it was.
+	CHIP8Result result = CHIP8PrepareVariant(chip8, (CHIP8Variant) variant);
+	if (result != CHIP8_SUCCESS) {
+		return result;
+	}
+
+	for (size_t address = 0; address < chip8->numPages * CHIP8_PAGE_SIZE; address += CHIP8_PAGE_SIZE) {
+		const uint8_t *page = address < stateMemorySize ? &memory[address] : CHIP8ZeroPage.data;
+
+		result = CHIP8PrepareWrite(chip8, address, page, CHIP8_PAGE_SIZE);
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+	}
+
+	memcpy(chip8->stack, stack, sizeof(chip8->stack));
+	memcpy(chip8->v, v, CHIP8_NUM_V_REGISTERS);
+	chip8->i = i;
+	chip8->pc = pc;
+	chip8->sp = sp;
+	chip8->dt = dt;
+	chip8->st = st;
+
+	for (size_t k = 0; k < CHIP8_NUM_KEYS; ++k) {
+		chip8->keyboard[k] = (CHIP8Key) keyboard[k];
+	}
+
+	chip8->random = random;
+
+	chip8->variant = (CHIP8Variant) variant;
+	chip8->memorySize = (uint32_t) stateMemorySize;
+	chip8->hires = hires != 0;
+	chip8->planes = planes;
+	chip8->pitch = pitch;
+
+	if (flags != NULL) {
+		memcpy(chip8->flags, flags, CHIP8_NUM_FLAGS);
+		memcpy(chip8->pattern, pattern, CHIP8_PATTERN_SIZE);
+	} else {
+		memset(chip8->flags, 0, CHIP8_NUM_FLAGS);
+		memset(chip8->pattern, 0, CHIP8_PATTERN_SIZE);
+	}
+
+	uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+	if (variant == CHIP8_VARIANT_CHIP8) {
+		for (size_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+			display[0][y][0] = CHIP8StateGet(&in, 8);
+		}
+	} else {
+		uint64_t *words = &display[0][0][0];
+		size_t numWords = CHIP8StateDisplayWords((CHIP8Variant) variant);
+
+		for (size_t w = 0; w < numWords; ++w) {
+			words[w] = CHIP8StateGet(&in, 8);
+		}
+		memset(&words[numWords], 0, sizeof(display) - numWords * sizeof(uint64_t));
+	}
+
+	// Of a CHIP-8 display, only the words filled in above are read.
+	CHIP8WriteDisplay(chip8, display);
+
+	// Only pages that changed are invalidated, so restoring a nearby state keeps the decoded and compiled code.
+	// Every page they are in is private by now, so this cannot fail.
+	for (size_t address = 0; address < chip8->numPages * CHIP8_PAGE_SIZE; address += CHIP8_PAGE_SIZE) {
+		const uint8_t *page = address < stateMemorySize ? &memory[address] : CHIP8ZeroPage.data;
+
+		CHIP8WriteMemory(chip8, address, page, CHIP8_PAGE_SIZE);
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+uint64_t CHIP8Hash(const CHIP8 *chip8) {
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (size_t p = 0; p < chip8->memorySize / CHIP8_PAGE_SIZE; ++p) {
+		hash = CHIP8HashBytes(hash, chip8->pages[p]->data, CHIP8_PAGE_SIZE);
+	}
+
+	const struct {
+		const void *data;
+		size_t size;
+	} fields[] = {
+		{ chip8->stack, sizeof(chip8->stack) },
+		{ chip8->v, sizeof(chip8->v) },
+		{ &chip8->i, sizeof(chip8->i) },
+		{ &chip8->pc, sizeof(chip8->pc) },
+		{ &chip8->sp, sizeof(chip8->sp) },
+		{ &chip8->dt, sizeof(chip8->dt) },
+		{ &chip8->st, sizeof(chip8->st) },
+		{ &chip8->random, sizeof(chip8->random) }
+	};
+
+	for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); ++f) {
+		hash = CHIP8HashBytes(hash, (const uint8_t *) fields[f].data, fields[f].size);
+	}
+
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8HashBytes(hash, (const uint8_t *) chip8->display, sizeof(chip8->display));
+	}
+
+	// What a CHIP-8 machine would hash for the same picture comes first.
+	for (size_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+		hash = CHIP8HashBytes(hash, (const uint8_t *) &chip8->framebuffer[0][y][0], sizeof(uint64_t));
+	}
+
+	uint8_t mode[4] = { (uint8_t) chip8->variant, chip8->hires, chip8->planes, chip8->pitch };
+
+	hash = CHIP8HashBytes(hash, mode, sizeof(mode));
+	hash = CHIP8HashBytes(hash, chip8->flags, sizeof(chip8->flags));
+	hash = CHIP8HashBytes(hash, chip8->pattern, sizeof(chip8->pattern));
+	hash = CHIP8HashBytes(hash, (const uint8_t *) chip8->framebuffer, CHIP8_NUM_PLANES * sizeof(chip8->framebuffer[0]));
+
+	return hash;
+}
+
+CHIP8Pixel CHIP8GetPixel(const CHIP8 *chip8, uint8_t x, uint8_t y) {
+	uint64_t word = chip8->variant == CHIP8_VARIANT_CHIP8 ? chip8->display[y] : chip8->framebuffer[0][y][x / 64];
+
+	return (word >> (63 - x % 64)) & 0x1 ? CHIP8_PIXEL_ON : CHIP8_PIXEL_OFF;
+}
+
+uint64_t CHIP8GetDisplayRow(const CHIP8 *chip8, uint8_t y) {
+	return chip8->variant == CHIP8_VARIANT_CHIP8 ? chip8->display[y] : chip8->framebuffer[0][y][0];
+}
+
+void CHIP8ReadDisplay(const CHIP8 *chip8, uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]) {
+	if (chip8->variant != CHIP8_VARIANT_CHIP8) {
+		memcpy(display, chip8->framebuffer, CHIP8_NUM_PLANES * sizeof(chip8->framebuffer[0]));
+		return;
+	}
+
+	memset(display, 0, CHIP8_NUM_PLANES * sizeof(display[0]));
+	for (size_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+		display[0][y][0] = chip8->display[y];
+	}
+}
+
+void CHIP8WriteDisplay(CHIP8 *chip8, const uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS]) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		for (size_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+			chip8->dirtyRows |= (uint64_t) (chip8->display[y] != display[0][y][0]) << y;
+			chip8->display[y] = display[0][y][0];
+		}
+
+		return;
+	}
+
+	for (size_t y = 0; y < CHIP8_HIRES_HEIGHT; ++y) {
+		bool changed = false;
+
+		for (size_t p = 0; p < CHIP8_NUM_PLANES; ++p) {
+			changed |= memcmp(chip8->framebuffer[p][y], display[p][y], sizeof(display[p][y])) != 0;
+		}
+
+		chip8->dirtyRows |= (uint64_t) changed << y;
+	}
+
+	memcpy(chip8->framebuffer, display, CHIP8_NUM_PLANES * sizeof(chip8->framebuffer[0]));
+}
+
+uint64_t CHIP8TakeDirtyRows(CHIP8 *chip8) {
+	uint64_t dirtyRows = chip8->dirtyRows;
+	chip8->dirtyRows = 0;
+
+	return dirtyRows;
+}
+
+const char *CHIP8GetError(CHIP8 *chip8) {
+	if (chip8 == NULL) {
+		return CHIP8ErrorName(CHIP8_ERROR_INIT_FAILED);
+	}
+
+	if (!chip8->error.fault) {
+		return CHIP8ErrorName(chip8->error.code);
+	}
+
+	snprintf(
+		chip8->errorMessage,
+		CHIP8_ERROR_MESSAGE_SIZE,
+		"%s at 0x%03x (opcode %04x)",
+		CHIP8ErrorName(chip8->error.code),
+		chip8->error.pc,
+		chip8->error.opcode
+	);
+
+	return chip8->errorMessage;
+}
+
+void CHIP8SetError(CHIP8 *chip8, CHIP8Result result) {
+	chip8->error.code = result;
+	chip8->error.fault = false;
+}
+
+void CHIP8SetFault(CHIP8 *chip8, CHIP8Result result, uint16_t pc) {
+	chip8->error.code = result;
+	chip8->error.fault = true;
+	chip8->error.pc = pc;
+	chip8->error.opcode = pc <= chip8->memorySize - 2 ? CHIP8ReadByte(chip8, pc) << 8 | CHIP8ReadByte(chip8, pc + 1) : 0;
+}
+
+const char *CHIP8ErrorName(CHIP8Result result) {
+	switch (result) {
+		case CHIP8_SUCCESS:
+			return "No error";
+		case CHIP8_ERROR_INIT_FAILED:
+			return "Initialization failed";
+		case CHIP8_ERROR_INVALID_FONTSET:
+			return "Invalid fontset";
+		case CHIP8_ERROR_OPEN_FILE_FAILED:
+			return "Cannot open file";
+		case CHIP8_ERROR_SEGFAULT:
+			return "Segmentation fault";
+		case CHIP8_ERROR_STACK_UNDERFLOW:
+			return "Stack undeflow";
+		case CHIP8_ERROR_STACK_OVERFLOW:
+			return "Stack overflow";
+		case CHIP8_ERROR_KEY_NOT_FOUND:
+			return "Keyboard key not found";
+		case CHIP8_ERROR_INSTRUCTION_NOT_FOUND:
+			return "Instruction does not exist";
+		case CHIP8_ERROR_JIT_UNAVAILABLE:
+			return "JIT compiler not available";
+		case CHIP8_ERROR_INVALID_STATE:
+			return "Invalid save state";
+		case CHIP8_ERROR_MOVIE_DESYNC:
+			return "Movie replay does not match the recording";
+		case CHIP8_ERROR_ROM_TOO_LARGE:
+			return "ROM does not fit in memory";
+		case CHIP8_ERROR_OUT_OF_MEMORY:
+			return "Out of memory";
+		case CHIP8_ERROR_PROFILE_UNAVAILABLE:
+			return "Profiler not available";
+		default:
+			return "Error code does not exist";
+	}
+}
+
+// A CHIP-8 display is 32 one-word rows, and SUPER-CHIP only ever draws to the first plane.
+size_t CHIP8StateDisplayWords(CHIP8Variant variant) {
+	if (variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_DISPLAY_HEIGHT;
+	}
+
+	return (variant == CHIP8_VARIANT_XOCHIP ? CHIP8_NUM_PLANES : 1) * CHIP8_HIRES_HEIGHT * CHIP8_ROW_WORDS;
+}
+
+// Multi-byte state fields are little-endian regardless of the host.
+uint8_t *CHIP8StatePut(uint8_t *out, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		*out++ = (uint8_t) (value >> (8 * i));
+	}
+
+	return out;
+}
+
+uint64_t CHIP8StateGet(const uint8_t **in, size_t size) {
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; ++i) {
+		value |= (uint64_t) *(*in)++ << (8 * i);
+	}
+
+	return value;
+}
+
+// FNV-1a, continued from hash.
+uint64_t CHIP8HashBytes(uint64_t hash, const uint8_t *bytes, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+bool CHIP8PageIsShared(const CHIP8Page *page) {
+	// Acquire pairs with the release in CHIP8PageRelease: once the other holders are gone, so are their reads.
+	return atomic_load_explicit(&page->references, memory_order_acquire) != 1;
+}
+
+CHIP8Page *CHIP8PageForWrite(CHIP8 *chip8, size_t p) {
+	CHIP8Page *page = chip8->pages[p];
+	if (!CHIP8PageIsShared(page)) {
+		return page;
+	}
+
+	CHIP8Page *copy = (CHIP8Page *) malloc(sizeof(CHIP8Page));
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	// The decoded instructions stay valid; the caller invalidates what it overwrites.
+	atomic_init(&copy->references, 1);
+	memcpy(copy->data, page->data, sizeof(copy->data));
+	memcpy(copy->cache, page->cache, sizeof(copy->cache));
+
+	chip8->pages[p] = copy;
+	CHIP8PageRelease(page);
+
+	return copy;
+}
+
+void CHIP8PageRelease(CHIP8Page *page) {
+	if (atomic_fetch_sub_explicit(&page->references, 1, memory_order_acq_rel) == 1) {
+		free(page);
+	}
+}
+
+// Moves the page table out of the machine into one that covers all of XO-CHIP's memory, the new pages zeroed.
+CHIP8Result CHIP8GrowPages(CHIP8 *chip8) {
+	CHIP8Page **pages = (CHIP8Page **) malloc(CHIP8_XO_NUM_PAGES * sizeof(CHIP8Page *));
+	if (pages == NULL) {
+		CHIP8SetError(chip8, CHIP8_ERROR_OUT_OF_MEMORY);
+		return CHIP8_ERROR_OUT_OF_MEMORY;
+	}
+
+	memcpy(pages, chip8->pages, chip8->numPages * sizeof(CHIP8Page *));
+	for (size_t p = chip8->numPages; p < CHIP8_XO_NUM_PAGES; ++p) {
+		pages[p] = &CHIP8ZeroPage;
+	}
+	atomic_fetch_add_explicit(&CHIP8ZeroPage.references, CHIP8_XO_NUM_PAGES - chip8->numPages, memory_order_relaxed);
+
+	chip8->pages = pages;
+	chip8->numPages = CHIP8_XO_NUM_PAGES;
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8StopReason CHIP8RunInterpreter(CHIP8 *chip8, uint64_t endCycle, uint32_t stopMask, uint64_t startCycle) {
+	// Only budget and errors to watch: keep the loop to the instruction itself.
+	if ((stopMask & (CHIP8_STOP_BREAKPOINT | CHIP8_STOP_KEY_WAIT)) == 0) {
+		// A trace or profile would miss the instructions skipped.
+		bool skipIdle = chip8->trace == NULL && chip8->profile == NULL;
+
+		while (chip8->cycles < endCycle) {
+			uint16_t pc = chip8->pc;
+
+			if (CHIP8Interpret(chip8) != CHIP8_SUCCESS) {
+				return CHIP8_STOP_ERROR;
+			}
+
+			// Idle loops stay put or jump back to the fx07 two instructions before.
+			if ((chip8->pc == pc || chip8->pc == (uint16_t) (pc - 4)) && skipIdle) {
+				CHIP8SkipIdle(chip8, pc, endCycle);
+			}
+		}
+
+		return CHIP8_STOP_BUDGET;
+	}
+
+	while (chip8->cycles < endCycle) {
+		uint16_t pc = chip8->pc;
+
+		if (
+			(stopMask & CHIP8_STOP_BREAKPOINT) != 0 &&
+			chip8->cycles != startCycle &&
+			pc < chip8->breakpointsSize &&
+			(chip8->breakpoints[pc / 64] >> (pc % 64) & 1) != 0
+		) {
+			return CHIP8_STOP_BREAKPOINT;
+		}
+
+		if (CHIP8Interpret(chip8) != CHIP8_SUCCESS) {
+			return CHIP8_STOP_ERROR;
+		}
+
+		// fx0a waits by running itself again, so pc stays put; so does a jump to itself, which is not a key wait.
+		if ((stopMask & CHIP8_STOP_KEY_WAIT) != 0 && chip8->pc == pc && CHIP8IsKeyWait(chip8, pc)) {
+			return CHIP8_STOP_KEY_WAIT;
+		}
+	}
+
+	return CHIP8_STOP_BUDGET;
+}
+
+bool CHIP8IsKeyWait(const CHIP8 *chip8, uint16_t pc) {
+	return (CHIP8ReadOpcode(chip8, pc) & 0xF0FF) == 0xF00A;
+}
+
+// pc is the instruction that just ran. Nothing but the caller changes the keys
+// or ticks the timers while CHIP8Run runs, so an idle loop would go on until
+// endCycle; only whole iterations are skipped, so it ends where it would have.
+void CHIP8SkipIdle(CHIP8 *chip8, uint16_t pc, uint64_t endCycle) {
+	uint16_t opcode = CHIP8ReadOpcode(chip8, pc);
+	uint64_t skipped = 0;
+
+	if (chip8->pc == pc) {
+		// 00fd only gets here on machines that have it, and halts them for good.
+		if (opcode == (0x1000 | pc) || opcode == 0x00FD || CHIP8IsKeyWait(chip8, pc)) {
+			skipped = endCycle - chip8->cycles;
+		}
+	} else if (opcode == (0x1000 | chip8->pc)) {
+		// Vx already holds dt from the previous iteration, so the next ones only repeat it.
+		uint8_t x = (uint8_t) (CHIP8ReadOpcode(chip8, chip8->pc) >> 8 & 0xF);
+
+		if (
+			CHIP8ReadOpcode(chip8, chip8->pc) == (0xF007 | x << 8) &&
+			CHIP8ReadOpcode(chip8, chip8->pc + 2) == (0x3000 | x << 8) &&
+			chip8->v[x] == chip8->dt &&
+			chip8->dt != 0
+		) {
+			skipped = (endCycle - chip8->cycles) / 3 * 3;
+		}
+	}
+
+	chip8->cycles += skipped;
+	chip8->idleCycles += skipped;
+}
+
+uint16_t CHIP8ReadOpcode(const CHIP8 *chip8, uint16_t address) {
+	return (uint16_t) (CHIP8ReadByte(chip8, address) << 8 | CHIP8ReadByte(chip8, address + 1));
+}
+
+// Skips the instruction after the one that just ran; on XO-CHIP that is all four bytes of f000 nnnn.
+CHIP8Result CHIP8SkipNext(CHIP8 *chip8) {
+	uint16_t size = 2;
+	if (chip8->variant == CHIP8_VARIANT_XOCHIP && chip8->pc <= chip8->memorySize - 2 && CHIP8ReadOpcode(chip8, chip8->pc) == 0xF000) {
+		size = 4;
+	}
+
+	if (chip8->pc > chip8->memorySize - 1 - size) {
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	chip8->pc += size;
+
+	return CHIP8_SUCCESS;
+}
+
+// Lays a sprite row of width pixels over a 128-pixel row with its leftmost pixel at column x.
+// Pixels past column 127 are clipped.
+void CHIP8PlaceSprite(uint32_t sprite, uint32_t width, uint32_t x, uint64_t *row) {
+	int shift = CHIP8_HIRES_WIDTH - (int) width - (int) x;
+	unsigned __int128 placed = shift >= 0 ? (unsigned __int128) sprite << shift : (unsigned __int128) sprite >> -shift;
+
+	row[0] = (uint64_t) (placed >> 64);
+	row[1] = (uint64_t) placed;
+}
+
+// Positive rows scroll the selected planes down, negative ones up.
+void CHIP8ScrollVertical(CHIP8 *chip8, int rows) {
+	uint32_t height = chip8->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+	uint32_t count = (uint32_t) (rows < 0 ? -rows : rows);
+	if (count > height) {
+		count = height;
+	}
+
+	for (size_t p = 0; p < CHIP8_NUM_PLANES; ++p) {
+		if ((chip8->planes >> p & 0x1) == 0) {
+			continue;
+		}
+
+		uint64_t (*plane)[CHIP8_ROW_WORDS] = chip8->framebuffer[p];
+
+		if (rows > 0) {
+			memmove(&plane[count], &plane[0], (height - count) * sizeof(plane[0]));
+			memset(&plane[0], 0, count * sizeof(plane[0]));
+		} else {
+			memmove(&plane[0], &plane[count], (height - count) * sizeof(plane[0]));
+			memset(&plane[height - count], 0, count * sizeof(plane[0]));
+		}
+	}
+
+	chip8->dirtyRows |= chip8->hires ? UINT64_MAX : UINT32_MAX;
+}
+
+// Positive columns scroll the selected planes right, negative ones left; a hires row shifts as one 128-bit word.
+void CHIP8ScrollHorizontal(CHIP8 *chip8, int columns) {
+	uint32_t height = chip8->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+	uint32_t count = (uint32_t) (columns < 0 ? -columns : columns);
+
+	for (size_t p = 0; p < CHIP8_NUM_PLANES; ++p) {
+		if ((chip8->planes >> p & 0x1) == 0) {
+			continue;
+		}
+
+		for (size_t y = 0; y < height; ++y) {
+			uint64_t *row = chip8->framebuffer[p][y];
+
+			if (!chip8->hires) {
+				row[0] = columns > 0 ? row[0] >> count : row[0] << count;
+			} else if (columns > 0) {
+				row[1] = row[1] >> count | row[0] << (64 - count);
+				row[0] >>= count;
+			} else {
+				row[0] = row[0] << count | row[1] >> (64 - count);
+				row[1] <<= count;
+			}
+		}
+	}
+
+	chip8->dirtyRows |= chip8->hires ? UINT64_MAX : UINT32_MAX;
+}
+
+void CHIP8ClearPlanes(CHIP8 *chip8, uint8_t planes) {
+	for (size_t p = 0; p < CHIP8_NUM_PLANES; ++p) {
+		if ((planes >> p & 0x1) == 0) {
+			continue;
+		}
+
+		for (uint8_t y = 0; y < CHIP8_HIRES_HEIGHT; ++y) {
+			uint64_t *row = chip8->framebuffer[p][y];
+
+			chip8->dirtyRows |= (uint64_t) ((row[0] | row[1]) != 0) << y;
+			row[0] = 0;
+			row[1] = 0;
+		}
+	}
+}
+
+void CHIP8Decode(uint8_t msbyte, uint8_t lsbyte, CHIP8Instruction *instruction) {
+	uint8_t opcode = msbyte >> 4;
+
+	instruction->x = msbyte & 0x0F;
+	instruction->y = lsbyte >> 4;
+	instruction->n = lsbyte & 0x0F;
+
+	instruction->kk = lsbyte;
+	instruction->nnn = instruction->x << 8 | lsbyte;
+
+	instruction->op = CHIP8_OP_INVALID;
+
+	switch(opcode) {
+		case 0x0:
+			switch(instruction->nnn) {
+				case 0x0e0:
+					instruction->op = CHIP8_OP_00E0;
+					break;
+				case 0x0ee:
+					instruction->op = CHIP8_OP_00EE;
+					break;
+				case 0x0fb:
+					instruction->op = CHIP8_OP_00FB;
+					break;
+				case 0x0fc:
+					instruction->op = CHIP8_OP_00FC;
+					break;
+				case 0x0fd:
+					instruction->op = CHIP8_OP_00FD;
+					break;
+				case 0x0fe:
+					instruction->op = CHIP8_OP_00FE;
+					break;
+				case 0x0ff:
+					instruction->op = CHIP8_OP_00FF;
+					break;
+			}
+			if (instruction->nnn >> 4 == 0x00c) {
+				instruction->op = CHIP8_OP_00CN;
+			} else if (instruction->nnn >> 4 == 0x00d) {
+				instruction->op = CHIP8_OP_00DN;
+			}
+			break;
+		case 0x1:
+			instruction->op = CHIP8_OP_1NNN;
+			break;
+		case 0x2:
+			instruction->op = CHIP8_OP_2NNN;
+			break;
+		case 0x3:
+			instruction->op = CHIP8_OP_3XKK;
+			break;
+		case 0x4:
+			instruction->op = CHIP8_OP_4XKK;
+			break;
+		case 0x5:
+			switch(instruction->n) {
+				case 0x0:
+					instruction->op = CHIP8_OP_5XY0;
+					break;
+				case 0x2:
+					instruction->op = CHIP8_OP_5XY2;
+					break;
+				case 0x3:
+					instruction->op = CHIP8_OP_5XY3;
+					break;
+			}
+			break;
+		case 0x6:
+			instruction->op = CHIP8_OP_6XKK;
+			break;
+		case 0x7:
+			instruction->op = CHIP8_OP_7XKK;
+			break;
+		case 0x8:
+			switch(instruction->n) {
+				case 0x0:
+					instruction->op = CHIP8_OP_8XY0;
+					break;
+				case 0x1:
+					instruction->op = CHIP8_OP_8XY1;
+					break;
+				case 0x2:
+					instruction->op = CHIP8_OP_8XY2;
+					break;
+				case 0x3:
+					instruction->op = CHIP8_OP_8XY3;
+					break;
+				case 0x4:
+					instruction->op = CHIP8_OP_8XY4;
+					break;
+				case 0x5:
+					instruction->op = CHIP8_OP_8XY5;
+					break;
+				case 0x6:
+					instruction->op = CHIP8_OP_8XY6;
+					break;
+				case 0x7:
+					instruction->op = CHIP8_OP_8XY7;
+					break;
+				case 0xe:
+					instruction->op = CHIP8_OP_8XYE;
+					break;
+			}
+			break;
+		case 0x9:
+			if (instruction->n == 0x0) {
+				instruction->op = CHIP8_OP_9XY0;
+			}
+			break;
+		case 0xa:
+			instruction->op = CHIP8_OP_ANNN;
+			break;
+		case 0xb:
+			instruction->op = CHIP8_OP_BNNN;
+			break;
+		case 0xc:
+			instruction->op = CHIP8_OP_CXKK;
+			break;
+		case 0xd:
+			instruction->op = CHIP8_OP_DXYN;
+			break;
+		case 0xe:
+			switch(instruction->kk) {
+				case 0x9e:
+					instruction->op = CHIP8_OP_EX9E;
+					break;
+				case 0xa1:
+					instruction->op = CHIP8_OP_EXA1;
+					break;
+			}
+			break;
+		case 0xf:
+			switch(instruction->kk) {
+				case 0x00:
+					if (instruction->x == 0x0) {
+						instruction->op = CHIP8_OP_F000;
+					}
+					break;
+				case 0x01:
+					instruction->op = CHIP8_OP_FN01;
+					break;
+				case 0x02:
+					if (instruction->x == 0x0) {
+						instruction->op = CHIP8_OP_F002;
+					}
+					break;
+				case 0x07:
+					instruction->op = CHIP8_OP_FX07;
+					break;
+				case 0x0a:
+					instruction->op = CHIP8_OP_FX0A;
+					break;
+				case 0x15:
+					instruction->op = CHIP8_OP_FX15;
+					break;
+				case 0x18:
+					instruction->op = CHIP8_OP_FX18;
+					break;
+				case 0x1e:
+					instruction->op = CHIP8_OP_FX1E;
+					break;
+				case 0x29:
+					instruction->op = CHIP8_OP_FX29;
+					break;
+				case 0x30:
+					instruction->op = CHIP8_OP_FX30;
+					break;
+				case 0x33:
+					instruction->op = CHIP8_OP_FX33;
+					break;
+				case 0x3a:
+					instruction->op = CHIP8_OP_FX3A;
+					break;
+				case 0x55:
+					instruction->op = CHIP8_OP_FX55;
+					break;
+				case 0x65:
+					instruction->op = CHIP8_OP_FX65;
+					break;
+				case 0x75:
+					instruction->op = CHIP8_OP_FX75;
+					break;
+				case 0x85:
+					instruction->op = CHIP8_OP_FX85;
+					break;
+			}
+			break;
+	}
+
+	instruction->handler = CHIP8Handlers[instruction->op];
+}
+
+void CHIP8InvalidateCache(CHIP8 *chip8, size_t address, size_t size) {
+	// An instruction starting one byte before the written range overlaps it too.
+	size_t start = address > 0 ? address - 1 : 0;
+	size_t memoryEnd = chip8->numPages * CHIP8_PAGE_SIZE;
+	size_t end = address + size < memoryEnd ? address + size : memoryEnd;
+
+	for (size_t i = start; i < end; ++i) {
+		CHIP8Page *page = chip8->pages[i / CHIP8_PAGE_SIZE];
+
+		// Shared pages cannot have been written to.
+		if (!CHIP8PageIsShared(page)) {
+			page->cache[i % CHIP8_PAGE_SIZE].handler = NULL;
+		}
+	}
+
+	if (chip8->jit != NULL) {
+		CHIP8JitInvalidate(chip8->jit, start, end - start);
+	}
+}
+
+CHIP8Result CHIP8Handle_invalid(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+}
+
+CHIP8Result CHIP8Handle_00e0(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_00e0(chip8);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00ee(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_00ee(chip8);
+}
+
+CHIP8Result CHIP8Handle_1nnn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_1nnn(chip8, instruction->nnn);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_2nnn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_2nnn(chip8, instruction->nnn);
+}
+
+CHIP8Result CHIP8Handle_3xkk(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_3xkk(chip8, instruction->x, instruction->kk);
+}
+
+CHIP8Result CHIP8Handle_4xkk(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_4xkk(chip8, instruction->x, instruction->kk);
+}
+
+CHIP8Result CHIP8Handle_5xy0(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_5xy0(chip8, instruction->x, instruction->y);
+}
+
+CHIP8Result CHIP8Handle_6xkk(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_6xkk(chip8, instruction->x, instruction->kk);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_7xkk(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_7xkk(chip8, instruction->x, instruction->kk);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy0(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy0(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy1(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy1(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy2(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy2(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy3(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy3(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy4(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy4(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy5(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy5(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy6(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy6(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xy7(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xy7(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_8xye(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_8xye(chip8, instruction->x, instruction->y);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_9xy0(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_9xy0(chip8, instruction->x, instruction->y);
+}
+
+CHIP8Result CHIP8Handle_annn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_annn(chip8, instruction->nnn);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_bnnn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_bnnn(chip8, instruction->nnn);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_cxkk(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_cxkk(chip8, instruction->x, instruction->kk);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_dxyn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_dxyn(chip8, instruction->x, instruction->y, instruction->n);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_ex9e(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_ex9e(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_exa1(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_exa1(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx07(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_fx07(chip8, instruction->x);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_fx0a(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx0a(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx15(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_fx15(chip8, instruction->x);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_fx18(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8_fx18(chip8, instruction->x);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_fx1e(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx1e(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx29(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx29(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx33(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx33(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx55(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx55(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx65(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	return CHIP8_fx65(chip8, instruction->x);
+}
+
+// SUPER-CHIP and XO-CHIP instructions decode on every machine; ones that do not have them reject them here.
+
+CHIP8Result CHIP8Handle_00cn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	CHIP8_00cn(chip8, instruction->n);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00fb(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	CHIP8_00fb(chip8);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00fc(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	CHIP8_00fc(chip8);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00fd(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	CHIP8_00fd(chip8);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00fe(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
 
-	return chip8;
+	CHIP8_00fe(chip8);
+	return CHIP8_SUCCESS;
 }
 
-void CHIP8Destroy(CHIP8 *chip8) {
-	free(chip8);
+CHIP8Result CHIP8Handle_00ff(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	CHIP8_00ff(chip8);
+	return CHIP8_SUCCESS;
 }
 
-CHIP8Result CHIP8LoadFontset(CHIP8 *chip8, const uint8_t *fontset, size_t fontsetSize) {
-	if (fontsetSize != 80) {
-		CHIP8SetError(CHIP8_ERROR_INVALID_FONTSET);
-		return CHIP8_ERROR_INVALID_FONTSET;
+CHIP8Result CHIP8Handle_fx30(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
-	
-	for (size_t i = 0; i < 80; ++i) {
-		chip8->memory[CHIP8_FONTSET_START_ADDRESS + i] = fontset[i];
+
+	return CHIP8_fx30(chip8, instruction->x);
+}
+
+CHIP8Result CHIP8Handle_fx75(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
 
+	CHIP8_fx75(chip8, instruction->x);
 	return CHIP8_SUCCESS;
 }
 
-CHIP8Result CHIP8LoadROM(CHIP8 *chip8, const char *fileName) {
-	FILE *file;
-	if ((file = fopen(fileName, "rb")) == NULL) {
-		CHIP8SetError(CHIP8_ERROR_OPEN_FILE_FAILED);
-		return CHIP8_ERROR_OPEN_FILE_FAILED;
+CHIP8Result CHIP8Handle_fx85(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant == CHIP8_VARIANT_CHIP8) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
-	
-	fseek(file, 0, SEEK_SET);
-	
-	size_t i = CHIP8_ROM_START_ADDRESS;
-	for (; !feof(file) && i < CHIP8_MEMORY_SIZE; ++i) {
-		chip8->memory[i] = (uint8_t) fgetc(file);
 
-		#ifdef DEBUG
-		printf("Half instruction %hhx loaded in location n. %hhx.\n", chip8->memory[i], i);
-		#endif
+	CHIP8_fx85(chip8, instruction->x);
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8Handle_00dn(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
 
-	fclose(file);
+	CHIP8_00dn(chip8, instruction->n);
+	return CHIP8_SUCCESS;
+}
 
-	if (i == CHIP8_MEMORY_SIZE) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-		return CHIP8_ERROR_SEGFAULT;
+CHIP8Result CHIP8Handle_5xy2(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
-	
-	return CHIP8_SUCCESS;
+
+	return CHIP8_5xy2(chip8, instruction->x, instruction->y);
 }
 
-CHIP8Result CHIP8Execute(CHIP8 *chip8) {
-	// Fetch
-	uint8_t msbyte = chip8->memory[chip8->pc]; 
-	++chip8->pc;
-	uint8_t lsbyte = chip8->memory[chip8->pc]; 
-	++chip8->pc;
+CHIP8Result CHIP8Handle_5xy3(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
 
-	#ifdef DEBUG
-	printf("Execute instruction %hhx.\n", msbyte << 8 | lsbyte);
-	#endif
+	return CHIP8_5xy3(chip8, instruction->x, instruction->y);
+}
 
-	// Decode
-	uint8_t opcode = msbyte >> 4;
+CHIP8Result CHIP8Handle_f000(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
 
-	uint8_t x = msbyte & 0x0F;		
-	uint8_t y = lsbyte >> 4; 
-	uint8_t n = lsbyte & 0x0F; 	 
-	
-	uint8_t kk = lsbyte; 	
-	uint16_t nnn = x << 8 | lsbyte;
+	return CHIP8_f000(chip8);
+}
 
-	switch(opcode) {
-		case 0x0:
-			switch(nnn) {
-				case 0x0e0:
-					CHIP8_00e0(chip8);
-					break;
-				case 0x0ee:
-					return CHIP8_00ee(chip8);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		case 0x1:
-			CHIP8_1nnn(chip8, nnn);
-			break;
-		case 0x2:
-			return CHIP8_2nnn(chip8, nnn);
-			break;
-		case 0x3:
-			return CHIP8_3xkk(chip8, x, kk);
-			break;
-		case 0x4:
-			return CHIP8_4xkk(chip8, x, kk);
-			break;
-		case 0x5:
-			switch(n) {
-				case 0x0:
-					return CHIP8_5xy0(chip8, x, y);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		case 0x6:
-			CHIP8_6xkk(chip8, x, kk);
-			break;
-		case 0x7:
-			CHIP8_7xkk(chip8, x, kk);
-			break;
-		case 0x8:
-			switch(n) {
-				case 0x0:
-					CHIP8_8xy0(chip8, x, y);
-					break;
-				case 0x1:
-					CHIP8_8xy1(chip8, x, y);
-					break;
-				case 0x2:
-					CHIP8_8xy2(chip8, x, y);
-					break;
-				case 0x3:
-					CHIP8_8xy3(chip8, x, y);
-					break;
-				case 0x4:
-					CHIP8_8xy4(chip8, x, y);
-					break;
-				case 0x5:
-					CHIP8_8xy5(chip8, x, y);
-					break;
-				case 0x6:
-					CHIP8_8xy6(chip8, x, y);
-					break;
-				case 0x7:
-					CHIP8_8xy7(chip8, x, y);
-					break;
-				case 0xe:
-					CHIP8_8xye(chip8, x, y);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		case 0x9:
-			switch(n) {
-				case 0x0:
-					return CHIP8_9xy0(chip8, x, y);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		case 0xa:
-			CHIP8_annn(chip8, nnn);
-			break;
-		case 0xb:
-			CHIP8_bnnn(chip8, nnn);
-			break;
-		case 0xc:
-			CHIP8_cxkk(chip8, x, kk);
-			break;
-		case 0xd:
-			CHIP8_dxyn(chip8, x, y, n);
-			break;
-		case 0xe:
-			switch(kk) {
-				case 0x9e:
-					return CHIP8_ex9e(chip8, x);
-					break;
-				case 0xa1:
-					return CHIP8_exa1(chip8, x);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		case 0xf:
-			switch(kk) {
-				case 0x07:
-					CHIP8_fx07(chip8, x);
-					break;
-				case 0x0a:
-					return CHIP8_fx0a(chip8, x);
-					break;
-				case 0x15:
-					CHIP8_fx15(chip8, x);
-					break;
-				case 0x18:
-					CHIP8_fx18(chip8, x);
-					break;
-				case 0x1e:
-					return CHIP8_fx1e(chip8, x);
-					break;
-				case 0x29:
-					return CHIP8_fx29(chip8, x);
-					break;
-				case 0x33:
-					CHIP8_fx33(chip8, x);
-					break;
-				case 0x55:
-					return CHIP8_fx55(chip8, x);
-					break;
-				case 0x65:
-					return CHIP8_fx65(chip8, x);
-					break;
-				default:
-					CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-					return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-					break;
-			}
-			break;
-		default:
-			CHIP8SetError(CHIP8_ERROR_INSTRUCTION_NOT_FOUND);
-			return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
-			break;
+CHIP8Result CHIP8Handle_fn01(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
 
+	CHIP8_fn01(chip8, instruction->x);
 	return CHIP8_SUCCESS;
 }
 
-const char *CHIP8GetError() {
-	return CHIP8ErrorMessage;
+CHIP8Result CHIP8Handle_f002(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	}
+
+	return CHIP8_f002(chip8);
 }
 
-void CHIP8SetError(CHIP8Result errorCode) {
-	switch (errorCode) {
-		case CHIP8_ERROR_INIT_FAILED:
-			safeStringCopy(CHIP8ErrorMessage, "Initialization failed", CHIP8_ERROR_MESSAGE_SIZE);
-			break;		
-		case CHIP8_ERROR_INVALID_FONTSET:
-			safeStringCopy(CHIP8ErrorMessage, "Invalid fontset", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_OPEN_FILE_FAILED:
-			safeStringCopy(CHIP8ErrorMessage, "Cannot open file", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_SEGFAULT:
-			safeStringCopy(CHIP8ErrorMessage, "Segmentation fault", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_STACK_UNDERFLOW:
-			safeStringCopy(CHIP8ErrorMessage, "Stack undeflow", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_STACK_OVERFLOW:
-			safeStringCopy(CHIP8ErrorMessage, "Stack overflow", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_KEY_NOT_FOUND:
-			safeStringCopy(CHIP8ErrorMessage, "Keyboard key not found", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		case CHIP8_ERROR_INSTRUCTION_NOT_FOUND:
-			safeStringCopy(CHIP8ErrorMessage, "Instruction does not exist", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
-		default:
-			safeStringCopy(CHIP8ErrorMessage, "Error code does not exist", CHIP8_ERROR_MESSAGE_SIZE);
-			break;
+CHIP8Result CHIP8Handle_fx3a(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->variant != CHIP8_VARIANT_XOCHIP) {
+		return CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
 	}
+
+	CHIP8_fx3a(chip8, instruction->x);
+	return CHIP8_SUCCESS;
 }
 
 void CHIP8_00e0(CHIP8 *chip8) {
-	for (uint8_t i = 0; i < 64; ++i) {
-		for (uint8_t j = 0; j < 32; ++j) {
-			chip8->display[i][j] = CHIP8_PIXEL_OFF;
-		}
+	if (chip8->variant != CHIP8_VARIANT_CHIP8) {
+		CHIP8ClearPlanes(chip8, chip8->planes);
+		return;
+	}
+
+	for (uint8_t y = 0; y < CHIP8_DISPLAY_HEIGHT; ++y) {
+		chip8->dirtyRows |= (uint64_t) (chip8->display[y] != 0) << y;
+		chip8->display[y] = 0;
 	}
 }
 
 CHIP8Result CHIP8_00ee(CHIP8 *chip8) {
 	if (chip8->sp == 0) {
-		CHIP8SetError(CHIP8_ERROR_STACK_UNDERFLOW);
 		return CHIP8_ERROR_STACK_UNDERFLOW;
 	}
 
@@ -365,7 +1959,6 @@ void CHIP8_1nnn(CHIP8 *chip8, uint16_t nnn) {
 
 CHIP8Result CHIP8_2nnn(CHIP8 *chip8, uint16_t nnn) {
 	if (chip8->sp == CHIP8_STACK_SIZE)  {
-		CHIP8SetError(CHIP8_ERROR_STACK_OVERFLOW);
 		return CHIP8_ERROR_STACK_OVERFLOW;
 	}
 
@@ -379,12 +1972,7 @@ CHIP8Result CHIP8_2nnn(CHIP8 *chip8, uint16_t nnn) {
 
 CHIP8Result CHIP8_3xkk(CHIP8 *chip8, uint8_t x, uint8_t kk) {
 	if (chip8->v[x] == kk) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -392,12 +1980,7 @@ CHIP8Result CHIP8_3xkk(CHIP8 *chip8, uint8_t x, uint8_t kk) {
 
 CHIP8Result CHIP8_4xkk(CHIP8 *chip8, uint8_t x, uint8_t kk) {
 	if (chip8->v[x] != kk) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -405,12 +1988,7 @@ CHIP8Result CHIP8_4xkk(CHIP8 *chip8, uint8_t x, uint8_t kk) {
 
 CHIP8Result CHIP8_5xy0(CHIP8 *chip8, uint8_t x, uint8_t y) {
 	if (chip8->v[x] == chip8->v[y]) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -486,12 +2064,7 @@ void CHIP8_8xye(CHIP8 *chip8, uint8_t x, uint8_t y) {
 
 CHIP8Result CHIP8_9xy0(CHIP8 *chip8, uint8_t x, uint8_t y) {
 	if (chip8->v[x] != chip8->v[y]) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -506,45 +2079,115 @@ void CHIP8_bnnn(CHIP8 *chip8, uint16_t nnn) {
 }
 
 void CHIP8_cxkk(CHIP8 *chip8, uint8_t x, uint8_t kk) {
-	srand(time(NULL));
-	chip8->v[x] = ((uint8_t) rand()) & kk; 
+	chip8->random ^= chip8->random >> 12;
+	chip8->random ^= chip8->random << 25;
+	chip8->random ^= chip8->random >> 27;
+
+	chip8->v[x] = ((uint8_t) ((chip8->random * 0x2545f4914f6cdd1d) >> 56)) & kk;
 }
 
 void CHIP8_dxyn(CHIP8 *chip8, uint8_t x, uint8_t y, uint8_t n) {
- 	uint8_t pixelX = chip8->v[x] % 64;
-    uint8_t pixelY = chip8->v[y] % 32;
-    uint8_t height = n;
+	if (chip8->variant != CHIP8_VARIANT_CHIP8) {
+		CHIP8DrawFramebuffer(chip8, x, y, n);
+		return;
+	}
+
+	uint8_t pixelX = chip8->v[x] % CHIP8_DISPLAY_WIDTH;
+	uint8_t pixelY = chip8->v[y] % CHIP8_DISPLAY_HEIGHT;
+	uint8_t height = n;
+
+	// Sprites are clipped at the right and bottom edges.
+	if (height > CHIP8_DISPLAY_HEIGHT - pixelY) {
+		height = CHIP8_DISPLAY_HEIGHT - pixelY;
+	}
+
+	uint64_t collision = 0;
+	uint64_t dirtyRows = 0;
+
+	for (uint8_t j = 0; j < height; ++j) {
+		uint64_t sprite = CHIP8ReadByte(chip8, (chip8->i + j) % CHIP8_MEMORY_SIZE);
+		uint64_t spriteRow = pixelX <= 56 ? sprite << (56 - pixelX) : sprite >> (pixelX - 56);
+
+		collision |= chip8->display[pixelY + j] & spriteRow;
+		chip8->display[pixelY + j] ^= spriteRow;
+		dirtyRows |= (uint64_t) (spriteRow != 0) << (pixelY + j);
+	}
+
+	chip8->dirtyRows |= dirtyRows;
+	chip8->v[0xf] = collision != 0;
+}
+
+void CHIP8DrawFramebuffer(CHIP8 *chip8, uint8_t x, uint8_t y, uint8_t n) {
+	bool hires = chip8->hires;
+	uint32_t width = hires ? CHIP8_HIRES_WIDTH : CHIP8_DISPLAY_WIDTH;
+	uint32_t height = hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+	// Both resolutions are powers of two.
+	uint32_t pixelX = chip8->v[x] & (width - 1);
+	uint32_t pixelY = chip8->v[y] & (height - 1);
+
+	// dxy0 draws a 16x16 sprite, two bytes a row.
+	bool big = n == 0;
+	uint32_t rows = big ? 16 : n;
+	uint32_t rowBytes = big ? 2 : 1;
+	uint32_t visibleRows = rows;
+
+	// Sprites are clipped at the right and bottom edges.
+	if (visibleRows > height - pixelY) {
+		visibleRows = height - pixelY;
+	}
+
+	// Kept in locals: the rows are uint64_t too, so the compiler would otherwise store dirtyRows on every row.
+	uint64_t collision = 0;
+	uint64_t dirtyRows = 0;
+	uint32_t address = chip8->i;
+	// As are both memory sizes.
+	uint32_t addressMask = chip8->memorySize - 1;
+	int loresShift = CHIP8_DISPLAY_WIDTH - (int) (rowBytes * 8) - (int) pixelX;
+
+	// Each selected plane takes the next sprite's worth of bytes.
+	for (size_t p = 0; p < CHIP8_NUM_PLANES; ++p) {
+		if ((chip8->planes >> p & 0x1) == 0) {
+			continue;
+		}
+
+		for (uint32_t j = 0; j < visibleRows; ++j) {
+			uint32_t sprite = CHIP8ReadByte(chip8, (address + j * rowBytes) & addressMask);
+			if (big) {
+				sprite = sprite << 8 | CHIP8ReadByte(chip8, (address + j * rowBytes + 1) & addressMask);
+			}
+
+			uint64_t *row = chip8->framebuffer[p][pixelY + j];
+			uint64_t spriteRow[CHIP8_ROW_WORDS] = { 0, 0 };
 
-    chip8->v[0xf] = 0;
+			if (hires) {
+				CHIP8PlaceSprite(sprite, rowBytes * 8, pixelX, spriteRow);
+
+				collision |= row[1] & spriteRow[1];
+				row[1] ^= spriteRow[1];
+			} else {
+				// A lores row is word 0 alone; anything past it is clipped.
+				spriteRow[0] = loresShift >= 0 ? (uint64_t) sprite << loresShift : (uint64_t) sprite >> -loresShift;
+			}
 
-    for (uint8_t j = 0; j < height; ++j) {
-        uint8_t spriteAddress = chip8->memory[chip8->i + j];
+			collision |= row[0] & spriteRow[0];
+			row[0] ^= spriteRow[0];
+			dirtyRows |= (uint64_t) ((spriteRow[0] | spriteRow[1]) != 0) << (pixelY + j);
+		}
 
-        for (uint8_t i = 0; i < 8; ++i) {
-            if (spriteAddress & (0x80 >> i)) {
-                if (chip8->display[pixelX + i][pixelY + j] == CHIP8_PIXEL_ON) {
-                    chip8->v[0xf] = 1;
-                }
+		address += rows * rowBytes;
+	}
 
-                chip8->display[pixelX + i][pixelY + j] ^= CHIP8_PIXEL_ON;
-            }
-        }
-    }
+	chip8->dirtyRows |= dirtyRows;
+	chip8->v[0xf] = collision != 0;
 }
 
 CHIP8Result CHIP8_ex9e(CHIP8 *chip8, uint8_t x) {
 	if (chip8->v[x] >= CHIP8_NUM_KEYS) {
-		CHIP8SetError(CHIP8_ERROR_KEY_NOT_FOUND);
 		return CHIP8_ERROR_KEY_NOT_FOUND;
 	}
 
 	if (chip8->keyboard[chip8->v[x]] == CHIP8_KEY_PRESSED) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -552,17 +2195,11 @@ CHIP8Result CHIP8_ex9e(CHIP8 *chip8, uint8_t x) {
 
 CHIP8Result CHIP8_exa1(CHIP8 *chip8, uint8_t x) {
 	if (chip8->v[x] >= CHIP8_NUM_KEYS) {
-		CHIP8SetError(CHIP8_ERROR_KEY_NOT_FOUND);
 		return CHIP8_ERROR_KEY_NOT_FOUND;
 	}
 
 	if (chip8->keyboard[chip8->v[x]] == CHIP8_KEY_NOT_PRESSED) {
-		if (chip8->pc > CHIP8_MEMORY_SIZE - 3) {
-			CHIP8SetError(CHIP8_ERROR_SEGFAULT);
-			return CHIP8_ERROR_SEGFAULT;
-		}
-
-		chip8->pc += 2;
+		return CHIP8SkipNext(chip8);
 	}
 
 	return CHIP8_SUCCESS;
@@ -581,7 +2218,6 @@ CHIP8Result CHIP8_fx0a(CHIP8 *chip8, uint8_t x) {
 	}
 
 	if (chip8->pc - 2 <= CHIP8_INTERPRETER_END_ADDRESS) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
 		return CHIP8_ERROR_SEGFAULT;
 	}
 
@@ -599,8 +2235,7 @@ void CHIP8_fx18(CHIP8 *chip8, uint8_t x) {
 }
 
 CHIP8Result CHIP8_fx1e(CHIP8 *chip8, uint8_t x) {
-	if (chip8->i >= CHIP8_MEMORY_SIZE - chip8->v[x]) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
+	if (chip8->i >= chip8->memorySize - chip8->v[x]) {
 		return CHIP8_ERROR_SEGFAULT;
 	}
 
@@ -611,7 +2246,6 @@ CHIP8Result CHIP8_fx1e(CHIP8 *chip8, uint8_t x) {
 
 CHIP8Result CHIP8_fx29(CHIP8 *chip8, uint8_t x) {
 	if (chip8->v[x] > 15) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
 		return CHIP8_ERROR_SEGFAULT;
 	}
 
@@ -620,40 +2254,151 @@ CHIP8Result CHIP8_fx29(CHIP8 *chip8, uint8_t x) {
 	return CHIP8_SUCCESS;
 }
 
-void CHIP8_fx33(CHIP8 *chip8, uint8_t x) {
+CHIP8Result CHIP8_fx33(CHIP8 *chip8, uint8_t x) {
+	if (chip8->i > chip8->memorySize - 3) {
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
 	uint8_t value = chip8->v[x];
+	uint8_t digits[3];
 
-	chip8->memory[chip8->i + 2] = value % 10;
+	digits[2] = value % 10;
 	value /= 10;
 
-	chip8->memory[chip8->i + 1] = value % 10;
+	digits[1] = value % 10;
 	value /= 10;
 
-	chip8->memory[chip8->i] = value % 10;
+	digits[0] = value % 10;
+
+	return CHIP8WriteMemory(chip8, chip8->i, digits, sizeof(digits));
 }
 
 CHIP8Result CHIP8_fx55(CHIP8 *chip8, uint8_t x) {
-	if (chip8->i > CHIP8_MEMORY_SIZE - x) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
+	if (chip8->i > chip8->memorySize - 1 - x) {
 		return CHIP8_ERROR_SEGFAULT;
 	}
 
-	for (uint8_t i = 0; i <= x; ++i) {
-		chip8->memory[chip8->i + i] = chip8->v[i];
+	return CHIP8WriteMemory(chip8, chip8->i, chip8->v, x + 1);
+}
+
+CHIP8Result CHIP8_fx65(CHIP8 *chip8, uint8_t x) {
+	if (chip8->i > chip8->memorySize - 1 - x) {
+		return CHIP8_ERROR_SEGFAULT;
 	}
 
+	CHIP8ReadMemory(chip8, chip8->i, chip8->v, x + 1);
+
 	return CHIP8_SUCCESS;
 }
 
-CHIP8Result CHIP8_fx65(CHIP8 *chip8, uint8_t x) {
-	if (chip8->i > CHIP8_MEMORY_SIZE - x) {
-		CHIP8SetError(CHIP8_ERROR_SEGFAULT);
+void CHIP8_00cn(CHIP8 *chip8, uint8_t n) {
+	CHIP8ScrollVertical(chip8, n);
+}
+
+void CHIP8_00fb(CHIP8 *chip8) {
+	CHIP8ScrollHorizontal(chip8, 4);
+}
+
+void CHIP8_00fc(CHIP8 *chip8) {
+	CHIP8ScrollHorizontal(chip8, -4);
+}
+
+void CHIP8_00fd(CHIP8 *chip8) {
+	// Exits by running itself forever, which CHIP8Run skips like a jump to itself.
+	chip8->pc -= 2;
+}
+
+void CHIP8_00fe(CHIP8 *chip8) {
+	chip8->hires = false;
+	CHIP8ClearPlanes(chip8, (1 << CHIP8_NUM_PLANES) - 1);
+	chip8->dirtyRows = UINT64_MAX;
+}
+
+void CHIP8_00ff(CHIP8 *chip8) {
+	chip8->hires = true;
+	CHIP8ClearPlanes(chip8, (1 << CHIP8_NUM_PLANES) - 1);
+	chip8->dirtyRows = UINT64_MAX;
+}
+
+CHIP8Result CHIP8_fx30(CHIP8 *chip8, uint8_t x) {
+	if (chip8->v[x] > 15) {
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	chip8->i = CHIP8_BIG_FONTSET_START_ADDRESS + chip8->v[x] * 10;
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8_fx75(CHIP8 *chip8, uint8_t x) {
+	memcpy(chip8->flags, chip8->v, x + 1);
+}
+
+void CHIP8_fx85(CHIP8 *chip8, uint8_t x) {
+	memcpy(chip8->v, chip8->flags, x + 1);
+}
+
+void CHIP8_00dn(CHIP8 *chip8, uint8_t n) {
+	CHIP8ScrollVertical(chip8, -n);
+}
+
+CHIP8Result CHIP8_5xy2(CHIP8 *chip8, uint8_t x, uint8_t y) {
+	// vx to vy, in that order, even if y < x.
+	uint8_t count = (x < y ? y - x : x - y) + 1;
+	if (chip8->i > chip8->memorySize - count) {
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	uint8_t values[CHIP8_NUM_V_REGISTERS];
+	for (uint8_t k = 0; k < count; ++k) {
+		values[k] = chip8->v[x < y ? x + k : x - k];
+	}
+
+	return CHIP8WriteMemory(chip8, chip8->i, values, count);
+}
+
+CHIP8Result CHIP8_5xy3(CHIP8 *chip8, uint8_t x, uint8_t y) {
+	uint8_t count = (x < y ? y - x : x - y) + 1;
+	if (chip8->i > chip8->memorySize - count) {
+		return CHIP8_ERROR_SEGFAULT;
+	}
+
+	uint8_t values[CHIP8_NUM_V_REGISTERS];
+	CHIP8ReadMemory(chip8, chip8->i, values, count);
+
+	for (uint8_t k = 0; k < count; ++k) {
+		chip8->v[x < y ? x + k : x - k] = values[k];
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+CHIP8Result CHIP8_f000(CHIP8 *chip8) {
+	// The address is the word after the instruction.
+	if (chip8->pc > chip8->memorySize - 2) {
 		return CHIP8_ERROR_SEGFAULT;
 	}
 
-	for (uint8_t i = 0; i <= x; ++i) {
-		chip8->v[i] = chip8->memory[chip8->i + i];
+	chip8->i = CHIP8ReadOpcode(chip8, chip8->pc);
+	chip8->pc += 2;
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8_fn01(CHIP8 *chip8, uint8_t n) {
+	chip8->planes = n & ((1 << CHIP8_NUM_PLANES) - 1);
+}
+
+CHIP8Result CHIP8_f002(CHIP8 *chip8) {
+	if (chip8->i > chip8->memorySize - CHIP8_PATTERN_SIZE) {
+		return CHIP8_ERROR_SEGFAULT;
 	}
 
+	CHIP8ReadMemory(chip8, chip8->i, chip8->pattern, CHIP8_PATTERN_SIZE);
+
 	return CHIP8_SUCCESS;
-}
\ No newline at end of file
+}
+
+void CHIP8_fx3a(CHIP8 *chip8, uint8_t x) {
+	chip8->pitch = chip8->v[x];
+}
@@ -0,0 +1,173 @@
+#include <core/chip8_audio.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHIP8_AUDIO_CACHE_LINE 64
+#define CHIP8_AUDIO_FRAMES_PER_SECOND 60
+
+typedef struct {
+	bool sounding;
+	double pushed;
+} CHIP8AudioFrame;
+
+struct CHIP8Audio {
+	uint32_t sampleRate;
+	uint32_t phaseStep;
+	int16_t amplitude;
+
+	// The emulation thread writes frames and advances tail, the audio callback advances head.
+	CHIP8AudioFrame frames[CHIP8_AUDIO_QUEUE_SIZE];
+	_Atomic size_t tail;
+	char tailPadding[CHIP8_AUDIO_CACHE_LINE - sizeof(size_t)];
+	_Atomic size_t head;
+	char headPadding[CHIP8_AUDIO_CACHE_LINE - sizeof(size_t)];
+
+	// Owned by the audio callback.
+	bool sounding;
+	uint32_t phase;
+	// Samples left of the frame playing, and the remainder of sampleRate / 60 carried between frames.
+	uint32_t frameSamples;
+	uint32_t frameRemainder;
+	// Samples rendered since the last frame ran out with none queued.
+	uint32_t heldSamples;
+
+	double totalLatency;
+	CHIP8AudioMetrics metrics;
+};
+
+static uint32_t CHIP8AudioNextFrameSamples(CHIP8Audio *audio);
+static void CHIP8AudioFill(CHIP8Audio *audio, int16_t *samples, size_t numSamples);
+static double CHIP8AudioNow();
+
+CHIP8Audio *CHIP8AudioInit(uint32_t sampleRate, uint32_t frequency, double volume) {
+	if (sampleRate == 0 || frequency == 0 || frequency >= sampleRate / 2 || volume < 0 || volume > 1) {
+		return NULL;
+	}
+
+	CHIP8Audio *audio = (CHIP8Audio *) malloc(sizeof(CHIP8Audio));
+	if (audio == NULL) {
+		return NULL;
+	}
+
+	memset(audio, 0, sizeof(CHIP8Audio));
+
+	audio->sampleRate = sampleRate;
+	// A 32-bit phase that wraps once per period; the top bit picks the half.
+	audio->phaseStep = (uint32_t) ((((uint64_t) frequency << 32) + sampleRate / 2) / sampleRate);
+	audio->amplitude = (int16_t) (volume * INT16_MAX);
+
+	atomic_init(&audio->tail, 0);
+	atomic_init(&audio->head, 0);
+
+	return audio;
+}
+
+void CHIP8AudioDestroy(CHIP8Audio *audio) {
+	free(audio);
+}
+
+bool CHIP8AudioPushFrame(CHIP8Audio *audio, bool sounding) {
+	size_t tail = atomic_load_explicit(&audio->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&audio->head, memory_order_acquire);
+
+	if (tail - head == CHIP8_AUDIO_QUEUE_SIZE) {
+		return false;
+	}
+
+	CHIP8AudioFrame *frame = &audio->frames[tail & (CHIP8_AUDIO_QUEUE_SIZE - 1)];
+	frame->sounding = sounding;
+	frame->pushed = CHIP8AudioNow();
+
+	atomic_store_explicit(&audio->tail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+void CHIP8AudioRender(CHIP8Audio *audio, int16_t *samples, size_t numSamples) {
+	double now = CHIP8AudioNow();
+	size_t done = 0;
+
+	while (done < numSamples) {
+		if (audio->frameSamples == 0) {
+			size_t head = atomic_load_explicit(&audio->head, memory_order_relaxed);
+			size_t tail = atomic_load_explicit(&audio->tail, memory_order_acquire);
+
+			if (head == tail) {
+				// Nothing new: hold the last state until the emulation catches up,
+				// or go quiet if it has stopped.
+				if (audio->heldSamples >= audio->sampleRate / CHIP8_AUDIO_FRAMES_PER_SECOND) {
+					audio->sounding = false;
+				}
+
+				size_t count = numSamples - done;
+				CHIP8AudioFill(audio, samples + done, count);
+				audio->heldSamples += (uint32_t) count;
+				audio->metrics.underruns += count;
+				return;
+			}
+
+			CHIP8AudioFrame *frame = &audio->frames[(tail - 1) & (CHIP8_AUDIO_QUEUE_SIZE - 1)];
+
+			// When this frame's first sample is due, relative to the start of the buffer.
+			double latency = now + (double) done / audio->sampleRate - frame->pushed;
+			audio->totalLatency += latency;
+			if (latency > audio->metrics.maxLatency) {
+				audio->metrics.maxLatency = latency;
+			}
+
+			audio->sounding = frame->sounding;
+			audio->metrics.skippedFrames += tail - head - 1;
+			++audio->metrics.frames;
+
+			atomic_store_explicit(&audio->head, tail, memory_order_release);
+
+			audio->frameSamples = CHIP8AudioNextFrameSamples(audio);
+			audio->heldSamples = 0;
+		}
+
+		size_t count = numSamples - done;
+		if (count > audio->frameSamples) {
+			count = audio->frameSamples;
+		}
+
+		CHIP8AudioFill(audio, samples + done, count);
+		audio->frameSamples -= (uint32_t) count;
+		done += count;
+	}
+}
+
+void CHIP8AudioGetMetrics(const CHIP8Audio *audio, CHIP8AudioMetrics *metrics) {
+	*metrics = audio->metrics;
+	metrics->averageLatency = audio->metrics.frames > 0 ? audio->totalLatency / audio->metrics.frames : 0;
+}
+
+// sampleRate / 60 rounded so that every 60 frames add up to exactly a second.
+uint32_t CHIP8AudioNextFrameSamples(CHIP8Audio *audio) {
+	uint32_t total = audio->frameRemainder + audio->sampleRate;
+	audio->frameRemainder = total % CHIP8_AUDIO_FRAMES_PER_SECOND;
+
+	return total / CHIP8_AUDIO_FRAMES_PER_SECOND;
+}
+
+void CHIP8AudioFill(CHIP8Audio *audio, int16_t *samples, size_t numSamples) {
+	if (!audio->sounding) {
+		memset(samples, 0, numSamples * sizeof(int16_t));
+		// Every tone starts on the same half of the wave.
+		audio->phase = 0;
+		return;
+	}
+
+	for (size_t i = 0; i < numSamples; ++i) {
+		samples[i] = (audio->phase & 0x80000000) ? (int16_t) -audio->amplitude : audio->amplitude;
+		audio->phase += audio->phaseStep;
+	}
+}
+
+double CHIP8AudioNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,100 @@
+#include <core/chip8_display.h>
+#include <string.h>
+
+// Four ARGB8888 pixels: one SSE2 register with GCC's vector extensions.
+typedef uint32_t CHIP8Pixels __attribute__((vector_size(16)));
+typedef int32_t CHIP8PixelMask __attribute__((vector_size(16)));
+
+#define CHIP8_PIXELS_PER_VECTOR (sizeof(CHIP8Pixels) / sizeof(uint32_t))
+
+#define CHIP8_PLANE_WORDS (CHIP8_HIRES_HEIGHT * CHIP8_ROW_WORDS)
+
+// Inlined into both of its calls, each with a constant width its loop unrolls for.
+static inline __attribute__((always_inline)) void CHIP8ExpandRow(const uint64_t *row, const uint64_t *secondRow, uint32_t width, const CHIP8Palette *palette, uint32_t scale, uint32_t *pixels);
+static inline __attribute__((always_inline)) void CHIP8StorePixels(CHIP8Pixels colours, uint32_t scale, uint32_t *out);
+
+void CHIP8ExpandDisplay(const uint64_t *display, uint32_t width, uint32_t firstRow, uint32_t numRows, const CHIP8Palette *palette, uint32_t scale, void *pixels, int pitch) {
+	size_t rowSize = width * scale * sizeof(uint32_t);
+
+	for (uint32_t y = 0; y < numRows; ++y) {
+		uint8_t *first = (uint8_t *) pixels + (size_t) y * scale * pitch;
+		const uint64_t *row = &display[(firstRow + y) * CHIP8_ROW_WORDS];
+
+		if (width == CHIP8_HIRES_WIDTH) {
+			CHIP8ExpandRow(row, row + CHIP8_PLANE_WORDS, CHIP8_HIRES_WIDTH, palette, scale, (uint32_t *) first);
+		} else {
+			CHIP8ExpandRow(row, row + CHIP8_PLANE_WORDS, CHIP8_DISPLAY_WIDTH, palette, scale, (uint32_t *) first);
+		}
+
+		for (uint32_t copy = 1; copy < scale; ++copy) {
+			memcpy(first + (size_t) copy * pitch, first, rowSize);
+		}
+	}
+}
+
+// One row of both planes, scale pixels to a CHIP8 pixel, from the leftmost pixel in bit 63 of word 0.
+void CHIP8ExpandRow(const uint64_t *row, const uint64_t *secondRow, uint32_t width, const CHIP8Palette *palette, uint32_t scale, uint32_t *pixels) {
+	const CHIP8Pixels foreground = (CHIP8Pixels) { 0 } + palette->foreground;
+	const CHIP8Pixels background = (CHIP8Pixels) { 0 } + palette->background;
+	const CHIP8Pixels secondary = (CHIP8Pixels) { 0 } + palette->secondary;
+	const CHIP8Pixels overlap = (CHIP8Pixels) { 0 } + palette->overlap;
+	// Lane k tests the bit of the k-th pixel in a nibble, counting from the left.
+	const CHIP8Pixels bits = { 8, 4, 2, 1 };
+
+	for (uint32_t w = 0; w < width / 64; ++w) {
+		uint64_t word = row[w];
+		uint64_t secondWord = secondRow[w];
+		uint32_t *out = pixels + w * 64 * scale;
+
+		// Only XO-CHIP draws to the second plane, so it is tested once per 64 pixels.
+		if (secondWord == 0) {
+			for (uint32_t x = 0; x < 64; x += CHIP8_PIXELS_PER_VECTOR) {
+				uint32_t nibble = (uint32_t) (word >> (64 - CHIP8_PIXELS_PER_VECTOR - x)) & 0xF;
+				CHIP8Pixels lit = (CHIP8Pixels) ((bits & nibble) != 0);
+
+				CHIP8StorePixels((foreground & lit) | (background & ~lit), scale, out + x * scale);
+			}
+		} else {
+			for (uint32_t x = 0; x < 64; x += CHIP8_PIXELS_PER_VECTOR) {
+				uint32_t shift = 64 - CHIP8_PIXELS_PER_VECTOR - x;
+				CHIP8Pixels lit = (CHIP8Pixels) ((bits & ((uint32_t) (word >> shift) & 0xF)) != 0);
+				CHIP8Pixels secondLit = (CHIP8Pixels) ((bits & ((uint32_t) (secondWord >> shift) & 0xF)) != 0);
+				CHIP8Pixels colours = (foreground & lit) | (background & ~lit);
+				CHIP8Pixels secondColours = (overlap & lit) | (secondary & ~lit);
+
+				CHIP8StorePixels((secondColours & secondLit) | (colours & ~secondLit), scale, out + x * scale);
+			}
+		}
+	}
+}
+
+// Four pixels, each scale pixels wide.
+void CHIP8StorePixels(CHIP8Pixels colours, uint32_t scale, uint32_t *out) {
+	switch (scale) {
+		case 1:
+			memcpy(out, &colours, sizeof(colours));
+			break;
+		case 2: {
+			CHIP8Pixels left = __builtin_shuffle(colours, (CHIP8PixelMask) { 0, 0, 1, 1 });
+			CHIP8Pixels right = __builtin_shuffle(colours, (CHIP8PixelMask) { 2, 2, 3, 3 });
+
+			memcpy(out, &left, sizeof(left));
+			memcpy(out + CHIP8_PIXELS_PER_VECTOR, &right, sizeof(right));
+			break;
+		}
+		default:
+			// Each pixel's colour across all four lanes, stored as often as it fits, then the rest one by one.
+			for (uint32_t k = 0; k < CHIP8_PIXELS_PER_VECTOR; ++k, out += scale) {
+				CHIP8Pixels same = (CHIP8Pixels) { 0 } + colours[k];
+
+				uint32_t s = 0;
+				for (; s + CHIP8_PIXELS_PER_VECTOR <= scale; s += CHIP8_PIXELS_PER_VECTOR) {
+					memcpy(out + s, &same, sizeof(same));
+				}
+				for (; s < scale; ++s) {
+					out[s] = colours[k];
+				}
+			}
+			break;
+	}
+}
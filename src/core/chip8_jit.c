@@ -0,0 +1,678 @@
+#include <core/chip8_jit.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_SUPPORTED
+#endif
+
+#ifdef CHIP8_JIT_SUPPORTED
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define CHIP8_JIT_CODE_SIZE (256 * 1024)
+#define CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS 32
+#define CHIP8_JIT_MAX_INSTRUCTION_SIZE 96
+#define CHIP8_JIT_MAX_BLOCK_SIZE (CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS * CHIP8_JIT_MAX_INSTRUCTION_SIZE + 128)
+#define CHIP8_JIT_MAX_LINKS 1024
+
+#define CHIP8_JIT_EAX 0
+#define CHIP8_JIT_ECX 1
+#define CHIP8_JIT_EDX 2
+
+#define CHIP8_JIT_JE 0x84
+#define CHIP8_JIT_JNE 0x85
+#define CHIP8_JIT_JLE 0x8e
+
+#define CHIP8_JIT_V(x) ((int32_t) (offsetof(CHIP8, v) + (x)))
+#define CHIP8_JIT_I ((int32_t) offsetof(CHIP8, i))
+#define CHIP8_JIT_PC ((int32_t) offsetof(CHIP8, pc))
+#define CHIP8_JIT_DT ((int32_t) offsetof(CHIP8, dt))
+#define CHIP8_JIT_ST ((int32_t) offsetof(CHIP8, st))
+#define CHIP8_JIT_CYCLES ((int32_t) offsetof(CHIP8, cycles))
+#define CHIP8_JIT_BUDGET ((int32_t) offsetof(CHIP8Jit, budget))
+
+// Translated code keeps the CHIP8 pointer in rbx and the CHIP8Jit pointer in r12.
+typedef CHIP8Result (*CHIP8JitEntry)(CHIP8 *chip8, CHIP8Jit *jit, uint8_t *body);
+
+typedef enum {
+	CHIP8_JIT_NATIVE,			// translated inline
+	CHIP8_JIT_HELPER,			// calls the interpreter handler and continues
+	CHIP8_JIT_HELPER_EXIT,		// calls the interpreter handler and returns to the dispatcher
+	CHIP8_JIT_CALL,				// 2nnn: calls the handler, then chains to nnn
+	CHIP8_JIT_JUMP,				// 1nnn: chains to nnn
+	CHIP8_JIT_SKIP,				// 3xkk, 4xkk, 5xy0, 9xy0: chains to pc + 2 or pc + 4
+	CHIP8_JIT_INTERPRET			// ends the block, the dispatcher interprets it
+} CHIP8JitKind;
+
+typedef struct {
+	uint8_t *site;
+	uint16_t target;
+} CHIP8JitLink;
+
+struct CHIP8Jit {
+	int64_t budget;
+
+	uint8_t *code;
+	size_t codeSize;
+	size_t trampolineSize;
+	uint8_t *returnSuccess;
+	uint8_t *epilogue;
+
+	uint8_t *blocks[CHIP8_MEMORY_SIZE];
+	bool covered[CHIP8_MEMORY_SIZE];
+	CHIP8Instruction records[CHIP8_MEMORY_SIZE];
+
+	// Static exits waiting for their target block to be compiled.
+	CHIP8JitLink links[CHIP8_JIT_MAX_LINKS];
+	size_t numLinks;
+};
+
+// Marks addresses the dispatcher hands to the interpreter.
+static uint8_t CHIP8JitInterpretMarker;
+
+static void CHIP8JitFlush(CHIP8Jit *jit);
+static uint8_t *CHIP8JitCompile(CHIP8Jit *jit, CHIP8 *chip8, uint16_t start);
+static CHIP8JitKind CHIP8JitClassify(uint16_t address, uint8_t msbyte, uint8_t lsbyte);
+
+static void CHIP8JitEmit8(CHIP8Jit *jit, uint8_t byte);
+static void CHIP8JitEmit16(CHIP8Jit *jit, uint16_t value);
+static void CHIP8JitEmit32(CHIP8Jit *jit, uint32_t value);
+static void CHIP8JitEmit64(CHIP8Jit *jit, uint64_t value);
+static void CHIP8JitEmitModRM(CHIP8Jit *jit, uint8_t reg, int32_t displacement);
+static void CHIP8JitEmitLoad(CHIP8Jit *jit, uint8_t reg, int32_t displacement);
+static void CHIP8JitEmitStore(CHIP8Jit *jit, uint8_t reg, int32_t displacement);
+static void CHIP8JitEmitSetPC(CHIP8Jit *jit, uint16_t pc);
+static uint8_t *CHIP8JitEmitJump(CHIP8Jit *jit, uint8_t *target);
+static uint8_t *CHIP8JitEmitBranch(CHIP8Jit *jit, uint8_t condition, uint8_t *target);
+static void CHIP8JitEmitExit(CHIP8Jit *jit, uint16_t target);
+static uint8_t *CHIP8JitEmitCall(CHIP8Jit *jit, const CHIP8Instruction *instruction, uint16_t pc);
+static void CHIP8JitEmitNative(CHIP8Jit *jit, uint8_t msbyte, const CHIP8Instruction *instruction);
+static void CHIP8JitEmitSkip(CHIP8Jit *jit, uint8_t msbyte, const CHIP8Instruction *instruction, uint16_t pc);
+static void CHIP8JitPatch(uint8_t *site, uint8_t *target);
+
+CHIP8Jit *CHIP8JitInit() {
+	CHIP8Jit *jit = (CHIP8Jit *) malloc(sizeof(CHIP8Jit));
+	if (jit == NULL) {
+		return NULL;
+	}
+
+	#ifdef _WIN32
+	jit->code = (uint8_t *) VirtualAlloc(NULL, CHIP8_JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+	if (jit->code == NULL) {
+		free(jit);
+		return NULL;
+	}
+	#else
+	jit->code = (uint8_t *) mmap(NULL, CHIP8_JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit->code == MAP_FAILED) {
+		free(jit);
+		return NULL;
+	}
+	#endif
+
+	jit->codeSize = 0;
+
+	// Trampoline: save callee-saved registers, load rbx/r12 and jump to the block body.
+	CHIP8JitEmit8(jit, 0x53);								// push rbx
+	CHIP8JitEmit8(jit, 0x41); CHIP8JitEmit8(jit, 0x54);	// push r12
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x83);	// sub rsp, 40
+	CHIP8JitEmit8(jit, 0xec); CHIP8JitEmit8(jit, 0x28);
+	#ifdef _WIN32
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xcb);	// mov rbx, rcx
+	CHIP8JitEmit8(jit, 0x49); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xd4);	// mov r12, rdx
+	CHIP8JitEmit8(jit, 0x41); CHIP8JitEmit8(jit, 0xff); CHIP8JitEmit8(jit, 0xe0);	// jmp r8
+	#else
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xfb);	// mov rbx, rdi
+	CHIP8JitEmit8(jit, 0x49); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xf4);	// mov r12, rsi
+	CHIP8JitEmit8(jit, 0xff); CHIP8JitEmit8(jit, 0xe2);							// jmp rdx
+	#endif
+
+	jit->returnSuccess = jit->code + jit->codeSize;
+	CHIP8JitEmit8(jit, 0x31); CHIP8JitEmit8(jit, 0xc0);	// xor eax, eax
+
+	jit->epilogue = jit->code + jit->codeSize;
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x83);	// add rsp, 40
+	CHIP8JitEmit8(jit, 0xc4); CHIP8JitEmit8(jit, 0x28);
+	CHIP8JitEmit8(jit, 0x41); CHIP8JitEmit8(jit, 0x5c);	// pop r12
+	CHIP8JitEmit8(jit, 0x5b);								// pop rbx
+	CHIP8JitEmit8(jit, 0xc3);								// ret
+
+	jit->trampolineSize = jit->codeSize;
+
+	CHIP8JitFlush(jit);
+
+	return jit;
+}
+
+void CHIP8JitDestroy(CHIP8Jit *jit) {
+	#ifdef _WIN32
+	VirtualFree(jit->code, 0, MEM_RELEASE);
+	#else
+	munmap(jit->code, CHIP8_JIT_CODE_SIZE);
+	#endif
+
+	free(jit);
+}
+
+CHIP8Result CHIP8JitExecute(CHIP8Jit *jit, CHIP8 *chip8, int64_t budget) {
+	jit->budget = budget;
+
+	while (jit->budget > 0) {
+		if (chip8->pc > CHIP8_MEMORY_SIZE - 2) {
+			// Let the interpreter report the fault.
+			return CHIP8Interpret(chip8);
+		}
+
+		uint8_t *body = jit->blocks[chip8->pc];
+		if (body == NULL) {
+			body = CHIP8JitCompile(jit, chip8, chip8->pc);
+		}
+
+		CHIP8Result result;
+		if (body == &CHIP8JitInterpretMarker) {
+			--jit->budget;
+			result = CHIP8Interpret(chip8);
+		} else {
+			result = ((CHIP8JitEntry) jit->code)(chip8, jit, body);
+
+			if (result != CHIP8_SUCCESS) {
+				// Only handlers fail, and CHIP8JitEmitCall left pc just past theirs.
+				CHIP8SetFault(chip8, result, chip8->pc - 2);
+			}
+		}
+
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8JitInvalidate(CHIP8Jit *jit, size_t address, size_t size) {
+	for (size_t i = address; i < address + size && i < CHIP8_MEMORY_SIZE; ++i) {
+		if (jit->covered[i]) {
+			// Self-modifying code is rare enough that dropping every block is cheaper than tracking them.
+			CHIP8JitFlush(jit);
+			return;
+		}
+	}
+}
+
+void CHIP8JitFlush(CHIP8Jit *jit) {
+	jit->codeSize = jit->trampolineSize;
+	jit->numLinks = 0;
+
+	memset(jit->blocks, 0, sizeof(jit->blocks));
+	memset(jit->covered, 0, sizeof(jit->covered));
+}
+
+CHIP8JitKind CHIP8JitClassify(uint16_t address, uint8_t msbyte, uint8_t lsbyte) {
+	uint8_t n = lsbyte & 0x0F;
+	// Skips near the end of memory take the handler path, which reports the fault.
+	bool canSkip = address + 2 <= CHIP8_MEMORY_SIZE - 3;
+
+	switch(msbyte >> 4) {
+		case 0x0:
+			if (msbyte == 0x00 && lsbyte == 0xe0) {
+				return CHIP8_JIT_HELPER;
+			}
+			if (msbyte == 0x00 && lsbyte == 0xee) {
+				return CHIP8_JIT_HELPER_EXIT;
+			}
+			return CHIP8_JIT_INTERPRET;
+		case 0x1:
+			return CHIP8_JIT_JUMP;
+		case 0x2:
+			return CHIP8_JIT_CALL;
+		case 0x3:
+		case 0x4:
+			return canSkip ? CHIP8_JIT_SKIP : CHIP8_JIT_HELPER_EXIT;
+		case 0x5:
+		case 0x9:
+			if (n != 0x0) {
+				return CHIP8_JIT_INTERPRET;
+			}
+			return canSkip ? CHIP8_JIT_SKIP : CHIP8_JIT_HELPER_EXIT;
+		case 0x6:
+		case 0x7:
+		case 0xa:
+			return CHIP8_JIT_NATIVE;
+		case 0x8:
+			if (n <= 0x7 || n == 0xe) {
+				return CHIP8_JIT_NATIVE;
+			}
+			return CHIP8_JIT_INTERPRET;
+		case 0xb:
+			return CHIP8_JIT_HELPER_EXIT;
+		case 0xc:
+			return CHIP8_JIT_HELPER;
+		case 0xd:
+			return CHIP8_JIT_INTERPRET;
+		case 0xe:
+			if (lsbyte == 0x9e || lsbyte == 0xa1) {
+				return CHIP8_JIT_HELPER_EXIT;
+			}
+			return CHIP8_JIT_INTERPRET;
+		case 0xf:
+			switch(lsbyte) {
+				case 0x07:
+				case 0x15:
+				case 0x18:
+					return CHIP8_JIT_NATIVE;
+				case 0x1e:
+				case 0x29:
+				case 0x65:
+					return CHIP8_JIT_HELPER;
+				case 0x33:
+				case 0x55:
+					// Memory writes may invalidate the running block.
+					return CHIP8_JIT_HELPER_EXIT;
+				default:
+					return CHIP8_JIT_INTERPRET;
+			}
+	}
+
+	return CHIP8_JIT_INTERPRET;
+}
+
+uint8_t *CHIP8JitCompile(CHIP8Jit *jit, CHIP8 *chip8, uint16_t start) {
+	if (CHIP8_JIT_CODE_SIZE - jit->codeSize < CHIP8_JIT_MAX_BLOCK_SIZE) {
+		CHIP8JitFlush(jit);
+	}
+
+	// Discover the block
+	CHIP8JitKind kinds[CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS];
+	size_t count = 0;
+	uint16_t end = start;
+
+	while (count < CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS && end <= CHIP8_MEMORY_SIZE - 2) {
+		uint8_t msbyte = CHIP8ReadByte(chip8, end);
+		uint8_t lsbyte = CHIP8ReadByte(chip8, end + 1);
+
+		CHIP8JitKind kind = CHIP8JitClassify(end, msbyte, lsbyte);
+		if (kind == CHIP8_JIT_INTERPRET) {
+			break;
+		}
+
+		CHIP8Decode(msbyte, lsbyte, &jit->records[end]);
+		kinds[count] = kind;
+		++count;
+		end += 2;
+
+		if (kind != CHIP8_JIT_NATIVE && kind != CHIP8_JIT_HELPER) {
+			break;
+		}
+	}
+
+	if (count == 0) {
+		jit->blocks[start] = &CHIP8JitInterpretMarker;
+		return &CHIP8JitInterpretMarker;
+	}
+
+	// Translate
+	uint8_t *body = jit->code + jit->codeSize;
+
+	// cmp qword [r12 + budget], 0 ; jle budgetExit
+	CHIP8JitEmit8(jit, 0x49); CHIP8JitEmit8(jit, 0x83); CHIP8JitEmit8(jit, 0xbc); CHIP8JitEmit8(jit, 0x24);
+	CHIP8JitEmit32(jit, CHIP8_JIT_BUDGET);
+	CHIP8JitEmit8(jit, 0x00);
+	uint8_t *budgetSite = CHIP8JitEmitBranch(jit, CHIP8_JIT_JLE, NULL);
+
+	// sub qword [r12 + budget], count
+	CHIP8JitEmit8(jit, 0x49); CHIP8JitEmit8(jit, 0x81); CHIP8JitEmit8(jit, 0xac); CHIP8JitEmit8(jit, 0x24);
+	CHIP8JitEmit32(jit, CHIP8_JIT_BUDGET);
+	CHIP8JitEmit32(jit, (uint32_t) count);
+
+	// add qword [rbx + cycles], count
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x81);
+	CHIP8JitEmitModRM(jit, 0, CHIP8_JIT_CYCLES);
+	CHIP8JitEmit32(jit, (uint32_t) count);
+
+	uint8_t *errorSites[CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS];
+	size_t errorIndices[CHIP8_JIT_MAX_BLOCK_INSTRUCTIONS];
+	size_t numErrorSites = 0;
+
+	uint16_t address = start;
+	for (size_t k = 0; k < count; ++k, address += 2) {
+		const CHIP8Instruction *instruction = &jit->records[address];
+		uint8_t msbyte = CHIP8ReadByte(chip8, address);
+
+		switch (kinds[k]) {
+			case CHIP8_JIT_NATIVE:
+				CHIP8JitEmitNative(jit, msbyte, instruction);
+				break;
+			case CHIP8_JIT_SKIP:
+				CHIP8JitEmitSkip(jit, msbyte, instruction, address + 2);
+				break;
+			case CHIP8_JIT_JUMP:
+				CHIP8JitEmitExit(jit, instruction->nnn);
+				break;
+			case CHIP8_JIT_HELPER:
+			case CHIP8_JIT_HELPER_EXIT:
+			case CHIP8_JIT_CALL:
+				errorSites[numErrorSites] = CHIP8JitEmitCall(jit, instruction, address + 2);
+				errorIndices[numErrorSites] = k;
+				++numErrorSites;
+
+				if (kinds[k] == CHIP8_JIT_HELPER_EXIT) {
+					CHIP8JitEmitJump(jit, jit->returnSuccess);
+				} else if (kinds[k] == CHIP8_JIT_CALL) {
+					CHIP8JitEmitExit(jit, instruction->nnn);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (kinds[count - 1] == CHIP8_JIT_NATIVE || kinds[count - 1] == CHIP8_JIT_HELPER) {
+		// Cut short by the block size or by an instruction the interpreter has to run.
+		CHIP8JitEmitExit(jit, end);
+	}
+
+	// Out of budget: resume at this block next time.
+	CHIP8JitPatch(budgetSite, jit->code + jit->codeSize);
+	CHIP8JitEmitSetPC(jit, start);
+	CHIP8JitEmitJump(jit, jit->returnSuccess);
+
+	// A failing handler returns its result in eax; uncount the instructions that did not run.
+	for (size_t e = 0; e < numErrorSites; ++e) {
+		CHIP8JitPatch(errorSites[e], jit->code + jit->codeSize);
+
+		uint32_t skipped = (uint32_t) (count - errorIndices[e] - 1);
+		if (skipped > 0) {
+			// sub qword [rbx + cycles], skipped
+			CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x81);
+			CHIP8JitEmitModRM(jit, 5, CHIP8_JIT_CYCLES);
+			CHIP8JitEmit32(jit, skipped);
+		}
+
+		CHIP8JitEmitJump(jit, jit->epilogue);
+	}
+
+	for (uint16_t i = start; i < end; ++i) {
+		jit->covered[i] = true;
+	}
+
+	jit->blocks[start] = body;
+
+	// Chain the exits that were waiting for this block.
+	for (size_t l = 0; l < jit->numLinks;) {
+		if (jit->links[l].target == start) {
+			CHIP8JitPatch(jit->links[l].site, body);
+			jit->links[l] = jit->links[jit->numLinks - 1];
+			--jit->numLinks;
+		} else {
+			++l;
+		}
+	}
+
+	return body;
+}
+
+void CHIP8JitEmitNative(CHIP8Jit *jit, uint8_t msbyte, const CHIP8Instruction *instruction) {
+	uint8_t x = instruction->x;
+	uint8_t y = instruction->y;
+
+	switch(msbyte >> 4) {
+		case 0x6:
+			// mov byte [vx], kk
+			CHIP8JitEmit8(jit, 0xc6);
+			CHIP8JitEmitModRM(jit, 0, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, instruction->kk);
+			return;
+		case 0x7:
+			// add byte [vx], kk
+			CHIP8JitEmit8(jit, 0x80);
+			CHIP8JitEmitModRM(jit, 0, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, instruction->kk);
+			return;
+		case 0xa:
+			// mov word [i], nnn
+			CHIP8JitEmit8(jit, 0x66); CHIP8JitEmit8(jit, 0xc7);
+			CHIP8JitEmitModRM(jit, 0, CHIP8_JIT_I);
+			CHIP8JitEmit16(jit, instruction->nnn);
+			return;
+		case 0xf:
+			switch(instruction->kk) {
+				case 0x07:
+					CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_DT);
+					CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+					return;
+				case 0x15:
+					CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+					CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_DT);
+					return;
+				case 0x18:
+					CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+					CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_ST);
+					return;
+			}
+			return;
+	}
+
+	// 8xy*: loads and stores follow the interpreter handlers, so x or y == 0xf behaves the same.
+	switch(instruction->n) {
+		case 0x0:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(y));
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+		case 0x1:
+		case 0x2:
+		case 0x3:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			// or/and/xor al, cl
+			CHIP8JitEmit8(jit, instruction->n == 0x1 ? 0x08 : instruction->n == 0x2 ? 0x20 : 0x30);
+			CHIP8JitEmit8(jit, 0xc8);
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+		case 0x4:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			CHIP8JitEmit8(jit, 0x01); CHIP8JitEmit8(jit, 0xc8);						// add eax, ecx
+			CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xc2);						// mov edx, eax
+			CHIP8JitEmit8(jit, 0xc1); CHIP8JitEmit8(jit, 0xea); CHIP8JitEmit8(jit, 0x08);	// shr edx, 8
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EDX, CHIP8_JIT_V(0xf));
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+		case 0x5:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			CHIP8JitEmit8(jit, 0x38); CHIP8JitEmit8(jit, 0xc8);						// cmp al, cl
+			CHIP8JitEmit8(jit, 0x0f); CHIP8JitEmit8(jit, 0x97); CHIP8JitEmit8(jit, 0xc2);	// seta dl
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EDX, CHIP8_JIT_V(0xf));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			CHIP8JitEmit8(jit, 0x28); CHIP8JitEmit8(jit, 0xc8);						// sub al, cl
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+		case 0x6:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, 0x24); CHIP8JitEmit8(jit, 0x01);						// and al, 1
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(0xf));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, 0xd0); CHIP8JitEmit8(jit, 0xe8);						// shr al, 1
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+		case 0x7:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			CHIP8JitEmit8(jit, 0x38); CHIP8JitEmit8(jit, 0xc1);						// cmp cl, al
+			CHIP8JitEmit8(jit, 0x0f); CHIP8JitEmit8(jit, 0x97); CHIP8JitEmit8(jit, 0xc2);	// seta dl
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EDX, CHIP8_JIT_V(0xf));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(y));
+			CHIP8JitEmit8(jit, 0x28); CHIP8JitEmit8(jit, 0xc1);						// sub cl, al
+			CHIP8JitEmitStore(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(x));
+			break;
+		case 0xe:
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, 0xc0); CHIP8JitEmit8(jit, 0xe8); CHIP8JitEmit8(jit, 0x07);	// shr al, 7
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(0xf));
+			CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			CHIP8JitEmit8(jit, 0x00); CHIP8JitEmit8(jit, 0xc0);						// add al, al
+			CHIP8JitEmitStore(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(x));
+			break;
+	}
+}
+
+void CHIP8JitEmitSkip(CHIP8Jit *jit, uint8_t msbyte, const CHIP8Instruction *instruction, uint16_t pc) {
+	uint8_t opcode = msbyte >> 4;
+
+	if (opcode == 0x3 || opcode == 0x4) {
+		// cmp byte [vx], kk
+		CHIP8JitEmit8(jit, 0x80);
+		CHIP8JitEmitModRM(jit, 7, CHIP8_JIT_V(instruction->x));
+		CHIP8JitEmit8(jit, instruction->kk);
+	} else {
+		CHIP8JitEmitLoad(jit, CHIP8_JIT_EAX, CHIP8_JIT_V(instruction->x));
+		CHIP8JitEmitLoad(jit, CHIP8_JIT_ECX, CHIP8_JIT_V(instruction->y));
+		CHIP8JitEmit8(jit, 0x38); CHIP8JitEmit8(jit, 0xc8);	// cmp al, cl
+	}
+
+	uint8_t condition = (opcode == 0x3 || opcode == 0x5) ? CHIP8_JIT_JE : CHIP8_JIT_JNE;
+	uint8_t *skipSite = CHIP8JitEmitBranch(jit, condition, NULL);
+
+	CHIP8JitEmitExit(jit, pc);
+
+	CHIP8JitPatch(skipSite, jit->code + jit->codeSize);
+	CHIP8JitEmitExit(jit, pc + 2);
+}
+
+uint8_t *CHIP8JitEmitCall(CHIP8Jit *jit, const CHIP8Instruction *instruction, uint16_t pc) {
+	// Handlers expect pc to point past the instruction, as in CHIP8Interpret.
+	CHIP8JitEmitSetPC(jit, pc);
+
+	#ifdef _WIN32
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xd9);	// mov rcx, rbx
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0xba);							// mov rdx, instruction
+	#else
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0x89); CHIP8JitEmit8(jit, 0xdf);	// mov rdi, rbx
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0xbe);							// mov rsi, instruction
+	#endif
+	CHIP8JitEmit64(jit, (uint64_t) (uintptr_t) instruction);
+
+	CHIP8JitEmit8(jit, 0x48); CHIP8JitEmit8(jit, 0xb8);							// mov rax, handler
+	CHIP8JitEmit64(jit, (uint64_t) (uintptr_t) instruction->handler);
+	CHIP8JitEmit8(jit, 0xff); CHIP8JitEmit8(jit, 0xd0);							// call rax
+
+	CHIP8JitEmit8(jit, 0x85); CHIP8JitEmit8(jit, 0xc0);							// test eax, eax
+	return CHIP8JitEmitBranch(jit, CHIP8_JIT_JNE, NULL);
+}
+
+void CHIP8JitEmitExit(CHIP8Jit *jit, uint16_t target) {
+	CHIP8JitEmitSetPC(jit, target);
+
+	uint8_t *body = target < CHIP8_MEMORY_SIZE ? jit->blocks[target] : NULL;
+	if (body != NULL && body != &CHIP8JitInterpretMarker) {
+		CHIP8JitEmitJump(jit, body);
+		return;
+	}
+
+	uint8_t *site = CHIP8JitEmitJump(jit, jit->returnSuccess);
+	if (body == NULL && target < CHIP8_MEMORY_SIZE && jit->numLinks < CHIP8_JIT_MAX_LINKS) {
+		jit->links[jit->numLinks].site = site;
+		jit->links[jit->numLinks].target = target;
+		++jit->numLinks;
+	}
+}
+
+void CHIP8JitEmitLoad(CHIP8Jit *jit, uint8_t reg, int32_t displacement) {
+	// movzx reg, byte [rbx + displacement]
+	CHIP8JitEmit8(jit, 0x0f); CHIP8JitEmit8(jit, 0xb6);
+	CHIP8JitEmitModRM(jit, reg, displacement);
+}
+
+void CHIP8JitEmitStore(CHIP8Jit *jit, uint8_t reg, int32_t displacement) {
+	// mov byte [rbx + displacement], reg
+	CHIP8JitEmit8(jit, 0x88);
+	CHIP8JitEmitModRM(jit, reg, displacement);
+}
+
+void CHIP8JitEmitSetPC(CHIP8Jit *jit, uint16_t pc) {
+	// mov word [rbx + pc], pc
+	CHIP8JitEmit8(jit, 0x66); CHIP8JitEmit8(jit, 0xc7);
+	CHIP8JitEmitModRM(jit, 0, CHIP8_JIT_PC);
+	CHIP8JitEmit16(jit, pc);
+}
+
+uint8_t *CHIP8JitEmitJump(CHIP8Jit *jit, uint8_t *target) {
+	CHIP8JitEmit8(jit, 0xe9);
+
+	uint8_t *site = jit->code + jit->codeSize;
+	CHIP8JitEmit32(jit, 0);
+	if (target != NULL) {
+		CHIP8JitPatch(site, target);
+	}
+
+	return site;
+}
+
+uint8_t *CHIP8JitEmitBranch(CHIP8Jit *jit, uint8_t condition, uint8_t *target) {
+	CHIP8JitEmit8(jit, 0x0f);
+	CHIP8JitEmit8(jit, condition);
+
+	uint8_t *site = jit->code + jit->codeSize;
+	CHIP8JitEmit32(jit, 0);
+	if (target != NULL) {
+		CHIP8JitPatch(site, target);
+	}
+
+	return site;
+}
+
+void CHIP8JitPatch(uint8_t *site, uint8_t *target) {
+	int32_t displacement = (int32_t) (target - (site + 4));
+	memcpy(site, &displacement, sizeof(displacement));
+}
+
+void CHIP8JitEmitModRM(CHIP8Jit *jit, uint8_t reg, int32_t displacement) {
+	// [rbx + disp32]
+	CHIP8JitEmit8(jit, 0x80 | (reg << 3) | 0x3);
+	CHIP8JitEmit32(jit, (uint32_t) displacement);
+}
+
+void CHIP8JitEmit8(CHIP8Jit *jit, uint8_t byte) {
+	jit->code[jit->codeSize] = byte;
+	++jit->codeSize;
+}
+
+void CHIP8JitEmit16(CHIP8Jit *jit, uint16_t value) {
+	CHIP8JitEmit8(jit, value & 0xff);
+	CHIP8JitEmit8(jit, value >> 8);
+}
+
+void CHIP8JitEmit32(CHIP8Jit *jit, uint32_t value) {
+	CHIP8JitEmit16(jit, value & 0xffff);
+	CHIP8JitEmit16(jit, value >> 16);
+}
+
+void CHIP8JitEmit64(CHIP8Jit *jit, uint64_t value) {
+	CHIP8JitEmit32(jit, value & 0xffffffff);
+	CHIP8JitEmit32(jit, value >> 32);
+}
+
+#else
+
+CHIP8Jit *CHIP8JitInit() {
+	return NULL;
+}
+
+void CHIP8JitDestroy(CHIP8Jit *jit) {
+}
+
+CHIP8Result CHIP8JitExecute(CHIP8Jit *jit, CHIP8 *chip8, int64_t budget) {
+	return CHIP8Interpret(chip8);
+}
+
+void CHIP8JitInvalidate(CHIP8Jit *jit, size_t address, size_t size) {
+}
+
+#endif
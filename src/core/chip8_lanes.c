@@ -0,0 +1,733 @@
+#include <core/chip8_lanes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What the vectors below need; malloc need not align that far everywhere.
+#define CHIP8_LANES_ALIGNMENT CHIP8_LANES_MAX
+// remaining is a byte per lane, so longer frames run in slices.
+#define CHIP8_LANES_MAX_SLICE UINT8_MAX
+// Registers as a set of bits: one per V register, then I and the timers. pc
+// always goes between the lanes and the machine.
+#define CHIP8_LANES_REGISTER_I (1u << CHIP8_NUM_V_REGISTERS)
+#define CHIP8_LANES_REGISTER_TIMERS (CHIP8_LANES_REGISTER_I << 1)
+#define CHIP8_LANES_ALL_REGISTERS ((CHIP8_LANES_REGISTER_TIMERS << 1) - 1)
+
+// GCC vector extensions, one SSE2 register each. Every lane register is a byte
+// vector, the 12-bit pc and I split into a low and a high byte vector, since
+// wider vectors are taken apart element by element where SSE2 has no instruction.
+typedef uint8_t CHIP8LaneBytes __attribute__((vector_size(CHIP8_LANES_MAX)));
+typedef int8_t CHIP8LaneMask __attribute__((vector_size(CHIP8_LANES_MAX)));
+
+struct CHIP8Lanes {
+	// What malloc returned, before aligning.
+	void *block;
+
+	CHIP8 *machines[CHIP8_LANES_MAX];
+	size_t numLanes;
+	CHIP8Result results[CHIP8_LANES_MAX];
+
+	// The registers, lane l of each vector for machines[l]. Between runs and
+	// for lanes that failed, the machines hold them instead.
+	CHIP8LaneBytes v[CHIP8_NUM_V_REGISTERS];
+	CHIP8LaneBytes iLow;
+	CHIP8LaneBytes iHigh;
+	CHIP8LaneBytes pcLow;
+	CHIP8LaneBytes pcHigh;
+	CHIP8LaneBytes dt;
+	CHIP8LaneBytes st;
+	uint64_t cycles[CHIP8_LANES_MAX];
+
+	// Instructions each lane has left in the current slice, 0 once it is through
+	// or has failed, out of the sliced it started with.
+	CHIP8LaneBytes remaining;
+	uint8_t sliced[CHIP8_LANES_MAX];
+	// The lanes at the pc of the current step.
+	CHIP8LaneMask group;
+
+	// Decoded once for every lane. Bytes that are mixed may differ between the
+	// machines, so an instruction touching one is run by each lane on its own.
+	CHIP8Instruction decoded[CHIP8_MEMORY_SIZE];
+	bool mixed[CHIP8_MEMORY_SIZE];
+
+	uint64_t instructions;
+	uint64_t scalarInstructions;
+	uint64_t steps;
+};
+
+static void CHIP8LanesRunSlice(CHIP8Lanes *lanes);
+static size_t CHIP8LanesPickLeader(const CHIP8Lanes *lanes);
+static void CHIP8LanesStep(CHIP8Lanes *lanes, uint16_t pc);
+static const CHIP8Instruction *CHIP8LanesFetch(CHIP8Lanes *lanes, uint16_t pc);
+static bool CHIP8LanesExecute(CHIP8Lanes *lanes, const CHIP8Instruction *instruction, uint16_t pc);
+static bool CHIP8LanesExecuteEach(CHIP8Lanes *lanes, const CHIP8Instruction *instruction, uint16_t pc);
+static bool CHIP8LanesExecuteLoad(CHIP8Lanes *lanes, const CHIP8Instruction *instruction);
+static void CHIP8LanesInterpret(CHIP8Lanes *lanes, size_t lane, const CHIP8Instruction *instruction, size_t *writtenStart, size_t *writtenEnd);
+static void CHIP8LanesRegisters(const CHIP8Instruction *instruction, uint32_t *reads, uint32_t *writes);
+static bool CHIP8LanesWritesSame(const CHIP8Lanes *lanes, const CHIP8Instruction *instruction);
+static void CHIP8LanesMix(CHIP8Lanes *lanes, size_t start, size_t end);
+static void CHIP8LanesForget(CHIP8Lanes *lanes, size_t start, size_t end);
+static void CHIP8LanesLoad(CHIP8Lanes *lanes, size_t lane, uint32_t registers);
+static void CHIP8LanesStore(const CHIP8Lanes *lanes, size_t lane, uint32_t registers);
+static uint16_t CHIP8LanesPC(const CHIP8Lanes *lanes, size_t lane);
+static bool CHIP8LanesAny(CHIP8LaneMask mask);
+static CHIP8LaneBytes CHIP8LanesBlend(CHIP8LaneMask mask, CHIP8LaneBytes a, CHIP8LaneBytes b);
+
+CHIP8Lanes *CHIP8LanesInit(CHIP8 **machines, size_t numLanes) {
+	if (numLanes == 0 || numLanes > CHIP8_LANES_MAX) {
+		return NULL;
+	}
+
+	// The lanes keep pc, i and what they decode for 4 KB of memory.
+	for (size_t l = 0; l < numLanes; ++l) {
+		if (machines[l]->memorySize != CHIP8_MEMORY_SIZE) {
+			return NULL;
+		}
+	}
+
+	void *block = malloc(sizeof(CHIP8Lanes) + CHIP8_LANES_ALIGNMENT - 1);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	CHIP8Lanes *lanes = (CHIP8Lanes *) (((uintptr_t) block + CHIP8_LANES_ALIGNMENT - 1) & ~(uintptr_t) (CHIP8_LANES_ALIGNMENT - 1));
+	memset(lanes, 0, sizeof(CHIP8Lanes));
+
+	lanes->block = block;
+	lanes->numLanes = numLanes;
+
+	for (size_t l = 0; l < numLanes; ++l) {
+		lanes->machines[l] = machines[l];
+		lanes->results[l] = CHIP8_SUCCESS;
+	}
+
+	CHIP8LanesMix(lanes, 0, CHIP8_MEMORY_SIZE);
+
+	return lanes;
+}
+
+void CHIP8LanesDestroy(CHIP8Lanes *lanes) {
+	free(lanes->block);
+}
+
+void CHIP8LanesRun(CHIP8Lanes *lanes, uint64_t frameStart, uint64_t frameCycles, uint64_t endCycle) {
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->results[l] == CHIP8_SUCCESS) {
+			CHIP8LanesLoad(lanes, l, CHIP8_LANES_ALL_REGISTERS);
+			lanes->cycles[l] = lanes->machines[l]->cycles;
+		}
+	}
+
+	// The frames of a CHIP8SchedulerRunFrame loop: every lane still short of
+	// endCycle runs to the end of the frame, or to endCycle, then ticks.
+	for (uint64_t frameEnd = frameStart + frameCycles; ; frameEnd += frameCycles) {
+		uint64_t target = frameEnd < endCycle ? frameEnd : endCycle;
+
+		CHIP8LaneMask running = { 0 };
+		for (size_t l = 0; l < lanes->numLanes; ++l) {
+			running[l] = lanes->results[l] == CHIP8_SUCCESS && lanes->cycles[l] < endCycle ? -1 : 0;
+		}
+
+		if (!CHIP8LanesAny(running)) {
+			break;
+		}
+
+		for (bool more = true; more; ) {
+			more = false;
+
+			for (size_t l = 0; l < lanes->numLanes; ++l) {
+				uint64_t left = running[l] != 0 && lanes->cycles[l] < target ? target - lanes->cycles[l] : 0;
+
+				lanes->sliced[l] = (uint8_t) (left < CHIP8_LANES_MAX_SLICE ? left : CHIP8_LANES_MAX_SLICE);
+				lanes->remaining[l] = lanes->sliced[l];
+				lanes->instructions += lanes->sliced[l];
+				more |= left > CHIP8_LANES_MAX_SLICE;
+			}
+
+			CHIP8LanesRunSlice(lanes);
+
+			for (size_t l = 0; l < lanes->numLanes; ++l) {
+				if (lanes->results[l] == CHIP8_SUCCESS) {
+					lanes->cycles[l] += lanes->sliced[l];
+				} else {
+					running[l] = 0;
+				}
+			}
+		}
+
+		// Adding the mask takes one off the timers that tick.
+		lanes->dt += (CHIP8LaneBytes) (running & (lanes->dt > 0));
+		lanes->st += (CHIP8LaneBytes) (running & (lanes->st > 0));
+	}
+
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->results[l] == CHIP8_SUCCESS) {
+			CHIP8LanesStore(lanes, l, CHIP8_LANES_ALL_REGISTERS);
+			lanes->machines[l]->cycles = lanes->cycles[l];
+		}
+	}
+}
+
+CHIP8Result CHIP8LanesResult(const CHIP8Lanes *lanes, size_t lane) {
+	return lanes->results[lane];
+}
+
+void CHIP8LanesGetMetrics(const CHIP8Lanes *lanes, CHIP8LanesMetrics *metrics) {
+	metrics->instructions = lanes->instructions;
+	metrics->vectorInstructions = lanes->instructions - lanes->scalarInstructions;
+	metrics->steps = lanes->steps;
+	metrics->utilization = lanes->steps > 0 ? (double) lanes->instructions / (lanes->steps * lanes->numLanes) : 0.0;
+}
+
+void CHIP8LanesRunSlice(CHIP8Lanes *lanes) {
+	size_t leader = CHIP8LanesPickLeader(lanes);
+
+	while (leader < lanes->numLanes) {
+		uint16_t pc = CHIP8LanesPC(lanes, leader);
+		CHIP8LaneMask active = lanes->remaining != 0;
+		lanes->group = active & (lanes->pcLow == (uint8_t) pc) & (lanes->pcHigh == (uint8_t) (pc >> 8));
+
+		bool agreed = !CHIP8LanesAny(lanes->group ^ active);
+
+		CHIP8LanesStep(lanes, pc);
+
+		// Lanes that all agreed most likely still do; the leader only changes once they split.
+		if (!agreed || lanes->remaining[leader] == 0) {
+			leader = CHIP8LanesPickLeader(lanes);
+		}
+	}
+}
+
+// The lane furthest behind, and of those the one lowest in memory: lanes that
+// skipped ahead then wait where the others are bound to join them.
+size_t CHIP8LanesPickLeader(const CHIP8Lanes *lanes) {
+	size_t leader = lanes->numLanes;
+
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->remaining[l] == 0) {
+			continue;
+		}
+
+		if (
+			leader == lanes->numLanes ||
+			lanes->remaining[l] > lanes->remaining[leader] ||
+			(lanes->remaining[l] == lanes->remaining[leader] && CHIP8LanesPC(lanes, l) < CHIP8LanesPC(lanes, leader))
+		) {
+			leader = l;
+		}
+	}
+
+	return leader;
+}
+
+void CHIP8LanesStep(CHIP8Lanes *lanes, uint16_t pc) {
+	++lanes->steps;
+
+	// Counted up front, so that a lane that fails drops out by zeroing what it has left.
+	lanes->remaining += (CHIP8LaneBytes) lanes->group;
+
+	const CHIP8Instruction *instruction = CHIP8LanesFetch(lanes, pc);
+	if (instruction != NULL && CHIP8LanesExecute(lanes, instruction, pc)) {
+		return;
+	}
+
+	size_t writtenStart = CHIP8_MEMORY_SIZE;
+	size_t writtenEnd = 0;
+	bool same = CHIP8LanesWritesSame(lanes, instruction);
+
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->group[l] != 0) {
+			CHIP8LanesInterpret(lanes, l, instruction, &writtenStart, &writtenEnd);
+			same &= lanes->results[l] == CHIP8_SUCCESS;
+		}
+	}
+
+	if (writtenStart < writtenEnd && same) {
+		CHIP8LanesForget(lanes, writtenStart, writtenEnd);
+	} else if (writtenStart < writtenEnd) {
+		CHIP8LanesMix(lanes, writtenStart, writtenEnd);
+	}
+}
+
+// The instruction at pc for every lane, or NULL when the lanes may disagree on it.
+const CHIP8Instruction *CHIP8LanesFetch(CHIP8Lanes *lanes, uint16_t pc) {
+	if (pc > CHIP8_MEMORY_SIZE - 2 || lanes->mixed[pc] || lanes->mixed[pc + 1]) {
+		return NULL;
+	}
+
+	CHIP8Instruction *instruction = &lanes->decoded[pc];
+	if (instruction->handler == NULL) {
+		CHIP8Decode(CHIP8ReadByte(lanes->machines[0], pc), CHIP8ReadByte(lanes->machines[0], pc + 1), instruction);
+	}
+
+	return instruction;
+}
+
+// Runs instruction on the lanes in the group if it only needs their registers,
+// and memory none of them sees differently, and none of them would fail, as
+// CHIP8Interpret would. Returns false otherwise, without having changed anything.
+bool CHIP8LanesExecute(CHIP8Lanes *lanes, const CHIP8Instruction *instruction, uint16_t pc) {
+	CHIP8LaneMask m = lanes->group;
+	CHIP8LaneBytes *v = lanes->v;
+	uint8_t x = instruction->x;
+	uint8_t y = instruction->y;
+	uint8_t kk = instruction->kk;
+
+	// Lanes whose condition holds skip the next instruction.
+	CHIP8LaneMask skip = { 0 };
+	uint16_t next = (uint16_t) (pc + 2);
+
+	switch (instruction->op) {
+		case CHIP8_OP_00EE:
+		case CHIP8_OP_2NNN:
+		case CHIP8_OP_CXKK:
+			return CHIP8LanesExecuteEach(lanes, instruction, pc);
+		case CHIP8_OP_1NNN:
+			next = instruction->nnn;
+			break;
+		case CHIP8_OP_3XKK:
+			skip = v[x] == kk;
+			break;
+		case CHIP8_OP_4XKK:
+			skip = v[x] != kk;
+			break;
+		case CHIP8_OP_5XY0:
+			skip = v[x] == v[y];
+			break;
+		case CHIP8_OP_9XY0:
+			skip = v[x] != v[y];
+			break;
+		case CHIP8_OP_6XKK:
+			v[x] = CHIP8LanesBlend(m, (CHIP8LaneBytes) { 0 } + kk, v[x]);
+			break;
+		case CHIP8_OP_7XKK:
+			v[x] = CHIP8LanesBlend(m, v[x] + kk, v[x]);
+			break;
+		case CHIP8_OP_8XY0:
+			v[x] = CHIP8LanesBlend(m, v[y], v[x]);
+			break;
+		case CHIP8_OP_8XY1:
+			v[x] = CHIP8LanesBlend(m, v[x] | v[y], v[x]);
+			break;
+		case CHIP8_OP_8XY2:
+			v[x] = CHIP8LanesBlend(m, v[x] & v[y], v[x]);
+			break;
+		case CHIP8_OP_8XY3:
+			v[x] = CHIP8LanesBlend(m, v[x] ^ v[y], v[x]);
+			break;
+		// The flag goes into VF before the result goes into Vx, as in CHIP8_8xy*, which matters when x or y is F.
+		case CHIP8_OP_8XY4: {
+			CHIP8LaneBytes sum = v[x] + v[y];
+			CHIP8LaneBytes carry = (CHIP8LaneBytes) (sum < v[x]) & 1;
+
+			v[0xF] = CHIP8LanesBlend(m, carry, v[0xF]);
+			v[x] = CHIP8LanesBlend(m, sum, v[x]);
+			break;
+		}
+		case CHIP8_OP_8XY5:
+			v[0xF] = CHIP8LanesBlend(m, (CHIP8LaneBytes) (v[x] > v[y]) & 1, v[0xF]);
+			v[x] = CHIP8LanesBlend(m, v[x] - v[y], v[x]);
+			break;
+		case CHIP8_OP_8XY6:
+			v[0xF] = CHIP8LanesBlend(m, v[x] & 1, v[0xF]);
+			v[x] = CHIP8LanesBlend(m, v[x] >> 1, v[x]);
+			break;
+		case CHIP8_OP_8XY7:
+			v[0xF] = CHIP8LanesBlend(m, (CHIP8LaneBytes) (v[y] > v[x]) & 1, v[0xF]);
+			v[x] = CHIP8LanesBlend(m, v[y] - v[x], v[x]);
+			break;
+		case CHIP8_OP_8XYE:
+			v[0xF] = CHIP8LanesBlend(m, v[x] >> 7, v[0xF]);
+			v[x] = CHIP8LanesBlend(m, v[x] << 1, v[x]);
+			break;
+		case CHIP8_OP_ANNN:
+			lanes->iLow = CHIP8LanesBlend(m, (CHIP8LaneBytes) { 0 } + (uint8_t) instruction->nnn, lanes->iLow);
+			lanes->iHigh = CHIP8LanesBlend(m, (CHIP8LaneBytes) { 0 } + (uint8_t) (instruction->nnn >> 8), lanes->iHigh);
+			break;
+		case CHIP8_OP_FX07:
+			v[x] = CHIP8LanesBlend(m, lanes->dt, v[x]);
+			break;
+		case CHIP8_OP_FX15:
+			lanes->dt = CHIP8LanesBlend(m, v[x], lanes->dt);
+			break;
+		case CHIP8_OP_FX18:
+			lanes->st = CHIP8LanesBlend(m, v[x], lanes->st);
+			break;
+		case CHIP8_OP_FX65:
+			if (!CHIP8LanesExecuteLoad(lanes, instruction)) {
+				return false;
+			}
+			break;
+		case CHIP8_OP_FX1E: {
+			CHIP8LaneBytes low = lanes->iLow + v[x];
+			CHIP8LaneBytes high = lanes->iHigh - (CHIP8LaneBytes) (low < lanes->iLow);
+
+			// I + Vx past the end of memory faults.
+			if (CHIP8LanesAny(m & (high >= CHIP8_MEMORY_SIZE >> 8))) {
+				return false;
+			}
+
+			lanes->iLow = CHIP8LanesBlend(m, low, lanes->iLow);
+			lanes->iHigh = CHIP8LanesBlend(m, high, lanes->iHigh);
+			break;
+		}
+		default:
+			return false;
+	}
+
+	skip &= m;
+
+	// A skip past the end of memory faults, and only CHIP8Interpret reports faults.
+	if (next > CHIP8_MEMORY_SIZE - 3 && CHIP8LanesAny(skip)) {
+		return false;
+	}
+
+	// next, or next + 2 in the lanes that skip, carried into the high byte.
+	CHIP8LaneBytes low = (CHIP8LaneBytes) { 0 } + (uint8_t) next + ((CHIP8LaneBytes) skip & 2);
+	CHIP8LaneBytes high = (CHIP8LaneBytes) { 0 } + (uint8_t) (next >> 8) - (CHIP8LaneBytes) (low < (uint8_t) next);
+
+	lanes->pcLow = CHIP8LanesBlend(m, low, lanes->pcLow);
+	lanes->pcHigh = CHIP8LanesBlend(m, high, lanes->pcHigh);
+
+	return true;
+}
+
+// Calls and returns, which only need pc from the lanes and the stack from the
+// machine, and cxkk, which keeps its generator there: instruction's handler runs
+// on each machine without loading and storing all of its registers.
+bool CHIP8LanesExecuteEach(CHIP8Lanes *lanes, const CHIP8Instruction *instruction, uint16_t pc) {
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		uint8_t sp = lanes->machines[l]->sp;
+
+		if (lanes->group[l] != 0 && ((instruction->op == CHIP8_OP_00EE && sp == 0) || (instruction->op == CHIP8_OP_2NNN && sp == CHIP8_STACK_SIZE))) {
+			return false;
+		}
+	}
+
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->group[l] == 0) {
+			continue;
+		}
+
+		CHIP8 *chip8 = lanes->machines[l];
+
+		chip8->pc = (uint16_t) (pc + 2);
+		instruction->handler(chip8, instruction);
+
+		lanes->pcLow[l] = (uint8_t) chip8->pc;
+		lanes->pcHigh[l] = (uint8_t) (chip8->pc >> 8);
+		if (instruction->op == CHIP8_OP_CXKK) {
+			lanes->v[instruction->x][l] = chip8->v[instruction->x];
+		}
+	}
+
+	return true;
+}
+
+// fx65 from bytes that are not mixed, when the group agrees on I: every lane
+// would load the same bytes, so they are read once and spread over the lanes.
+bool CHIP8LanesExecuteLoad(CHIP8Lanes *lanes, const CHIP8Instruction *instruction) {
+	CHIP8LaneMask m = lanes->group;
+	size_t first = 0;
+	while (m[first] == 0) {
+		++first;
+	}
+
+	if (CHIP8LanesAny(m & ((lanes->iLow != lanes->iLow[first]) | (lanes->iHigh != lanes->iHigh[first])))) {
+		return false;
+	}
+
+	// Past the end of memory faults.
+	size_t i = (size_t) (lanes->iLow[first] | lanes->iHigh[first] << 8);
+	if (i > CHIP8_MEMORY_SIZE - 1 - (size_t) instruction->x) {
+		return false;
+	}
+
+	for (size_t a = i; a <= i + instruction->x; ++a) {
+		if (lanes->mixed[a]) {
+			return false;
+		}
+	}
+
+	uint8_t bytes[CHIP8_NUM_V_REGISTERS];
+	CHIP8ReadMemory(lanes->machines[first], i, bytes, instruction->x + 1);
+
+	for (size_t x = 0; x <= instruction->x; ++x) {
+		lanes->v[x] = CHIP8LanesBlend(m, (CHIP8LaneBytes) { 0 } + bytes[x], lanes->v[x]);
+	}
+
+	return true;
+}
+
+// Runs the instruction at the lane's pc on its machine, with only the registers
+// it uses going between them; instruction is NULL if the lanes may disagree on
+// it. What it writes to memory widens [writtenStart, writtenEnd).
+void CHIP8LanesInterpret(CHIP8Lanes *lanes, size_t lane, const CHIP8Instruction *instruction, size_t *writtenStart, size_t *writtenEnd) {
+	CHIP8 *chip8 = lanes->machines[lane];
+
+	++lanes->scalarInstructions;
+
+	uint32_t reads;
+	uint32_t writes;
+	CHIP8LanesRegisters(instruction, &reads, &writes);
+
+	CHIP8LanesStore(lanes, lane, reads);
+	chip8->cycles = lanes->cycles[lane] + lanes->sliced[lane] - lanes->remaining[lane] - 1;
+
+	// fx33 and fx55 are the only writes, and both read I.
+	uint16_t i = chip8->i;
+	size_t written = 0;
+	if (instruction != NULL) {
+		if (instruction->op == CHIP8_OP_FX33) {
+			written = 3;
+		} else if (instruction->op == CHIP8_OP_FX55) {
+			written = instruction->x + 1u;
+		}
+	} else if (chip8->pc <= CHIP8_MEMORY_SIZE - 2) {
+		uint8_t msbyte = CHIP8ReadByte(chip8, chip8->pc);
+		uint8_t lsbyte = CHIP8ReadByte(chip8, chip8->pc + 1);
+
+		if ((msbyte & 0xF0) == 0xF0 && lsbyte == 0x33) {
+			written = 3;
+		} else if ((msbyte & 0xF0) == 0xF0 && lsbyte == 0x55) {
+			written = (msbyte & 0x0F) + 1;
+		}
+	}
+
+	// What the lanes decoded goes straight to its handler. Handlers fail before
+	// they change anything, and only CHIP8Interpret records the fault, so a
+	// failure runs the instruction again through it.
+	CHIP8Result result = CHIP8_ERROR_INSTRUCTION_NOT_FOUND;
+	if (instruction != NULL) {
+		chip8->pc += 2;
+		++chip8->cycles;
+
+		result = instruction->handler(chip8, instruction);
+		if (result != CHIP8_SUCCESS) {
+			chip8->pc -= 2;
+			--chip8->cycles;
+		}
+	}
+
+	if (result != CHIP8_SUCCESS) {
+		result = CHIP8Interpret(chip8);
+	}
+
+	if (result != CHIP8_SUCCESS) {
+		// The machine keeps the lane's state from here on, pc as the failure left it.
+		uint16_t pc = chip8->pc;
+		CHIP8LanesStore(lanes, lane, CHIP8_LANES_ALL_REGISTERS);
+		chip8->pc = pc;
+
+		lanes->results[lane] = result;
+		lanes->instructions -= lanes->remaining[lane];
+		lanes->remaining[lane] = 0;
+		return;
+	}
+
+	CHIP8LanesLoad(lanes, lane, writes);
+
+	if (written > 0 && i < CHIP8_MEMORY_SIZE) {
+		size_t end = i + written < CHIP8_MEMORY_SIZE ? i + written : CHIP8_MEMORY_SIZE;
+
+		*writtenStart = i < *writtenStart ? i : *writtenStart;
+		*writtenEnd = end > *writtenEnd ? end : *writtenEnd;
+	}
+}
+
+// The registers instruction reads and the ones it may write, as run by
+// CHIP8Interpret: only the instructions that often take it are listed, and the
+// rest, or a NULL instruction, take them all. A register written only in some
+// cases is read too, so that the machine holds it either way.
+void CHIP8LanesRegisters(const CHIP8Instruction *instruction, uint32_t *reads, uint32_t *writes) {
+	*reads = CHIP8_LANES_ALL_REGISTERS;
+	*writes = CHIP8_LANES_ALL_REGISTERS;
+
+	if (instruction == NULL) {
+		return;
+	}
+
+	uint32_t x = 1u << instruction->x;
+	uint32_t y = 1u << instruction->y;
+	// V0 to Vx.
+	uint32_t upToX = (x << 1) - 1;
+
+	switch (instruction->op) {
+		case CHIP8_OP_00E0:
+		case CHIP8_OP_00CN:
+		case CHIP8_OP_00FB:
+		case CHIP8_OP_00FC:
+		case CHIP8_OP_00FD:
+		case CHIP8_OP_00FE:
+		case CHIP8_OP_00FF:
+			*reads = 0;
+			*writes = 0;
+			break;
+		case CHIP8_OP_BNNN:
+			*reads = 1u << 0x0;
+			*writes = 0;
+			break;
+		case CHIP8_OP_DXYN:
+			*reads = x | y | CHIP8_LANES_REGISTER_I;
+			*writes = 1u << 0xF;
+			break;
+		case CHIP8_OP_EX9E:
+		case CHIP8_OP_EXA1:
+			*reads = x;
+			*writes = 0;
+			break;
+		case CHIP8_OP_FX0A:
+			*reads = x;
+			*writes = x;
+			break;
+		case CHIP8_OP_FX1E:
+			*reads = x | CHIP8_LANES_REGISTER_I;
+			*writes = CHIP8_LANES_REGISTER_I;
+			break;
+		case CHIP8_OP_FX29:
+		case CHIP8_OP_FX30:
+			*reads = x;
+			*writes = CHIP8_LANES_REGISTER_I;
+			break;
+		case CHIP8_OP_FX33:
+			*reads = x | CHIP8_LANES_REGISTER_I;
+			*writes = 0;
+			break;
+		case CHIP8_OP_FX55:
+			*reads = upToX | CHIP8_LANES_REGISTER_I;
+			*writes = 0;
+			break;
+		case CHIP8_OP_FX65:
+			*reads = CHIP8_LANES_REGISTER_I;
+			*writes = upToX;
+			break;
+		case CHIP8_OP_FX75:
+			*reads = upToX;
+			*writes = 0;
+			break;
+		case CHIP8_OP_FX85:
+			*reads = 0;
+			*writes = upToX;
+			break;
+		default:
+			break;
+	}
+}
+
+// Whether instruction, about to run on the lanes in the group, is fx33 or fx55
+// writing the same bytes to the same place on every machine, where they held
+// the same ones before: if all of them succeed, the bytes stay uniform.
+bool CHIP8LanesWritesSame(const CHIP8Lanes *lanes, const CHIP8Instruction *instruction) {
+	if (instruction == NULL || (instruction->op != CHIP8_OP_FX33 && instruction->op != CHIP8_OP_FX55)) {
+		return false;
+	}
+
+	for (size_t l = 0; l < lanes->numLanes; ++l) {
+		if (lanes->group[l] == 0) {
+			return false;
+		}
+	}
+
+	CHIP8LaneMask differs = (lanes->iLow != lanes->iLow[0]) | (lanes->iHigh != lanes->iHigh[0]);
+
+	size_t first = instruction->op == CHIP8_OP_FX33 ? instruction->x : 0;
+	for (size_t x = first; x <= instruction->x; ++x) {
+		differs |= lanes->v[x] != lanes->v[x][0];
+	}
+
+	if (CHIP8LanesAny(lanes->group & differs)) {
+		return false;
+	}
+
+	size_t i = (size_t) (lanes->iLow[0] | lanes->iHigh[0] << 8);
+	size_t size = instruction->op == CHIP8_OP_FX33 ? 3 : instruction->x + 1u;
+
+	for (size_t a = i; a < i + size && a < CHIP8_MEMORY_SIZE; ++a) {
+		if (lanes->mixed[a]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Marks the bytes in [start, end) mixed where the machines hold different ones.
+// The same write on every machine leaves its bytes uniform, so they can still
+// be decoded and loaded once for all lanes.
+void CHIP8LanesMix(CHIP8Lanes *lanes, size_t start, size_t end) {
+	uint8_t first[CHIP8_MEMORY_SIZE];
+	uint8_t other[CHIP8_MEMORY_SIZE];
+	CHIP8ReadMemory(lanes->machines[0], start, first, end - start);
+
+	memset(&lanes->mixed[start], 0, end - start);
+	for (size_t l = 1; l < lanes->numLanes; ++l) {
+		CHIP8ReadMemory(lanes->machines[l], start, other, end - start);
+
+		for (size_t a = start; a < end; ++a) {
+			lanes->mixed[a] |= first[a - start] != other[a - start];
+		}
+	}
+
+	CHIP8LanesForget(lanes, start, end);
+}
+
+// Drops what was decoded from the bytes in [start, end), which were written.
+void CHIP8LanesForget(CHIP8Lanes *lanes, size_t start, size_t end) {
+	// An instruction starting the byte before takes in the first.
+	for (size_t a = start > 0 ? start - 1 : 0; a < end; ++a) {
+		lanes->decoded[a].handler = NULL;
+	}
+}
+
+void CHIP8LanesLoad(CHIP8Lanes *lanes, size_t lane, uint32_t registers) {
+	const CHIP8 *chip8 = lanes->machines[lane];
+
+	for (uint32_t set = registers & (CHIP8_LANES_REGISTER_I - 1); set != 0; set &= set - 1) {
+		size_t x = (size_t) __builtin_ctz(set);
+		lanes->v[x][lane] = chip8->v[x];
+	}
+
+	if ((registers & CHIP8_LANES_REGISTER_I) != 0) {
+		lanes->iLow[lane] = (uint8_t) chip8->i;
+		lanes->iHigh[lane] = (uint8_t) (chip8->i >> 8);
+	}
+	lanes->pcLow[lane] = (uint8_t) chip8->pc;
+	lanes->pcHigh[lane] = (uint8_t) (chip8->pc >> 8);
+	if ((registers & CHIP8_LANES_REGISTER_TIMERS) != 0) {
+		lanes->dt[lane] = chip8->dt;
+		lanes->st[lane] = chip8->st;
+	}
+}
+
+void CHIP8LanesStore(const CHIP8Lanes *lanes, size_t lane, uint32_t registers) {
+	CHIP8 *chip8 = lanes->machines[lane];
+
+	for (uint32_t set = registers & (CHIP8_LANES_REGISTER_I - 1); set != 0; set &= set - 1) {
+		size_t x = (size_t) __builtin_ctz(set);
+		chip8->v[x] = lanes->v[x][lane];
+	}
+
+	if ((registers & CHIP8_LANES_REGISTER_I) != 0) {
+		chip8->i = (uint16_t) (lanes->iLow[lane] | lanes->iHigh[lane] << 8);
+	}
+	chip8->pc = CHIP8LanesPC(lanes, lane);
+	if ((registers & CHIP8_LANES_REGISTER_TIMERS) != 0) {
+		chip8->dt = lanes->dt[lane];
+		chip8->st = lanes->st[lane];
+	}
+}
+
+uint16_t CHIP8LanesPC(const CHIP8Lanes *lanes, size_t lane) {
+	return (uint16_t) (lanes->pcLow[lane] | lanes->pcHigh[lane] << 8);
+}
+
+bool CHIP8LanesAny(CHIP8LaneMask mask) {
+	uint64_t words[sizeof(mask) / sizeof(uint64_t)];
+	memcpy(words, &mask, sizeof(mask));
+
+	return (words[0] | words[1]) != 0;
+}
+
+CHIP8LaneBytes CHIP8LanesBlend(CHIP8LaneMask mask, CHIP8LaneBytes a, CHIP8LaneBytes b) {
+	return (a & (CHIP8LaneBytes) mask) | (b & ~(CHIP8LaneBytes) mask);
+}
@@ -0,0 +1,259 @@
+#include <core/chip8_movie.h>
+#include <core/chip8_scheduler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP8_MOVIE_MAGIC "C8MV"
+#define CHIP8_MOVIE_VERSION 1
+#define CHIP8_MOVIE_HEADER_SIZE 28
+#define CHIP8_MOVIE_FLAG_JIT 0x1
+// The CHIP8Variant sits in the flags above the JIT bit.
+#define CHIP8_MOVIE_VARIANT_SHIFT 1
+#define CHIP8_MOVIE_VARIANT_MASK 0x3
+// Key byte that ends the event stream; the final state hash follows it.
+#define CHIP8_MOVIE_END 0xFF
+#define CHIP8_MOVIE_KEY_PRESSED 0x10
+
+struct CHIP8MovieRecorder {
+	FILE *file;
+	uint64_t lastFrame;
+};
+
+struct CHIP8Movie {
+	uint8_t *data;
+	size_t size;
+
+	uint16_t flags;
+	uint64_t seed;
+	uint32_t instructionsPerFrame;
+	uint64_t initialHash;
+
+	uint64_t frames;
+	uint64_t finalHash;
+};
+
+static void CHIP8MoviePutVarint(FILE *file, uint64_t value);
+static void CHIP8MoviePutInteger(FILE *file, uint64_t value, size_t size);
+static bool CHIP8MovieGetVarint(const uint8_t **in, const uint8_t *end, uint64_t *value);
+static uint64_t CHIP8MovieGetInteger(const uint8_t *in, size_t size);
+
+CHIP8MovieRecorder *CHIP8MovieRecorderInit(const char *fileName, const CHIP8 *chip8, uint64_t seed, uint32_t instructionsPerFrame) {
+	CHIP8MovieRecorder *recorder = (CHIP8MovieRecorder *) malloc(sizeof(CHIP8MovieRecorder));
+	if (recorder == NULL) {
+		return NULL;
+	}
+
+	recorder->file = fopen(fileName, "wb");
+	if (recorder->file == NULL) {
+		free(recorder);
+		return NULL;
+	}
+
+	recorder->lastFrame = 0;
+
+	fwrite(CHIP8_MOVIE_MAGIC, 1, 4, recorder->file);
+	CHIP8MoviePutInteger(recorder->file, CHIP8_MOVIE_VERSION, 2);
+	uint16_t flags = (uint16_t) (chip8->variant << CHIP8_MOVIE_VARIANT_SHIFT);
+	if (chip8->jit != NULL) {
+		flags |= CHIP8_MOVIE_FLAG_JIT;
+	}
+	CHIP8MoviePutInteger(recorder->file, flags, 2);
+	CHIP8MoviePutInteger(recorder->file, seed, 8);
+	CHIP8MoviePutInteger(recorder->file, instructionsPerFrame, 4);
+	CHIP8MoviePutInteger(recorder->file, CHIP8Hash(chip8), 8);
+
+	return recorder;
+}
+
+void CHIP8MovieRecorderKey(CHIP8MovieRecorder *recorder, uint64_t frame, uint8_t key, CHIP8Key state) {
+	CHIP8MoviePutVarint(recorder->file, frame - recorder->lastFrame);
+	fputc((key & 0xF) | (state == CHIP8_KEY_PRESSED ? CHIP8_MOVIE_KEY_PRESSED : 0), recorder->file);
+
+	recorder->lastFrame = frame;
+}
+
+bool CHIP8MovieRecorderFinish(CHIP8MovieRecorder *recorder, const CHIP8 *chip8, uint64_t frames) {
+	CHIP8MoviePutVarint(recorder->file, frames - recorder->lastFrame);
+	fputc(CHIP8_MOVIE_END, recorder->file);
+	CHIP8MoviePutInteger(recorder->file, CHIP8Hash(chip8), 8);
+
+	bool written = !ferror(recorder->file);
+	written &= fclose(recorder->file) == 0;
+
+	free(recorder);
+
+	return written;
+}
+
+CHIP8Movie *CHIP8MovieLoad(const char *fileName) {
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	CHIP8Movie *movie = (CHIP8Movie *) malloc(sizeof(CHIP8Movie));
+	if (movie == NULL) {
+		fclose(file);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	movie->data = size > 0 ? (uint8_t *) malloc((size_t) size) : NULL;
+	movie->size = size > 0 ? (size_t) size : 0;
+
+	bool valid = movie->data != NULL && fread(movie->data, 1, movie->size, file) == movie->size;
+	fclose(file);
+
+	valid = valid && movie->size >= CHIP8_MOVIE_HEADER_SIZE && memcmp(movie->data, CHIP8_MOVIE_MAGIC, 4) == 0;
+	valid = valid && CHIP8MovieGetInteger(movie->data + 4, 2) == CHIP8_MOVIE_VERSION;
+
+	if (valid) {
+		movie->flags = (uint16_t) CHIP8MovieGetInteger(movie->data + 6, 2);
+		movie->seed = CHIP8MovieGetInteger(movie->data + 8, 8);
+		movie->instructionsPerFrame = (uint32_t) CHIP8MovieGetInteger(movie->data + 16, 4);
+		movie->initialHash = CHIP8MovieGetInteger(movie->data + 20, 8);
+		movie->frames = 0;
+
+		valid = (movie->flags >> CHIP8_MOVIE_VARIANT_SHIFT & CHIP8_MOVIE_VARIANT_MASK) < CHIP8_NUM_VARIANTS;
+	}
+
+	// Walk the events once so that playing never has to deal with a truncated file.
+	const uint8_t *in = movie->data + CHIP8_MOVIE_HEADER_SIZE;
+	const uint8_t *end = movie->data + movie->size;
+
+	while (valid) {
+		uint64_t frameDelta;
+		valid = CHIP8MovieGetVarint(&in, end, &frameDelta) && in < end;
+		if (!valid) {
+			break;
+		}
+
+		movie->frames += frameDelta;
+
+		if (*in++ == CHIP8_MOVIE_END) {
+			valid = end - in == 8;
+			if (valid) {
+				movie->finalHash = CHIP8MovieGetInteger(in, 8);
+			}
+			break;
+		}
+	}
+
+	if (!valid) {
+		free(movie->data);
+		free(movie);
+		return NULL;
+	}
+
+	return movie;
+}
+
+void CHIP8MovieDestroy(CHIP8Movie *movie) {
+	free(movie->data);
+	free(movie);
+}
+
+uint64_t CHIP8MovieSeed(const CHIP8Movie *movie) {
+	return movie->seed;
+}
+
+CHIP8Mode CHIP8MovieMode(const CHIP8Movie *movie) {
+	return (movie->flags & CHIP8_MOVIE_FLAG_JIT) != 0 ? CHIP8_MODE_JIT : CHIP8_MODE_INTERPRETER;
+}
+
+CHIP8Variant CHIP8MovieVariant(const CHIP8Movie *movie) {
+	return (CHIP8Variant) (movie->flags >> CHIP8_MOVIE_VARIANT_SHIFT & CHIP8_MOVIE_VARIANT_MASK);
+}
+
+uint64_t CHIP8MovieFrames(const CHIP8Movie *movie) {
+	return movie->frames;
+}
+
+CHIP8Result CHIP8MoviePlay(const CHIP8Movie *movie, CHIP8 *chip8) {
+	if (CHIP8Hash(chip8) != movie->initialHash) {
+		CHIP8SetError(chip8, CHIP8_ERROR_MOVIE_DESYNC);
+		return CHIP8_ERROR_MOVIE_DESYNC;
+	}
+
+	const uint8_t *in = movie->data + CHIP8_MOVIE_HEADER_SIZE;
+	const uint8_t *end = movie->data + movie->size;
+
+	uint64_t frame = 0;
+	uint64_t cycleTarget = chip8->cycles;
+
+	// Same frame boundaries as CHIP8SchedulerUpdate, without waiting for the clock.
+	for (;;) {
+		uint64_t frameDelta;
+		CHIP8MovieGetVarint(&in, end, &frameDelta);
+
+		for (uint64_t eventFrame = frame + frameDelta; frame < eventFrame; ++frame) {
+			cycleTarget += movie->instructionsPerFrame;
+
+			CHIP8Result result = CHIP8SchedulerRunFrame(chip8, cycleTarget);
+			if (result != CHIP8_SUCCESS) {
+				return result;
+			}
+		}
+
+		uint8_t event = *in++;
+		if (event == CHIP8_MOVIE_END) {
+			break;
+		}
+
+		chip8->keyboard[event & 0xF] = (event & CHIP8_MOVIE_KEY_PRESSED) != 0 ? CHIP8_KEY_PRESSED : CHIP8_KEY_NOT_PRESSED;
+	}
+
+	if (CHIP8Hash(chip8) != movie->finalHash) {
+		CHIP8SetError(chip8, CHIP8_ERROR_MOVIE_DESYNC);
+		return CHIP8_ERROR_MOVIE_DESYNC;
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+// Unsigned LEB128: frame gaps are usually small, so most fit in one byte.
+void CHIP8MoviePutVarint(FILE *file, uint64_t value) {
+	do {
+		fputc((int) ((value & 0x7F) | (value > 0x7F ? 0x80 : 0)), file);
+		value >>= 7;
+	} while (value != 0);
+}
+
+void CHIP8MoviePutInteger(FILE *file, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		fputc((int) ((value >> (8 * i)) & 0xFF), file);
+	}
+}
+
+bool CHIP8MovieGetVarint(const uint8_t **in, const uint8_t *end, uint64_t *value) {
+	*value = 0;
+
+	for (size_t shift = 0; shift < 64; shift += 7) {
+		if (*in == end) {
+			return false;
+		}
+
+		uint8_t byte = *(*in)++;
+		*value |= (uint64_t) (byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t CHIP8MovieGetInteger(const uint8_t *in, size_t size) {
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; ++i) {
+		value |= (uint64_t) in[i] << (8 * i);
+	}
+
+	return value;
+}
@@ -0,0 +1,551 @@
+#include <core/chip8_profile.h>
+#include <core/chip8_trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHIP8_PROFILE_HEATMAP_WIDTH 64
+// Where the outermost routine starts: ROMs are loaded at 0x200.
+#define CHIP8_PROFILE_ROM_START_ADDRESS 0x200
+
+// Ops that touch memory besides their own fetch; they are noted before they run.
+#define CHIP8_PROFILE_NOTED_OPS ( \
+	1ull << CHIP8_OP_DXYN | \
+	1ull << CHIP8_OP_FX33 | \
+	1ull << CHIP8_OP_FX55 | \
+	1ull << CHIP8_OP_FX65 \
+)
+// Set in pcOps next to an op that is noted, so that the pc never takes the fast path.
+#define CHIP8_PROFILE_NOTED 0x80
+
+// Host time of the sampled executions, less what reading the clock costs.
+typedef struct {
+	uint64_t samples;
+	int64_t nanoseconds;
+} CHIP8ProfileCounter;
+
+// One line of the report, before it is sorted.
+typedef struct {
+	uint32_t key;
+	uint64_t count;
+	double nanoseconds;
+} CHIP8ProfileRow;
+
+struct CHIP8Profile {
+	uint32_t samplePeriod;
+	uint32_t random;
+	// chip8->cycles of the next instruction to time.
+	uint64_t nextSample;
+	int64_t clockOverhead;
+
+	// An op's count only takes in a pc's executions once the pc runs another
+	// op, which spares the hot path a second count; see CHIP8ProfileCountOps.
+	// The counts are apart from the times so the hot path indexes them directly.
+	uint64_t opCounts[CHIP8_NUM_OPS];
+	uint64_t pcCounts[CHIP8_MEMORY_SIZE];
+	CHIP8ProfileCounter ops[CHIP8_NUM_OPS];
+	CHIP8ProfileCounter pcs[CHIP8_MEMORY_SIZE];
+	// The op last run at each pc, with CHIP8_PROFILE_NOTED if it is noted, and
+	// how many of the pc's executions were of other ops before it.
+	uint8_t pcOps[CHIP8_MEMORY_SIZE];
+	uint64_t pcOtherOps[CHIP8_MEMORY_SIZE];
+	// Accesses as differences: a range adds one at its start and takes it back
+	// past its end, whatever its size. The prefix sums are the counts.
+	uint64_t reads[CHIP8_MEMORY_SIZE + 1];
+	uint64_t writes[CHIP8_MEMORY_SIZE + 1];
+
+	uint64_t routineSamples[CHIP8_MEMORY_SIZE];
+	uint64_t samples;
+
+	// Per 2nnn pc, the routine it was first reached in and the one it calls,
+	// plus one; 0 where no call was made. Its calls are the pc's count.
+	uint16_t callers[CHIP8_MEMORY_SIZE];
+	uint16_t callees[CHIP8_MEMORY_SIZE];
+};
+
+static const char *CHIP8ProfileOpNames[CHIP8_NUM_OPS] = {
+	"invalid", "00e0", "00ee", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+	"8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xye", "9xy0",
+	"annn", "bnnn", "cxkk", "dxyn", "ex9e", "exa1", "fx07", "fx0a", "fx15", "fx18",
+	"fx1e", "fx29", "fx33", "fx55", "fx65", "00cn", "00fb", "00fc", "00fd", "00fe",
+	"00ff", "fx30", "fx75", "fx85", "00dn", "5xy2", "5xy3", "f000", "fn01", "f002",
+	"fx3a"
+};
+
+static CHIP8Result CHIP8ProfileStep(CHIP8 *chip8, const CHIP8Instruction *instruction);
+// Kept out of line: inlined, each would make the instructions that do not need
+// it save and restore the registers it uses.
+static __attribute__((noinline)) CHIP8Result CHIP8ProfileExecuteSlow(CHIP8 *chip8, const CHIP8Instruction *instruction);
+static __attribute__((noinline)) CHIP8Result CHIP8ProfileSample(CHIP8Profile *profile, CHIP8 *chip8, const CHIP8Instruction *instruction);
+static void CHIP8ProfileNote(CHIP8Profile *profile, const CHIP8 *chip8, const CHIP8Instruction *instruction);
+static uint16_t CHIP8ProfileRoutine(const CHIP8 *chip8);
+static void CHIP8ProfileCount(uint64_t *differences, size_t address, size_t size);
+static void CHIP8ProfileSum(const uint64_t *differences, uint64_t *counts);
+static void CHIP8ProfileCountOps(const CHIP8Profile *profile, uint64_t *counts);
+static uint32_t CHIP8ProfileNextSample(CHIP8Profile *profile);
+static double CHIP8ProfileEstimate(const CHIP8ProfileCounter *counter, uint64_t count);
+static int CHIP8ProfileCompareRows(const void *a, const void *b);
+static int CHIP8ProfileCompareKeys(const void *a, const void *b);
+static uint32_t CHIP8ProfileLog(uint64_t value);
+static int64_t CHIP8ProfileNow();
+
+CHIP8Profile *CHIP8ProfileInit(uint32_t samplePeriod) {
+	if (samplePeriod == 0) {
+		return NULL;
+	}
+
+	CHIP8Profile *profile = (CHIP8Profile *) malloc(sizeof(CHIP8Profile));
+	if (profile == NULL) {
+		return NULL;
+	}
+
+	profile->samplePeriod = samplePeriod;
+
+	// Two reads of the clock back to back cost what every sample pays on top of its instruction.
+	profile->clockOverhead = INT64_MAX;
+	for (int k = 0; k < 1000; ++k) {
+		int64_t start = CHIP8ProfileNow();
+		int64_t elapsed = CHIP8ProfileNow() - start;
+
+		if (elapsed < profile->clockOverhead) {
+			profile->clockOverhead = elapsed;
+		}
+	}
+
+	CHIP8ProfileClear(profile);
+
+	return profile;
+}
+
+void CHIP8ProfileDestroy(CHIP8Profile *profile) {
+	free(profile);
+}
+
+CHIP8Result CHIP8ProfileExecute(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8Profile *profile = chip8->profile;
+	uint16_t pc = chip8->pc;
+	++profile->pcCounts[pc];
+
+	// Most instructions only count, and then jump straight to their handler;
+	// a trace takes the slow path too, through CHIP8ProfileStep.
+	if (profile->pcOps[pc] == instruction->op && chip8->cycles < profile->nextSample && chip8->trace == NULL) {
+		chip8->pc += 2;
+		++chip8->cycles;
+
+		return instruction->handler(chip8, instruction);
+	}
+
+	return CHIP8ProfileExecuteSlow(chip8, instruction);
+}
+
+void CHIP8ProfileClear(CHIP8Profile *profile) {
+	memset(profile->opCounts, 0, sizeof(profile->opCounts));
+	memset(profile->pcCounts, 0, sizeof(profile->pcCounts));
+	memset(profile->ops, 0, sizeof(profile->ops));
+	memset(profile->pcs, 0, sizeof(profile->pcs));
+	memset(profile->pcOps, CHIP8_OP_INVALID, sizeof(profile->pcOps));
+	memset(profile->pcOtherOps, 0, sizeof(profile->pcOtherOps));
+	memset(profile->reads, 0, sizeof(profile->reads));
+	memset(profile->writes, 0, sizeof(profile->writes));
+	memset(profile->routineSamples, 0, sizeof(profile->routineSamples));
+	memset(profile->callers, 0, sizeof(profile->callers));
+	memset(profile->callees, 0, sizeof(profile->callees));
+
+	profile->samples = 0;
+
+	// The same instructions are sampled on every run of the same machine.
+	profile->random = 0x9e3779b9;
+	profile->nextSample = 0;
+}
+
+uint64_t CHIP8ProfileInstructions(const CHIP8Profile *profile) {
+	uint64_t instructions = 0;
+
+	for (size_t pc = 0; pc < CHIP8_MEMORY_SIZE; ++pc) {
+		instructions += profile->pcCounts[pc];
+	}
+
+	return instructions;
+}
+
+bool CHIP8ProfileWriteReport(const CHIP8Profile *profile, const CHIP8 *chip8, const char *fileName, size_t top) {
+	CHIP8ProfileRow *rows = (CHIP8ProfileRow *) malloc(CHIP8_MEMORY_SIZE * sizeof(CHIP8ProfileRow));
+	if (rows == NULL) {
+		return false;
+	}
+
+	FILE *file = fopen(fileName, "w");
+	if (file == NULL) {
+		free(rows);
+		return false;
+	}
+
+	uint64_t instructions = CHIP8ProfileInstructions(profile);
+	uint64_t opCounts[CHIP8_NUM_OPS];
+	CHIP8ProfileCountOps(profile, opCounts);
+
+	double nanoseconds = 0;
+	for (size_t op = 0; op < CHIP8_NUM_OPS; ++op) {
+		nanoseconds += CHIP8ProfileEstimate(&profile->ops[op], opCounts[op]);
+	}
+
+	fprintf(file, "instructions\t%llu\n", (unsigned long long) instructions);
+	fprintf(file, "samples\t%llu\n", (unsigned long long) profile->samples);
+	fprintf(file, "host ms\t%.3f\n", nanoseconds / 1e6);
+
+	// Ops, all of them that ran.
+	size_t numRows = 0;
+	for (size_t op = 0; op < CHIP8_NUM_OPS; ++op) {
+		if (opCounts[op] > 0) {
+			rows[numRows++] = (CHIP8ProfileRow) { (uint32_t) op, opCounts[op], CHIP8ProfileEstimate(&profile->ops[op], opCounts[op]) };
+		}
+	}
+	qsort(rows, numRows, sizeof(CHIP8ProfileRow), CHIP8ProfileCompareRows);
+
+	fprintf(file, "\nop\texecutions\tshare\tns/instruction\tms\n");
+	for (size_t r = 0; r < numRows; ++r) {
+		fprintf(
+			file,
+			"%s\t%llu\t%.1f%%\t%.2f\t%.3f\n",
+			CHIP8ProfileOpNames[rows[r].key],
+			(unsigned long long) rows[r].count,
+			nanoseconds > 0 ? 100 * rows[r].nanoseconds / nanoseconds : 0.0,
+			rows[r].nanoseconds / rows[r].count,
+			rows[r].nanoseconds / 1e6
+		);
+	}
+
+	// The hottest pcs.
+	numRows = 0;
+	for (size_t pc = 0; pc < CHIP8_MEMORY_SIZE; ++pc) {
+		if (profile->pcCounts[pc] > 0) {
+			rows[numRows++] = (CHIP8ProfileRow) { (uint32_t) pc, profile->pcCounts[pc], CHIP8ProfileEstimate(&profile->pcs[pc], profile->pcCounts[pc]) };
+		}
+	}
+	qsort(rows, numRows, sizeof(CHIP8ProfileRow), CHIP8ProfileCompareRows);
+
+	fprintf(file, "\npc\topcode\texecutions\tshare\tns/instruction\tms\n");
+	for (size_t r = 0; r < numRows && r < top; ++r) {
+		uint16_t pc = (uint16_t) rows[r].key;
+		uint8_t lsbyte = pc + 1 < CHIP8_MEMORY_SIZE ? CHIP8ReadByte(chip8, pc + 1) : 0;
+
+		fprintf(
+			file,
+			"%03x\t%02x%02x\t%llu\t%.1f%%\t%.2f\t%.3f\n",
+			pc,
+			CHIP8ReadByte(chip8, pc),
+			lsbyte,
+			(unsigned long long) rows[r].count,
+			nanoseconds > 0 ? 100 * rows[r].nanoseconds / nanoseconds : 0.0,
+			rows[r].nanoseconds / rows[r].count,
+			rows[r].nanoseconds / 1e6
+		);
+	}
+
+	// The call graph, busiest edges first. Call sites with the same caller and
+	// callee are one edge: sorted by key, they are next to each other.
+	numRows = 0;
+	for (size_t pc = 0; pc < CHIP8_MEMORY_SIZE; ++pc) {
+		if (profile->callees[pc] != 0) {
+			uint32_t key = (uint32_t) (profile->callers[pc] - 1) << 12 | (profile->callees[pc] - 1);
+			rows[numRows++] = (CHIP8ProfileRow) { key, profile->pcCounts[pc], 0 };
+		}
+	}
+	qsort(rows, numRows, sizeof(CHIP8ProfileRow), CHIP8ProfileCompareKeys);
+
+	size_t numEdges = 0;
+	for (size_t r = 0; r < numRows; ++r) {
+		if (numEdges > 0 && rows[numEdges - 1].key == rows[r].key) {
+			rows[numEdges - 1].count += rows[r].count;
+		} else {
+			rows[numEdges++] = rows[r];
+		}
+	}
+	numRows = numEdges;
+	qsort(rows, numRows, sizeof(CHIP8ProfileRow), CHIP8ProfileCompareRows);
+
+	fprintf(file, "\ncaller\tcallee\tcalls\n");
+	for (size_t r = 0; r < numRows && r < top; ++r) {
+		fprintf(file, "%03x\t%03x\t%llu\n", rows[r].key >> 12, rows[r].key & 0xFFF, (unsigned long long) rows[r].count);
+	}
+
+	// Routines by the share of samples taken while they, not their callees, ran.
+	numRows = 0;
+	for (size_t entry = 0; entry < CHIP8_MEMORY_SIZE; ++entry) {
+		if (profile->routineSamples[entry] > 0) {
+			rows[numRows++] = (CHIP8ProfileRow) { (uint32_t) entry, profile->routineSamples[entry], 0 };
+		}
+	}
+	qsort(rows, numRows, sizeof(CHIP8ProfileRow), CHIP8ProfileCompareRows);
+
+	fprintf(file, "\nroutine\tself share\n");
+	for (size_t r = 0; r < numRows && r < top; ++r) {
+		fprintf(file, "%03x\t%.1f%%\n", rows[r].key, 100.0 * rows[r].count / profile->samples);
+	}
+
+	free(rows);
+
+	bool written = !ferror(file);
+	written &= fclose(file) == 0;
+
+	return written;
+}
+
+bool CHIP8ProfileWriteHeatmap(const CHIP8Profile *profile, const char *fileName, uint32_t scale) {
+	if (scale == 0) {
+		return false;
+	}
+
+	FILE *file = fopen(fileName, "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	uint64_t writes[CHIP8_MEMORY_SIZE];
+	uint64_t reads[CHIP8_MEMORY_SIZE];
+	CHIP8ProfileSum(profile->writes, writes);
+	CHIP8ProfileSum(profile->reads, reads);
+
+	// An instruction is fetched from its own byte and the next.
+	uint64_t fetches[CHIP8_MEMORY_SIZE];
+	for (size_t address = 0; address < CHIP8_MEMORY_SIZE; ++address) {
+		fetches[address] = profile->pcCounts[address] + (address > 0 ? profile->pcCounts[address - 1] : 0);
+	}
+
+	const uint64_t *channels[3] = { writes, reads, fetches };
+	uint32_t maxima[3] = { 0, 0, 0 };
+
+	for (size_t c = 0; c < 3; ++c) {
+		for (size_t address = 0; address < CHIP8_MEMORY_SIZE; ++address) {
+			uint32_t level = CHIP8ProfileLog(channels[c][address]);
+			maxima[c] = level > maxima[c] ? level : maxima[c];
+		}
+	}
+
+	uint32_t width = CHIP8_PROFILE_HEATMAP_WIDTH * scale;
+	uint32_t height = CHIP8_MEMORY_SIZE / CHIP8_PROFILE_HEATMAP_WIDTH * scale;
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			size_t address = y / scale * CHIP8_PROFILE_HEATMAP_WIDTH + x / scale;
+
+			for (size_t c = 0; c < 3; ++c) {
+				uint32_t level = CHIP8ProfileLog(channels[c][address]);
+				fputc(maxima[c] > 0 ? (int) (255 * level / maxima[c]) : 0, file);
+			}
+		}
+	}
+
+	bool written = !ferror(file);
+	written &= fclose(file) == 0;
+
+	return written;
+}
+
+CHIP8Result CHIP8ProfileExecuteSlow(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	CHIP8Profile *profile = chip8->profile;
+	uint16_t pc = chip8->pc;
+
+	bool noted = (CHIP8_PROFILE_NOTED_OPS >> instruction->op & 1) != 0;
+
+	// First run here, or the code changed: what ran here so far, bar this one, was the op before.
+	if ((profile->pcOps[pc] & ~CHIP8_PROFILE_NOTED) != instruction->op) {
+		uint64_t before = profile->pcCounts[pc] - 1 - profile->pcOtherOps[pc];
+
+		profile->opCounts[profile->pcOps[pc] & ~CHIP8_PROFILE_NOTED] += before;
+		profile->pcOtherOps[pc] += before;
+		profile->pcOps[pc] = (uint8_t) (instruction->op | (noted ? CHIP8_PROFILE_NOTED : 0));
+
+		// A call site always calls the same routine, so it is only looked at once; its count is its calls.
+		if (instruction->op == CHIP8_OP_2NNN) {
+			profile->callers[pc] = CHIP8ProfileRoutine(chip8) + 1;
+			profile->callees[pc] = instruction->nnn + 1;
+		}
+	}
+
+	if (noted) {
+		CHIP8ProfileNote(profile, chip8, instruction);
+	}
+
+	if (chip8->cycles >= profile->nextSample) {
+		return CHIP8ProfileSample(profile, chip8, instruction);
+	}
+
+	return CHIP8ProfileStep(chip8, instruction);
+}
+
+CHIP8Result CHIP8ProfileStep(CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	if (chip8->trace != NULL) {
+		return CHIP8TraceExecute(chip8->trace, chip8, instruction);
+	}
+
+	chip8->pc += 2;
+	++chip8->cycles;
+
+	return instruction->handler(chip8, instruction);
+}
+
+CHIP8Result CHIP8ProfileSample(CHIP8Profile *profile, CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	uint16_t pc = chip8->pc;
+	uint16_t routine = CHIP8ProfileRoutine(chip8);
+
+	int64_t start = CHIP8ProfileNow();
+	CHIP8Result result = CHIP8ProfileStep(chip8, instruction);
+	int64_t nanoseconds = CHIP8ProfileNow() - start - profile->clockOverhead;
+
+	// Not clamped at 0: the clock's jitter has to average out, not add up.
+	++profile->ops[instruction->op].samples;
+	profile->ops[instruction->op].nanoseconds += nanoseconds;
+	++profile->pcs[pc].samples;
+	profile->pcs[pc].nanoseconds += nanoseconds;
+
+	++profile->routineSamples[routine];
+	++profile->samples;
+
+	profile->nextSample = chip8->cycles + CHIP8ProfileNextSample(profile) - 1;
+
+	return result;
+}
+
+// Counts what the instruction is about to do; one that then faults has still been counted.
+void CHIP8ProfileNote(CHIP8Profile *profile, const CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	uint8_t x = instruction->x;
+
+	switch (instruction->op) {
+		case CHIP8_OP_DXYN: {
+			// The rows below the bottom edge are clipped and never read; the sprite may wrap past the end of memory.
+			// A SUPER-CHIP dxy0 reads two bytes a row of a 16x16 sprite.
+			bool big = instruction->n == 0 && chip8->variant != CHIP8_VARIANT_CHIP8;
+			size_t height = chip8->hires ? CHIP8_HIRES_HEIGHT : CHIP8_DISPLAY_HEIGHT;
+			size_t rows = big ? 16 : instruction->n;
+			size_t pixelY = chip8->v[instruction->y] % height;
+			if (rows > height - pixelY) {
+				rows = height - pixelY;
+			}
+
+			size_t size = big ? 2 * rows : rows;
+			size_t first = chip8->i % CHIP8_MEMORY_SIZE;
+			size_t wrapped = first + size > CHIP8_MEMORY_SIZE ? first + size - CHIP8_MEMORY_SIZE : 0;
+
+			CHIP8ProfileCount(profile->reads, first, size - wrapped);
+			CHIP8ProfileCount(profile->reads, 0, wrapped);
+			break;
+		}
+		case CHIP8_OP_FX33:
+			CHIP8ProfileCount(profile->writes, chip8->i, 3);
+			break;
+		case CHIP8_OP_FX55:
+			CHIP8ProfileCount(profile->writes, chip8->i, x + 1);
+			break;
+		case CHIP8_OP_FX65:
+			CHIP8ProfileCount(profile->reads, chip8->i, x + 1);
+			break;
+	}
+}
+
+// Nothing is counted for a range that runs past the end of memory: the instruction faults instead.
+// The entry of the routine running now, read back from the call that pushed the
+// top of the stack, so that calls need no bookkeeping of their own.
+uint16_t CHIP8ProfileRoutine(const CHIP8 *chip8) {
+	if (chip8->sp == 0 || chip8->sp > CHIP8_STACK_SIZE) {
+		return CHIP8_PROFILE_ROM_START_ADDRESS;
+	}
+
+	uint16_t call = (uint16_t) ((chip8->stack[chip8->sp - 1] - 2) % CHIP8_MEMORY_SIZE);
+	uint16_t opcode = (uint16_t) (CHIP8ReadByte(chip8, call) << 8 | CHIP8ReadByte(chip8, (call + 1) % CHIP8_MEMORY_SIZE));
+
+	// The call may have been overwritten since.
+	return (opcode & 0xF000) == 0x2000 ? opcode & 0x0FFF : CHIP8_PROFILE_ROM_START_ADDRESS;
+}
+
+void CHIP8ProfileCount(uint64_t *differences, size_t address, size_t size) {
+	if (address > CHIP8_MEMORY_SIZE - size) {
+		return;
+	}
+
+	// Unsigned wrap around cancels out in the sums.
+	++differences[address];
+	--differences[address + size];
+}
+
+void CHIP8ProfileSum(const uint64_t *differences, uint64_t *counts) {
+	uint64_t count = 0;
+
+	for (size_t address = 0; address < CHIP8_MEMORY_SIZE; ++address) {
+		count += differences[address];
+		counts[address] = count;
+	}
+}
+
+void CHIP8ProfileCountOps(const CHIP8Profile *profile, uint64_t *counts) {
+	for (size_t op = 0; op < CHIP8_NUM_OPS; ++op) {
+		counts[op] = profile->opCounts[op];
+	}
+
+	for (size_t pc = 0; pc < CHIP8_MEMORY_SIZE; ++pc) {
+		counts[profile->pcOps[pc] & ~CHIP8_PROFILE_NOTED] += profile->pcCounts[pc] - profile->pcOtherOps[pc];
+	}
+}
+
+// Uniform in [1, 2 * samplePeriod - 1], so samplePeriod apart on average.
+uint32_t CHIP8ProfileNextSample(CHIP8Profile *profile) {
+	// xorshift32
+	profile->random ^= profile->random << 13;
+	profile->random ^= profile->random >> 17;
+	profile->random ^= profile->random << 5;
+
+	return 1 + profile->random % (2 * profile->samplePeriod - 1);
+}
+
+// Host time of every execution counted, from the mean of those sampled.
+double CHIP8ProfileEstimate(const CHIP8ProfileCounter *counter, uint64_t count) {
+	if (counter->samples == 0 || counter->nanoseconds <= 0) {
+		return 0;
+	}
+
+	return (double) counter->nanoseconds / counter->samples * count;
+}
+
+// Most time first, then most counted, then by key.
+int CHIP8ProfileCompareRows(const void *a, const void *b) {
+	const CHIP8ProfileRow *rowA = (const CHIP8ProfileRow *) a;
+	const CHIP8ProfileRow *rowB = (const CHIP8ProfileRow *) b;
+
+	if (rowA->nanoseconds != rowB->nanoseconds) {
+		return rowA->nanoseconds > rowB->nanoseconds ? -1 : 1;
+	}
+	if (rowA->count != rowB->count) {
+		return rowA->count > rowB->count ? -1 : 1;
+	}
+
+	return rowA->key < rowB->key ? -1 : rowA->key > rowB->key;
+}
+
+int CHIP8ProfileCompareKeys(const void *a, const void *b) {
+	const CHIP8ProfileRow *rowA = (const CHIP8ProfileRow *) a;
+	const CHIP8ProfileRow *rowB = (const CHIP8ProfileRow *) b;
+
+	return rowA->key < rowB->key ? -1 : rowA->key > rowB->key;
+}
+
+// log2(value + 1) in eighths, enough to shade a heatmap without libm.
+uint32_t CHIP8ProfileLog(uint64_t value) {
+	++value;
+	if (value == 0) {
+		return 64 * 8;
+	}
+
+	uint32_t bits = 63 - (uint32_t) __builtin_clzll(value);
+	uint32_t fraction = (uint32_t) (bits >= 3 ? value >> (bits - 3) : value << (3 - bits)) & 7;
+
+	return bits * 8 + fraction;
+}
+
+int64_t CHIP8ProfileNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
@@ -0,0 +1,235 @@
+#include <core/chip8_rewind.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Worst case is alternating equal and different bytes: 3 bytes of output for every 2 of input.
+#define CHIP8_REWIND_MAX_DELTA_SIZE (2 * CHIP8_STATE_SIZE + 16)
+
+struct CHIP8Rewind {
+	// Sizes of the stored deltas, oldest first.
+	uint32_t *frameSizes;
+	size_t maxFrames;
+	size_t firstFrame;
+	size_t numFrames;
+
+	// The deltas themselves, back to back in a byte ring starting at tail.
+	uint8_t *buffer;
+	size_t capacity;
+	size_t tail;
+	size_t used;
+
+	// state holds the newest frame, scratch the one being pushed. Both are
+	// stateSize bytes, which depends on the machine's variant.
+	bool hasState;
+	size_t stateSize;
+	uint8_t *state;
+	uint8_t *scratch;
+	uint8_t states[2][CHIP8_STATE_SIZE];
+	uint8_t delta[CHIP8_REWIND_MAX_DELTA_SIZE];
+};
+
+static size_t CHIP8RewindEncode(const uint8_t *from, const uint8_t *to, size_t size, uint8_t *out);
+static void CHIP8RewindDecode(const uint8_t *in, size_t size, uint8_t *state);
+static void CHIP8RewindStore(CHIP8Rewind *rewind, const uint8_t *delta, size_t size);
+static void CHIP8RewindDropOldest(CHIP8Rewind *rewind);
+
+CHIP8Rewind *CHIP8RewindInit(size_t maxFrames, size_t budget) {
+	if (maxFrames == 0 || budget == 0) {
+		return NULL;
+	}
+
+	CHIP8Rewind *rewind = (CHIP8Rewind *) malloc(sizeof(CHIP8Rewind));
+	if (rewind == NULL) {
+		return NULL;
+	}
+
+	rewind->frameSizes = (uint32_t *) malloc(maxFrames * sizeof(uint32_t));
+	rewind->buffer = (uint8_t *) malloc(budget);
+
+	if (rewind->frameSizes == NULL || rewind->buffer == NULL) {
+		free(rewind->frameSizes);
+		free(rewind->buffer);
+		free(rewind);
+		return NULL;
+	}
+
+	rewind->maxFrames = maxFrames;
+	rewind->firstFrame = 0;
+	rewind->numFrames = 0;
+
+	rewind->capacity = budget;
+	rewind->tail = 0;
+	rewind->used = 0;
+
+	rewind->hasState = false;
+	rewind->stateSize = 0;
+	rewind->state = rewind->states[0];
+	rewind->scratch = rewind->states[1];
+
+	return rewind;
+}
+
+void CHIP8RewindDestroy(CHIP8Rewind *rewind) {
+	free(rewind->frameSizes);
+	free(rewind->buffer);
+	free(rewind);
+}
+
+CHIP8Result CHIP8RewindPush(CHIP8Rewind *rewind, const CHIP8 *chip8) {
+	CHIP8Result result = CHIP8SaveState(chip8, rewind->scratch, CHIP8_STATE_SIZE);
+	if (result != CHIP8_SUCCESS) {
+		return result;
+	}
+
+	size_t stateSize = CHIP8StateSize(chip8->variant);
+
+	if (rewind->hasState && stateSize == rewind->stateSize) {
+		// Applied to the new frame, the delta gives back the one it replaces as the newest.
+		size_t size = CHIP8RewindEncode(rewind->scratch, rewind->state, stateSize, rewind->delta);
+		CHIP8RewindStore(rewind, rewind->delta, size);
+	} else {
+		// Frames of another variant do not line up with this one, so there is nothing to delta against.
+		rewind->numFrames = 0;
+		rewind->used = 0;
+	}
+
+	uint8_t *state = rewind->state;
+	rewind->state = rewind->scratch;
+	rewind->scratch = state;
+	rewind->hasState = true;
+	rewind->stateSize = stateSize;
+
+	return CHIP8_SUCCESS;
+}
+
+bool CHIP8RewindStepBack(CHIP8Rewind *rewind, CHIP8 *chip8) {
+	if (rewind->numFrames == 0) {
+		return false;
+	}
+
+	size_t size = rewind->frameSizes[(rewind->firstFrame + rewind->numFrames - 1) % rewind->maxFrames];
+	size_t start = (rewind->tail + rewind->used - size) % rewind->capacity;
+
+	// The newest delta may wrap around the end of the ring.
+	size_t head = size < rewind->capacity - start ? size : rewind->capacity - start;
+	memcpy(rewind->delta, &rewind->buffer[start], head);
+	memcpy(rewind->delta + head, rewind->buffer, size - head);
+
+	CHIP8RewindDecode(rewind->delta, size, rewind->state);
+
+	// A failed load leaves chip8 as it was; applying the XOR delta again gives back the newest frame to match.
+	if (CHIP8LoadState(chip8, rewind->state, rewind->stateSize) != CHIP8_SUCCESS) {
+		CHIP8RewindDecode(rewind->delta, size, rewind->state);
+		return false;
+	}
+
+	--rewind->numFrames;
+	rewind->used -= size;
+
+	return true;
+}
+
+size_t CHIP8RewindFrames(const CHIP8Rewind *rewind) {
+	return rewind->numFrames;
+}
+
+size_t CHIP8RewindBytes(const CHIP8Rewind *rewind) {
+	return rewind->used;
+}
+
+// Emits (equal run, different run, XOR of the different bytes) triples, runs as LEB128 varints.
+size_t CHIP8RewindEncode(const uint8_t *from, const uint8_t *to, size_t size, uint8_t *out) {
+	uint8_t *start = out;
+	size_t position = 0;
+
+	while (position < size) {
+		size_t equalEnd = position;
+		while (equalEnd + 8 <= size && memcmp(&from[equalEnd], &to[equalEnd], 8) == 0) {
+			equalEnd += 8;
+		}
+		while (equalEnd < size && from[equalEnd] == to[equalEnd]) {
+			++equalEnd;
+		}
+
+		if (equalEnd == size) {
+			break;
+		}
+
+		size_t differentEnd = equalEnd;
+		while (differentEnd < size && from[differentEnd] != to[differentEnd]) {
+			++differentEnd;
+		}
+
+		size_t runs[2] = { equalEnd - position, differentEnd - equalEnd };
+		for (size_t r = 0; r < 2; ++r) {
+			size_t run = runs[r];
+			do {
+				*out++ = (uint8_t) ((run & 0x7F) | (run > 0x7F ? 0x80 : 0));
+				run >>= 7;
+			} while (run != 0);
+		}
+
+		for (size_t i = equalEnd; i < differentEnd; ++i) {
+			*out++ = from[i] ^ to[i];
+		}
+
+		position = differentEnd;
+	}
+
+	return (size_t) (out - start);
+}
+
+void CHIP8RewindDecode(const uint8_t *in, size_t size, uint8_t *state) {
+	const uint8_t *end = in + size;
+	size_t position = 0;
+
+	while (in < end) {
+		size_t runs[2] = { 0, 0 };
+		for (size_t r = 0; r < 2; ++r) {
+			for (size_t shift = 0; ; shift += 7) {
+				uint8_t byte = *in++;
+				runs[r] |= (size_t) (byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					break;
+				}
+			}
+		}
+
+		position += runs[0];
+		for (size_t i = 0; i < runs[1]; ++i) {
+			state[position++] ^= *in++;
+		}
+	}
+}
+
+void CHIP8RewindStore(CHIP8Rewind *rewind, const uint8_t *delta, size_t size) {
+	// Every delta depends on the newer ones, so one that cannot be kept cuts off all history behind it.
+	if (size > rewind->capacity) {
+		rewind->numFrames = 0;
+		rewind->used = 0;
+		return;
+	}
+
+	while (rewind->numFrames == rewind->maxFrames || rewind->capacity - rewind->used < size) {
+		CHIP8RewindDropOldest(rewind);
+	}
+
+	size_t start = (rewind->tail + rewind->used) % rewind->capacity;
+	size_t head = size < rewind->capacity - start ? size : rewind->capacity - start;
+	memcpy(&rewind->buffer[start], delta, head);
+	memcpy(rewind->buffer, delta + head, size - head);
+
+	rewind->frameSizes[(rewind->firstFrame + rewind->numFrames) % rewind->maxFrames] = (uint32_t) size;
+	++rewind->numFrames;
+	rewind->used += size;
+}
+
+void CHIP8RewindDropOldest(CHIP8Rewind *rewind) {
+	size_t size = rewind->frameSizes[rewind->firstFrame];
+
+	rewind->tail = (rewind->tail + size) % rewind->capacity;
+	rewind->used -= size;
+
+	rewind->firstFrame = (rewind->firstFrame + 1) % rewind->maxFrames;
+	--rewind->numFrames;
+}
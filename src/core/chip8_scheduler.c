@@ -0,0 +1,88 @@
+#include <core/chip8_scheduler.h>
+
+#define CHIP8_SCHEDULER_FRAME_DURATION (1.0 / CHIP8_SCHEDULER_FRAME_RATE)
+
+static uint64_t CHIP8SchedulerDueFrames(const CHIP8Scheduler *scheduler, double now);
+
+void CHIP8SchedulerInit(CHIP8Scheduler *scheduler, const CHIP8 *chip8, uint32_t instructionsPerFrame, double now) {
+	scheduler->instructionsPerFrame = instructionsPerFrame;
+
+	scheduler->startTime = now;
+	scheduler->frameIndex = 0;
+
+	scheduler->frames = 0;
+	scheduler->skippedFrames = 0;
+	scheduler->startCycles = chip8->cycles;
+	scheduler->cycleTarget = chip8->cycles;
+}
+
+CHIP8Result CHIP8SchedulerUpdate(CHIP8Scheduler *scheduler, CHIP8 *chip8, double now, uint32_t *framesRun) {
+	*framesRun = 0;
+
+	uint64_t dueFrames = CHIP8SchedulerDueFrames(scheduler, now);
+
+	if (dueFrames > CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES) {
+		// Too far behind to catch up: drop the backlog instead of running in a burst.
+		scheduler->skippedFrames += dueFrames - CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES;
+		scheduler->frameIndex += dueFrames - CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES;
+		dueFrames = CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES;
+	}
+
+	for (uint64_t f = 0; f < dueFrames; ++f) {
+		// The target is cumulative, so a JIT block that overshoots one frame shortens the next.
+		scheduler->cycleTarget += scheduler->instructionsPerFrame;
+
+		CHIP8Result result = CHIP8SchedulerRunFrame(chip8, scheduler->cycleTarget);
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+
+		++scheduler->frameIndex;
+		++scheduler->frames;
+		++*framesRun;
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+uint32_t CHIP8SchedulerHold(CHIP8Scheduler *scheduler, const CHIP8 *chip8, double now) {
+	uint64_t dueFrames = CHIP8SchedulerDueFrames(scheduler, now);
+
+	scheduler->frameIndex += dueFrames;
+	// Held frames ran no instructions, so the next frame's quota starts from here.
+	scheduler->cycleTarget = chip8->cycles;
+
+	return (uint32_t) (dueFrames < CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES ? dueFrames : CHIP8_SCHEDULER_MAX_CATCH_UP_FRAMES);
+}
+
+double CHIP8SchedulerNextDeadline(const CHIP8Scheduler *scheduler) {
+	return scheduler->startTime + scheduler->frameIndex * CHIP8_SCHEDULER_FRAME_DURATION;
+}
+
+void CHIP8SchedulerGetMetrics(const CHIP8Scheduler *scheduler, const CHIP8 *chip8, double now, CHIP8SchedulerMetrics *metrics) {
+	double elapsed = now - scheduler->startTime;
+
+	metrics->configuredIPS = (double) scheduler->instructionsPerFrame * CHIP8_SCHEDULER_FRAME_RATE;
+	metrics->achievedIPS = elapsed > 0 ? (chip8->cycles - scheduler->startCycles) / elapsed : 0.0;
+	metrics->frames = scheduler->frames;
+	metrics->skippedFrames = scheduler->skippedFrames;
+}
+
+CHIP8Result CHIP8SchedulerRunFrame(CHIP8 *chip8, uint64_t endCycle) {
+	if (chip8->cycles < endCycle && CHIP8Run(chip8, endCycle - chip8->cycles, 0) == CHIP8_STOP_ERROR) {
+		return chip8->error.code;
+	}
+
+	CHIP8UpdateTimers(chip8);
+
+	return CHIP8_SUCCESS;
+}
+
+uint64_t CHIP8SchedulerDueFrames(const CHIP8Scheduler *scheduler, double now) {
+	if (now < CHIP8SchedulerNextDeadline(scheduler)) {
+		return 0;
+	}
+
+	// Frame n is due at startTime + n * duration.
+	return (uint64_t) ((now - scheduler->startTime) / CHIP8_SCHEDULER_FRAME_DURATION) + 1 - scheduler->frameIndex;
+}
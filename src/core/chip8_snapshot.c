@@ -0,0 +1,185 @@
+#include <core/chip8_snapshot.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP8_SNAPSHOT_NUM_PAGES (CHIP8_XO_MEMORY_SIZE / CHIP8_SNAPSHOT_PAGE_SIZE)
+
+typedef struct {
+	// Snapshots forked from a common one may be captured and destroyed on different threads.
+	_Atomic uint32_t references;
+	uint8_t data[CHIP8_SNAPSHOT_PAGE_SIZE];
+} CHIP8SnapshotPage;
+
+struct CHIP8Snapshot {
+	uint16_t stack[CHIP8_STACK_SIZE];
+	uint8_t v[CHIP8_NUM_V_REGISTERS];
+	uint16_t i;
+	uint16_t pc;
+	uint8_t sp;
+	uint8_t dt;
+	uint8_t st;
+	CHIP8Key keyboard[CHIP8_NUM_KEYS];
+	uint64_t random;
+
+	CHIP8Variant variant;
+	bool hires;
+	uint8_t planes;
+	uint8_t flags[CHIP8_NUM_FLAGS];
+	uint8_t pattern[CHIP8_PATTERN_SIZE];
+	uint8_t pitch;
+	uint64_t display[CHIP8_NUM_PLANES][CHIP8_HIRES_HEIGHT][CHIP8_ROW_WORDS];
+
+	// The pages of the machine's memorySize; only XO-CHIP machines have them all.
+	size_t numPages;
+	CHIP8SnapshotPage *pages[CHIP8_SNAPSHOT_NUM_PAGES];
+};
+
+static const uint8_t CHIP8SnapshotZeroPage[CHIP8_SNAPSHOT_PAGE_SIZE];
+
+static void CHIP8SnapshotRelease(CHIP8SnapshotPage *page);
+
+CHIP8Snapshot *CHIP8SnapshotCapture(const CHIP8 *chip8, const CHIP8Snapshot *previous) {
+	CHIP8Snapshot *snapshot = (CHIP8Snapshot *) malloc(sizeof(CHIP8Snapshot));
+	if (snapshot == NULL) {
+		return NULL;
+	}
+
+	memcpy(snapshot->stack, chip8->stack, sizeof(snapshot->stack));
+	memcpy(snapshot->v, chip8->v, sizeof(snapshot->v));
+	snapshot->i = chip8->i;
+	snapshot->pc = chip8->pc;
+	snapshot->sp = chip8->sp;
+	snapshot->dt = chip8->dt;
+	snapshot->st = chip8->st;
+	memcpy(snapshot->keyboard, chip8->keyboard, sizeof(snapshot->keyboard));
+	snapshot->random = chip8->random;
+
+	snapshot->variant = chip8->variant;
+	snapshot->hires = chip8->hires;
+	snapshot->planes = chip8->planes;
+	memcpy(snapshot->flags, chip8->flags, sizeof(snapshot->flags));
+	memcpy(snapshot->pattern, chip8->pattern, sizeof(snapshot->pattern));
+	snapshot->pitch = chip8->pitch;
+	CHIP8ReadDisplay(chip8, snapshot->display);
+
+	// A previous snapshot of a smaller machine has no pages to share past its own.
+	size_t previousPages = previous != NULL ? previous->numPages : 0;
+	snapshot->numPages = chip8->memorySize / CHIP8_SNAPSHOT_PAGE_SIZE;
+
+	for (size_t p = 0; p < snapshot->numPages; ++p) {
+		uint8_t memory[CHIP8_SNAPSHOT_PAGE_SIZE];
+		CHIP8ReadMemory(chip8, p * CHIP8_SNAPSHOT_PAGE_SIZE, memory, CHIP8_SNAPSHOT_PAGE_SIZE);
+
+		if (p < previousPages && memcmp(previous->pages[p]->data, memory, CHIP8_SNAPSHOT_PAGE_SIZE) == 0) {
+			snapshot->pages[p] = previous->pages[p];
+			atomic_fetch_add_explicit(&snapshot->pages[p]->references, 1, memory_order_relaxed);
+			continue;
+		}
+
+		CHIP8SnapshotPage *page = (CHIP8SnapshotPage *) malloc(sizeof(CHIP8SnapshotPage));
+		if (page == NULL) {
+			for (size_t q = 0; q < p; ++q) {
+				CHIP8SnapshotRelease(snapshot->pages[q]);
+			}
+			free(snapshot);
+			return NULL;
+		}
+
+		atomic_init(&page->references, 1);
+		memcpy(page->data, memory, CHIP8_SNAPSHOT_PAGE_SIZE);
+		snapshot->pages[p] = page;
+	}
+
+	return snapshot;
+}
+
+CHIP8Result CHIP8SnapshotRestore(const CHIP8Snapshot *snapshot, CHIP8 *chip8) {
+	// As with CHIP8SetVariant, the JIT only knows 4 KB of memory.
+	if (snapshot->variant == CHIP8_VARIANT_XOCHIP && chip8->jit != NULL) {
+		CHIP8SetError(chip8, CHIP8_ERROR_JIT_UNAVAILABLE);
+		return CHIP8_ERROR_JIT_UNAVAILABLE;
+	}
+
+	// Nor does a profile.
+	if (snapshot->variant == CHIP8_VARIANT_XOCHIP && chip8->profile != NULL) {
+		CHIP8SetError(chip8, CHIP8_ERROR_PROFILE_UNAVAILABLE);
+		return CHIP8_ERROR_PROFILE_UNAVAILABLE;
+	}
+
+	// Memory a smaller snapshot does not cover is cleared.
+	size_t numPages = chip8->memorySize / CHIP8_SNAPSHOT_PAGE_SIZE;
+	if (numPages < snapshot->numPages) {
+		numPages = snapshot->numPages;
+	}
+
+	// Allocate what the variant needs and copy the shared pages that are about to change first, so that running out
+	// of memory leaves chip8 as it was.
+	CHIP8Result result = CHIP8PrepareVariant(chip8, snapshot->variant);
+	if (result != CHIP8_SUCCESS) {
+		return result;
+	}
+
+	for (size_t p = 0; p < numPages; ++p) {
+		const uint8_t *data = p < snapshot->numPages ? snapshot->pages[p]->data : CHIP8SnapshotZeroPage;
+
+		result = CHIP8PrepareWrite(chip8, p * CHIP8_SNAPSHOT_PAGE_SIZE, data, CHIP8_SNAPSHOT_PAGE_SIZE);
+		if (result != CHIP8_SUCCESS) {
+			return result;
+		}
+	}
+
+	memcpy(chip8->stack, snapshot->stack, sizeof(chip8->stack));
+	memcpy(chip8->v, snapshot->v, sizeof(chip8->v));
+	chip8->i = snapshot->i;
+	chip8->pc = snapshot->pc;
+	chip8->sp = snapshot->sp;
+	chip8->dt = snapshot->dt;
+	chip8->st = snapshot->st;
+	memcpy(chip8->keyboard, snapshot->keyboard, sizeof(chip8->keyboard));
+	chip8->random = snapshot->random;
+
+	chip8->hires = snapshot->hires;
+	chip8->planes = snapshot->planes;
+	memcpy(chip8->flags, snapshot->flags, sizeof(chip8->flags));
+	memcpy(chip8->pattern, snapshot->pattern, sizeof(chip8->pattern));
+	chip8->pitch = snapshot->pitch;
+
+	chip8->variant = snapshot->variant;
+	chip8->memorySize = (uint32_t) (snapshot->numPages * CHIP8_SNAPSHOT_PAGE_SIZE);
+	CHIP8WriteDisplay(chip8, snapshot->display);
+
+	// CHIP8WriteMemory leaves identical pages alone, so their decoded and compiled code survives.
+	// It cannot fail now that every page it changes is private.
+	for (size_t p = 0; p < numPages; ++p) {
+		const uint8_t *data = p < snapshot->numPages ? snapshot->pages[p]->data : CHIP8SnapshotZeroPage;
+
+		CHIP8WriteMemory(chip8, p * CHIP8_SNAPSHOT_PAGE_SIZE, data, CHIP8_SNAPSHOT_PAGE_SIZE);
+	}
+
+	return CHIP8_SUCCESS;
+}
+
+void CHIP8SnapshotDestroy(CHIP8Snapshot *snapshot) {
+	for (size_t p = 0; p < snapshot->numPages; ++p) {
+		CHIP8SnapshotRelease(snapshot->pages[p]);
+	}
+
+	free(snapshot);
+}
+
+size_t CHIP8SnapshotUniquePages(const CHIP8Snapshot *snapshot) {
+	size_t uniquePages = 0;
+
+	for (size_t p = 0; p < snapshot->numPages; ++p) {
+		uniquePages += atomic_load_explicit(&snapshot->pages[p]->references, memory_order_relaxed) == 1;
+	}
+
+	return uniquePages;
+}
+
+void CHIP8SnapshotRelease(CHIP8SnapshotPage *page) {
+	if (atomic_fetch_sub_explicit(&page->references, 1, memory_order_acq_rel) == 1) {
+		free(page);
+	}
+}
@@ -0,0 +1,234 @@
+#include <core/chip8_thread.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHIP8_THREAD_CACHE_LINE 64
+#define CHIP8_THREAD_NUM_FRAMES 3
+// Set in the shared frame index when the writer has published since the reader last swapped.
+#define CHIP8_THREAD_FRAME_NEW 0x4
+
+typedef struct {
+	uint8_t key;
+	uint8_t state;
+} CHIP8InputEvent;
+
+struct CHIP8Thread {
+	CHIP8 *chip8;
+	CHIP8Scheduler scheduler;
+	uint32_t instructionsPerFrame;
+
+	CHIP8Rewind *rewind;
+	atomic_bool rewinding;
+
+	CHIP8MovieRecorder *recorder;
+
+	CHIP8Audio *audio;
+
+	CHIP8FrameCallback onFrame;
+	void *context;
+
+	pthread_t thread;
+	atomic_bool quit;
+
+	// Input: the UI thread writes events and advances tail, the emulation thread advances head.
+	CHIP8InputEvent inputs[CHIP8_THREAD_INPUT_QUEUE_SIZE];
+	_Atomic size_t inputTail;
+	char inputTailPadding[CHIP8_THREAD_CACHE_LINE - sizeof(size_t)];
+	_Atomic size_t inputHead;
+	char inputHeadPadding[CHIP8_THREAD_CACHE_LINE - sizeof(size_t)];
+
+	// Triple buffer: the writer owns frames[backFrame], the reader owns frames[frontFrame],
+	// and the two swap their slot with sharedFrame.
+	CHIP8Frame frames[CHIP8_THREAD_NUM_FRAMES];
+	uint64_t sequence;
+	uint32_t backFrame;
+	_Atomic uint32_t sharedFrame;
+	uint32_t frontFrame;
+};
+
+static void *CHIP8ThreadMain(void *parameter);
+static void CHIP8ThreadApplyInputs(CHIP8Thread *thread);
+static void CHIP8ThreadPublish(CHIP8Thread *thread, CHIP8Result result, double now);
+static double CHIP8ThreadNow();
+static void CHIP8ThreadSleepUntil(double deadline);
+
+CHIP8Thread *CHIP8ThreadStart(CHIP8 *chip8, uint32_t instructionsPerFrame, CHIP8Rewind *rewind, CHIP8MovieRecorder *recorder, CHIP8Audio *audio, CHIP8FrameCallback onFrame, void *context) {
+	CHIP8Thread *thread = (CHIP8Thread *) malloc(sizeof(CHIP8Thread));
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	memset(thread, 0, sizeof(CHIP8Thread));
+
+	thread->chip8 = chip8;
+	thread->instructionsPerFrame = instructionsPerFrame;
+	thread->rewind = rewind;
+	thread->recorder = recorder;
+	thread->audio = audio;
+	thread->onFrame = onFrame;
+	thread->context = context;
+
+	atomic_init(&thread->quit, false);
+	atomic_init(&thread->rewinding, false);
+	atomic_init(&thread->inputTail, 0);
+	atomic_init(&thread->inputHead, 0);
+
+	thread->frontFrame = 0;
+	atomic_init(&thread->sharedFrame, 1);
+	thread->backFrame = 2;
+
+	if (pthread_create(&thread->thread, NULL, CHIP8ThreadMain, thread) != 0) {
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void CHIP8ThreadStop(CHIP8Thread *thread) {
+	atomic_store(&thread->quit, true);
+	pthread_join(thread->thread, NULL);
+}
+
+void CHIP8ThreadDestroy(CHIP8Thread *thread) {
+	free(thread);
+}
+
+bool CHIP8ThreadPushKey(CHIP8Thread *thread, uint8_t key, CHIP8Key state) {
+	size_t tail = atomic_load_explicit(&thread->inputTail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&thread->inputHead, memory_order_acquire);
+
+	if (tail - head == CHIP8_THREAD_INPUT_QUEUE_SIZE) {
+		return false;
+	}
+
+	CHIP8InputEvent *event = &thread->inputs[tail & (CHIP8_THREAD_INPUT_QUEUE_SIZE - 1)];
+	event->key = key;
+	event->state = (uint8_t) state;
+
+	atomic_store_explicit(&thread->inputTail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+void CHIP8ThreadSetRewinding(CHIP8Thread *thread, bool rewinding) {
+	atomic_store(&thread->rewinding, rewinding);
+}
+
+bool CHIP8ThreadReadFrame(CHIP8Thread *thread, const CHIP8Frame **frame) {
+	bool isNew = (atomic_load_explicit(&thread->sharedFrame, memory_order_relaxed) & CHIP8_THREAD_FRAME_NEW) != 0;
+
+	if (isNew) {
+		uint32_t shared = atomic_exchange_explicit(&thread->sharedFrame, thread->frontFrame, memory_order_acq_rel);
+		thread->frontFrame = shared & ~CHIP8_THREAD_FRAME_NEW;
+	}
+
+	*frame = &thread->frames[thread->frontFrame];
+
+	return isNew;
+}
+
+void *CHIP8ThreadMain(void *parameter) {
+	CHIP8Thread *thread = (CHIP8Thread *) parameter;
+
+	CHIP8SchedulerInit(&thread->scheduler, thread->chip8, thread->instructionsPerFrame, CHIP8ThreadNow());
+
+	while (!atomic_load(&thread->quit)) {
+		CHIP8ThreadApplyInputs(thread);
+
+		double now = CHIP8ThreadNow();
+
+		uint32_t framesRun = 0;
+		CHIP8Result result = CHIP8_SUCCESS;
+
+		// A movie has to stay one linear run, so there is no going back while recording.
+		if (thread->rewind != NULL && thread->recorder == NULL && atomic_load(&thread->rewinding)) {
+			uint32_t framesDue = CHIP8SchedulerHold(&thread->scheduler, thread->chip8, now);
+
+			for (uint32_t f = 0; f < framesDue && CHIP8RewindStepBack(thread->rewind, thread->chip8); ++f) {
+				++framesRun;
+			}
+		} else {
+			result = CHIP8SchedulerUpdate(&thread->scheduler, thread->chip8, now, &framesRun);
+
+			if (result == CHIP8_SUCCESS && framesRun > 0 && thread->rewind != NULL) {
+				result = CHIP8RewindPush(thread->rewind, thread->chip8);
+			}
+		}
+
+		// Only st after the last frame is known, but the audio only plays the newest frame anyway.
+		if (thread->audio != NULL && result == CHIP8_SUCCESS) {
+			for (uint32_t f = 0; f < framesRun && CHIP8AudioPushFrame(thread->audio, thread->chip8->st > 0); ++f) {
+			}
+		}
+
+		if (framesRun > 0 || result != CHIP8_SUCCESS) {
+			CHIP8ThreadPublish(thread, result, now);
+		}
+
+		if (result != CHIP8_SUCCESS) {
+			break;
+		}
+
+		CHIP8ThreadSleepUntil(CHIP8SchedulerNextDeadline(&thread->scheduler));
+	}
+
+	return NULL;
+}
+
+void CHIP8ThreadApplyInputs(CHIP8Thread *thread) {
+	size_t head = atomic_load_explicit(&thread->inputHead, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&thread->inputTail, memory_order_acquire);
+
+	for (; head != tail; ++head) {
+		CHIP8InputEvent *event = &thread->inputs[head & (CHIP8_THREAD_INPUT_QUEUE_SIZE - 1)];
+		uint8_t key = event->key & 0xF;
+
+		if (thread->recorder != NULL && thread->chip8->keyboard[key] != event->state) {
+			CHIP8MovieRecorderKey(thread->recorder, thread->scheduler.frames, key, (CHIP8Key) event->state);
+		}
+
+		thread->chip8->keyboard[key] = event->state;
+	}
+
+	atomic_store_explicit(&thread->inputHead, head, memory_order_release);
+}
+
+void CHIP8ThreadPublish(CHIP8Thread *thread, CHIP8Result result, double now) {
+	CHIP8Frame *frame = &thread->frames[thread->backFrame];
+
+	CHIP8ReadDisplay(thread->chip8, frame->display);
+	frame->hires = thread->chip8->hires;
+	frame->dirtyRows = CHIP8TakeDirtyRows(thread->chip8);
+	frame->sequence = ++thread->sequence;
+	frame->st = thread->chip8->st;
+	frame->result = result;
+	CHIP8SchedulerGetMetrics(&thread->scheduler, thread->chip8, now, &frame->metrics);
+
+	uint32_t shared = atomic_exchange_explicit(&thread->sharedFrame, thread->backFrame | CHIP8_THREAD_FRAME_NEW, memory_order_acq_rel);
+	thread->backFrame = shared & ~CHIP8_THREAD_FRAME_NEW;
+
+	if (thread->onFrame != NULL) {
+		thread->onFrame(thread->context);
+	}
+}
+
+double CHIP8ThreadNow() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void CHIP8ThreadSleepUntil(double deadline) {
+	double remaining = deadline - CHIP8ThreadNow();
+	if (remaining <= 0) {
+		return;
+	}
+
+	struct timespec duration = { (time_t) remaining, (long) ((remaining - (time_t) remaining) * 1e9) };
+	nanosleep(&duration, NULL);
+}
@@ -0,0 +1,278 @@
+#include <core/chip8_trace.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP8_TRACE_MAGIC "C8TR"
+#define CHIP8_TRACE_VERSION 1
+#define CHIP8_TRACE_HEADER_SIZE 16
+#define CHIP8_TRACE_RECORD_SIZE 16
+
+struct CHIP8Trace {
+	// Each record packed into two words, so that a reader racing the writer
+	// sees torn records rather than undefined behaviour, and can drop them.
+	_Atomic uint64_t (*slots)[2];
+	size_t mask;
+
+	// Records pushed so far; the newest is at (head - 1) & mask.
+	_Atomic uint64_t head;
+};
+
+static void CHIP8TraceStore(CHIP8Trace *trace, uint64_t word0, uint64_t word1);
+static uint64_t CHIP8TracePackWord(uint16_t pc, uint16_t opcode, uint16_t changedV, uint8_t changed, int8_t result);
+static void CHIP8TracePack(const CHIP8TraceRecord *record, uint64_t words[2]);
+static void CHIP8TraceUnpack(const uint64_t words[2], CHIP8TraceRecord *record);
+static void CHIP8TracePutInteger(FILE *file, uint64_t value, size_t size);
+static uint64_t CHIP8TraceGetInteger(const uint8_t *in, size_t size);
+
+CHIP8Trace *CHIP8TraceInit(size_t capacity) {
+	if (capacity == 0) {
+		return NULL;
+	}
+
+	size_t slots = 1;
+	while (slots < capacity) {
+		slots <<= 1;
+	}
+
+	CHIP8Trace *trace = (CHIP8Trace *) malloc(sizeof(CHIP8Trace));
+	if (trace == NULL) {
+		return NULL;
+	}
+
+	trace->slots = malloc(slots * sizeof(trace->slots[0]));
+	if (trace->slots == NULL) {
+		free(trace);
+		return NULL;
+	}
+
+	trace->mask = slots - 1;
+	atomic_init(&trace->head, 0);
+
+	return trace;
+}
+
+void CHIP8TraceDestroy(CHIP8Trace *trace) {
+	free(trace->slots);
+	free(trace);
+}
+
+void CHIP8TracePush(CHIP8Trace *trace, const CHIP8TraceRecord *record) {
+	uint64_t words[2];
+	CHIP8TracePack(record, words);
+
+	CHIP8TraceStore(trace, words[0], words[1]);
+}
+
+CHIP8Result CHIP8TraceExecute(CHIP8Trace *trace, CHIP8 *chip8, const CHIP8Instruction *instruction) {
+	uint64_t cycle = chip8->cycles;
+	uint16_t pc = chip8->pc;
+	uint16_t opcode = (uint16_t) (CHIP8ReadByte(chip8, pc) << 8 | CHIP8ReadByte(chip8, pc + 1));
+
+	uint8_t v[CHIP8_NUM_V_REGISTERS];
+	memcpy(v, chip8->v, sizeof(v));
+	uint16_t i = chip8->i;
+	uint8_t sp = chip8->sp;
+	uint8_t dt = chip8->dt;
+	uint8_t st = chip8->st;
+
+	chip8->pc += 2;
+	++chip8->cycles;
+
+	CHIP8Result result = instruction->handler(chip8, instruction);
+
+	// Byte by byte: the handler has only just stored to v, and wider loads would stall on that.
+	uint16_t changedV = 0;
+	for (size_t x = 0; x < CHIP8_NUM_V_REGISTERS; ++x) {
+		changedV |= (uint16_t) (chip8->v[x] != v[x]) << x;
+	}
+
+	uint8_t changed = 0;
+	changed |= chip8->i != i ? CHIP8_TRACE_CHANGED_I : 0;
+	changed |= chip8->sp != sp ? CHIP8_TRACE_CHANGED_SP : 0;
+	changed |= chip8->dt != dt ? CHIP8_TRACE_CHANGED_DT : 0;
+	changed |= chip8->st != st ? CHIP8_TRACE_CHANGED_ST : 0;
+
+	uint16_t fx = opcode & 0xF0FF;
+	if (result == CHIP8_SUCCESS && (fx == 0xF033 || fx == 0xF055 || instruction->op == CHIP8_OP_5XY2)) {
+		changed |= CHIP8_TRACE_CHANGED_MEMORY;
+	}
+	if (result == CHIP8_SUCCESS && (opcode == 0x00E0 || (opcode & 0xF000) == 0xD000)) {
+		changed |= CHIP8_TRACE_CHANGED_DISPLAY;
+	}
+	// Scrolls and resolution switches.
+	CHIP8Op op = instruction->op;
+	bool scrolled = op == CHIP8_OP_00CN || op == CHIP8_OP_00DN || op == CHIP8_OP_00FB || op == CHIP8_OP_00FC;
+	if (result == CHIP8_SUCCESS && (scrolled || op == CHIP8_OP_00FE || op == CHIP8_OP_00FF)) {
+		changed |= CHIP8_TRACE_CHANGED_DISPLAY;
+	}
+
+	// Packed straight from registers; going through a CHIP8TraceRecord on the stack costs a store forwarding stall.
+	CHIP8TraceStore(trace, cycle, CHIP8TracePackWord(pc, opcode, changedV, changed, (int8_t) result));
+
+	return result;
+}
+
+void CHIP8TraceClear(CHIP8Trace *trace) {
+	atomic_store_explicit(&trace->head, 0, memory_order_release);
+}
+
+size_t CHIP8TraceRead(const CHIP8Trace *trace, CHIP8TraceRecord *records, size_t maxRecords) {
+	uint64_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+	uint64_t capacity = trace->mask + 1;
+
+	uint64_t first = head > capacity ? head - capacity : 0;
+	if (head - first > maxRecords) {
+		first = head - maxRecords;
+	}
+
+	uint64_t words[2];
+	for (uint64_t r = first; r < head; ++r) {
+		_Atomic uint64_t *slot = trace->slots[r & trace->mask];
+
+		words[0] = atomic_load_explicit(&slot[0], memory_order_relaxed);
+		words[1] = atomic_load_explicit(&slot[1], memory_order_relaxed);
+		CHIP8TraceUnpack(words, &records[r - first]);
+	}
+
+	// Whatever the writer lapped while we copied may be torn, including the slot
+	// of the record it may be writing right now; keep only what it cannot have reached.
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t end = atomic_load_explicit(&trace->head, memory_order_relaxed);
+
+	uint64_t valid = end + 1 > capacity ? end + 1 - capacity : 0;
+	if (valid <= first) {
+		return (size_t) (head - first);
+	}
+	if (valid >= head) {
+		return 0;
+	}
+
+	memmove(records, &records[valid - first], (size_t) (head - valid) * sizeof(CHIP8TraceRecord));
+
+	return (size_t) (head - valid);
+}
+
+bool CHIP8TraceDump(const CHIP8Trace *trace, const char *fileName) {
+	size_t capacity = trace->mask + 1;
+
+	CHIP8TraceRecord *records = (CHIP8TraceRecord *) malloc(capacity * sizeof(CHIP8TraceRecord));
+	if (records == NULL) {
+		return false;
+	}
+
+	size_t numRecords = CHIP8TraceRead(trace, records, capacity);
+
+	FILE *file = fopen(fileName, "wb");
+	if (file == NULL) {
+		free(records);
+		return false;
+	}
+
+	fwrite(CHIP8_TRACE_MAGIC, 1, 4, file);
+	CHIP8TracePutInteger(file, CHIP8_TRACE_VERSION, 2);
+	CHIP8TracePutInteger(file, CHIP8_TRACE_RECORD_SIZE, 2);
+	CHIP8TracePutInteger(file, numRecords, 8);
+
+	for (size_t r = 0; r < numRecords; ++r) {
+		uint64_t words[2];
+		CHIP8TracePack(&records[r], words);
+
+		CHIP8TracePutInteger(file, words[0], 8);
+		CHIP8TracePutInteger(file, words[1], 8);
+	}
+
+	free(records);
+
+	bool written = !ferror(file);
+	written &= fclose(file) == 0;
+
+	return written;
+}
+
+CHIP8TraceRecord *CHIP8TraceLoad(const char *fileName, size_t *numRecords) {
+	FILE *file = fopen(fileName, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	uint8_t header[CHIP8_TRACE_HEADER_SIZE];
+	bool valid = fread(header, 1, sizeof(header), file) == sizeof(header);
+	valid = valid && memcmp(header, CHIP8_TRACE_MAGIC, 4) == 0;
+	valid = valid && CHIP8TraceGetInteger(header + 4, 2) == CHIP8_TRACE_VERSION;
+	valid = valid && CHIP8TraceGetInteger(header + 6, 2) == CHIP8_TRACE_RECORD_SIZE;
+
+	uint64_t count = valid ? CHIP8TraceGetInteger(header + 8, 8) : 0;
+	valid = valid && count <= SIZE_MAX / sizeof(CHIP8TraceRecord);
+
+	CHIP8TraceRecord *records = valid ? (CHIP8TraceRecord *) malloc((count > 0 ? count : 1) * sizeof(CHIP8TraceRecord)) : NULL;
+
+	for (uint64_t r = 0; records != NULL && r < count; ++r) {
+		uint8_t in[CHIP8_TRACE_RECORD_SIZE];
+		if (fread(in, 1, sizeof(in), file) != sizeof(in)) {
+			free(records);
+			records = NULL;
+			break;
+		}
+
+		uint64_t words[2] = { CHIP8TraceGetInteger(in, 8), CHIP8TraceGetInteger(in + 8, 8) };
+		CHIP8TraceUnpack(words, &records[r]);
+	}
+
+	fclose(file);
+
+	if (records != NULL) {
+		*numRecords = (size_t) count;
+	}
+
+	return records;
+}
+
+void CHIP8TraceStore(CHIP8Trace *trace, uint64_t word0, uint64_t word1) {
+	// Only this thread moves head, so it can be read without ordering.
+	uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+	_Atomic uint64_t *slot = trace->slots[head & trace->mask];
+
+	atomic_store_explicit(&slot[0], word0, memory_order_relaxed);
+	atomic_store_explicit(&slot[1], word1, memory_order_relaxed);
+	atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+uint64_t CHIP8TracePackWord(uint16_t pc, uint16_t opcode, uint16_t changedV, uint8_t changed, int8_t result) {
+	return (uint64_t) pc
+		| (uint64_t) opcode << 16
+		| (uint64_t) changedV << 32
+		| (uint64_t) changed << 48
+		| (uint64_t) (uint8_t) result << 56;
+}
+
+void CHIP8TracePack(const CHIP8TraceRecord *record, uint64_t words[2]) {
+	words[0] = record->cycle;
+	words[1] = CHIP8TracePackWord(record->pc, record->opcode, record->changedV, record->changed, record->result);
+}
+
+void CHIP8TraceUnpack(const uint64_t words[2], CHIP8TraceRecord *record) {
+	record->cycle = words[0];
+	record->pc = (uint16_t) words[1];
+	record->opcode = (uint16_t) (words[1] >> 16);
+	record->changedV = (uint16_t) (words[1] >> 32);
+	record->changed = (uint8_t) (words[1] >> 48);
+	record->result = (int8_t) (uint8_t) (words[1] >> 56);
+}
+
+void CHIP8TracePutInteger(FILE *file, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		fputc((int) ((value >> (8 * i)) & 0xFF), file);
+	}
+}
+
+uint64_t CHIP8TraceGetInteger(const uint8_t *in, size_t size) {
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; ++i) {
+		value |= (uint64_t) in[i] << (8 * i);
+	}
+
+	return value;
+}
@@ -1,26 +1,14 @@
 #define SDL_MAIN_HANDLED
 #include <core/app.h>
+#include <core/chip8_movie.h>
+#include <core/chip8_profile.h>
+#include <core/chip8_rewind.h>
+#include <core/chip8_scheduler.h>
+#include <core/chip8_trace.h>
 
 #include <stdio.h>
-
-static const uint8_t fontset[] = {
-	0xF0, 0x90, 0x90, 0x90, 0xF0,
-	0x20, 0x60, 0x20, 0x20, 0x70,
-	0xF0, 0x10, 0xF0, 0x80, 0xF0,
-	0xF0, 0x10, 0xF0, 0x10, 0xF0,
-	0x90, 0x90, 0xF0, 0x10, 0x10,
-	0xF0, 0x80, 0xF0, 0x10, 0xF0,
-	0xF0, 0x80, 0xF0, 0x90, 0xF0,
-	0xF0, 0x10, 0x20, 0x40, 0x40,
-	0xF0, 0x90, 0xF0, 0x90, 0xF0,
-	0xF0, 0x90, 0xF0, 0x10, 0xF0,
-	0xF0, 0x90, 0xF0, 0x90, 0x90,
-	0xE0, 0x90, 0xE0, 0x90, 0xE0, 
-	0xF0, 0x80, 0x80, 0x80, 0xF0,
-	0xE0, 0x90, 0x90, 0x90, 0xE0,
-	0xF0, 0x80, 0xF0, 0x80, 0xF0,
-	0xF0, 0x80, 0xF0, 0x80, 0x80
-};
+#include <string.h>
+#include <time.h>
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
@@ -35,30 +23,164 @@ int main(int argc, char *argv[]) {
     int windowWidth = (int) strtol(argv[2], NULL, 10);
     int windowHeight = (int) strtol(argv[3], NULL, 10);
 
-	CHIP8 *chip8 = CHIP8Init();
+	uint32_t instructionsPerFrame = CHIP8_SCHEDULER_DEFAULT_INSTRUCTIONS_PER_FRAME;
+	bool jit = false;
+	uint64_t seed = (uint64_t) time(NULL);
+	size_t rewindSeconds = 0;
+	size_t rewindBudget = CHIP8_REWIND_DEFAULT_BUDGET;
+	const char *movieFileName = NULL;
+	const char *traceFileName = NULL;
+	const char *profileFileName = NULL;
+	CHIP8Palette palette = { CHIP8_PALETTE_DEFAULT_FOREGROUND, CHIP8_PALETTE_DEFAULT_BACKGROUND, CHIP8_PALETTE_DEFAULT_SECONDARY, CHIP8_PALETTE_DEFAULT_OVERLAP };
+	bool fullscreen = false;
+	uint32_t toneFrequency = CHIP8_AUDIO_DEFAULT_FREQUENCY;
+	int variant = CHIP8_VARIANT_CHIP8;
+
+	for (int i = 4; i < argc; ++i) {
+		if (strcmp(argv[i], "--jit") == 0) {
+			jit = true;
+		} else if (strcmp(argv[i], "--fullscreen") == 0) {
+			fullscreen = true;
+		} else if (strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+			instructionsPerFrame = (uint32_t) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--rewind") == 0 && i + 1 < argc) {
+			rewindSeconds = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--rewind-budget") == 0 && i + 1 < argc) {
+			rewindBudget = strtoul(argv[++i], NULL, 10) * 1024;
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			movieFileName = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceFileName = argv[++i];
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profileFileName = argv[++i];
+		} else if (strcmp(argv[i], "--palette") == 0 && i + 2 < argc) {
+			// ARGB8888 in hex, e.g. FFFFFFFF FF000000 for white on black.
+			palette.foreground = (uint32_t) strtoul(argv[++i], NULL, 16);
+			palette.background = (uint32_t) strtoul(argv[++i], NULL, 16);
+		} else if (strcmp(argv[i], "--tone") == 0 && i + 1 < argc) {
+			// The buzzer's pitch in Hz; 0 mutes it.
+			toneFrequency = (uint32_t) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--variant") == 0 && i + 1 < argc) {
+			// chip8, schip or xochip.
+			++i;
+			for (variant = 0; variant < CHIP8_NUM_VARIANTS && strcmp(argv[i], CHIP8VariantNames[variant]) != 0; ++variant);
+
+			if (variant == CHIP8_NUM_VARIANTS) {
+				fprintf(stderr, "Error: Unknown variant %s.\n", argv[i]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (variant == CHIP8_VARIANT_XOCHIP && profileFileName != NULL) {
+		fprintf(stderr, "Error: XO-CHIP programs cannot be profiled.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	CHIP8 *chip8 = CHIP8Init(seed);
 	if (chip8 == NULL) {
-		fprintf(stderr, "Error: %s.\n", CHIP8GetError());
+		fprintf(stderr, "Error: %s.\n", CHIP8GetError(NULL));
+		exit(EXIT_FAILURE);
+	}
+
+	if (CHIP8LoadFontset(chip8, CHIP8Fontset, CHIP8_FONTSET_SIZE) != CHIP8_SUCCESS) {
+		fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
 		exit(EXIT_FAILURE);
 	}
 
-	if (CHIP8LoadFontset(chip8, fontset, sizeof(fontset)) != CHIP8_SUCCESS) {
-		fprintf(stderr, "Error: %s.\n", CHIP8GetError());
+	if (CHIP8SetVariant(chip8, (CHIP8Variant) variant) != CHIP8_SUCCESS) {
+		fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
 		exit(EXIT_FAILURE);
 	}
 
 	if (CHIP8LoadROM(chip8, argv[1]) != CHIP8_SUCCESS) {
-		fprintf(stderr, "Error: %s.\n", CHIP8GetError());
+		fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
+		exit(EXIT_FAILURE);
+	}
+
+	if (jit && CHIP8SetMode(chip8, CHIP8_MODE_JIT) != CHIP8_SUCCESS) {
+		fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
 		exit(EXIT_FAILURE);
 	}
 
-	App *app = AppInit(windowWidth, windowHeight);
+	CHIP8Rewind *rewind = NULL;
+	if (rewindSeconds > 0) {
+		rewind = CHIP8RewindInit(rewindSeconds * CHIP8_SCHEDULER_FRAME_RATE, rewindBudget);
+		if (rewind == NULL) {
+			fprintf(stderr, "Error: Cannot allocate the rewind buffer.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	CHIP8Trace *trace = NULL;
+	if (traceFileName != NULL) {
+		trace = CHIP8TraceInit(CHIP8_TRACE_DEFAULT_CAPACITY);
+		if (trace == NULL) {
+			fprintf(stderr, "Error: Cannot allocate the trace.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (jit) {
+			printf("The JIT is bypassed while tracing.\n");
+		}
+	}
+
+	CHIP8Profile *profile = NULL;
+	if (profileFileName != NULL) {
+		profile = CHIP8ProfileInit(CHIP8_PROFILE_DEFAULT_SAMPLE_PERIOD);
+		if (profile == NULL) {
+			fprintf(stderr, "Error: Cannot allocate the profile.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (jit) {
+			printf("The JIT is bypassed while profiling.\n");
+		}
+		if (CHIP8SetProfile(chip8, profile) != CHIP8_SUCCESS) {
+			fprintf(stderr, "Error: %s.\n", CHIP8GetError(chip8));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Created last so that the movie starts from the state the emulation thread gets.
+	CHIP8MovieRecorder *recorder = NULL;
+	if (movieFileName != NULL) {
+		recorder = CHIP8MovieRecorderInit(movieFileName, chip8, seed, instructionsPerFrame);
+		if (recorder == NULL) {
+			fprintf(stderr, "Error: Cannot create movie %s.\n", movieFileName);
+			exit(EXIT_FAILURE);
+		}
+		if (rewind != NULL) {
+			printf("Rewind is disabled while recording.\n");
+		}
+	}
+
+	printf("Random seed %llu.\n", (unsigned long long) seed);
+
+	App *app = AppInit(windowWidth, windowHeight, fullscreen, &palette, toneFrequency);
 	if (app == NULL) {
 		fprintf(stderr, "Error: %s.\n", SDL_GetError());
 		exit(EXIT_FAILURE);
 	}
 
-    AppLoop(app, chip8);
+    AppLoop(app, chip8, instructionsPerFrame, rewind, recorder, trace, traceFileName);
 
 	AppDestroy(app);
+	if (profile != NULL) {
+		// The heatmap goes next to the report, as <file>.ppm.
+		char heatmapFileName[FILENAME_MAX];
+		snprintf(heatmapFileName, sizeof(heatmapFileName), "%s.ppm", profileFileName);
+
+		if (!CHIP8ProfileWriteReport(profile, chip8, profileFileName, CHIP8_PROFILE_DEFAULT_TOP) || !CHIP8ProfileWriteHeatmap(profile, heatmapFileName, 8)) {
+			fprintf(stderr, "Error: Cannot write the profile.\n");
+		}
+		CHIP8ProfileDestroy(profile);
+	}
+	if (rewind != NULL) {
+		CHIP8RewindDestroy(rewind);
+	}
+	if (trace != NULL) {
+		CHIP8TraceDestroy(trace);
+	}
 	CHIP8Destroy(chip8);
 }
\ No newline at end of file
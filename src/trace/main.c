@@ -0,0 +1,246 @@
+#include <core/chip8_trace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void TraceUsage(const char *program);
+static void TraceDisassemble(uint16_t opcode, char *text, size_t size);
+static void TraceChanges(const CHIP8TraceRecord *record, char *text, size_t size);
+static const char *TraceResultName(int8_t result);
+
+int main(int argc, char *argv[]) {
+	const char *fileName = NULL;
+	size_t last = SIZE_MAX;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--last") == 0 && i + 1 < argc) {
+			last = strtoul(argv[++i], NULL, 10);
+		} else if (argv[i][0] == '-') {
+			TraceUsage(argv[0]);
+			exit(EXIT_FAILURE);
+		} else {
+			fileName = argv[i];
+		}
+	}
+
+	if (fileName == NULL) {
+		TraceUsage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t numRecords;
+	CHIP8TraceRecord *records = CHIP8TraceLoad(fileName, &numRecords);
+	if (records == NULL) {
+		fprintf(stderr, "Error: %s is not a readable trace.\n", fileName);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t first = numRecords > last ? numRecords - last : 0;
+
+	printf("cycle\tpc\topcode\tinstruction\tchanged\tresult\n");
+	for (size_t r = first; r < numRecords; ++r) {
+		const CHIP8TraceRecord *record = &records[r];
+
+		char instruction[32];
+		TraceDisassemble(record->opcode, instruction, sizeof(instruction));
+
+		char changes[96];
+		TraceChanges(record, changes, sizeof(changes));
+
+		printf(
+			"%llu\t%03x\t%04x\t%s\t%s\t%s\n",
+			(unsigned long long) record->cycle,
+			record->pc,
+			record->opcode,
+			instruction,
+			changes,
+			TraceResultName(record->result)
+		);
+	}
+
+	free(records);
+
+	return EXIT_SUCCESS;
+}
+
+void TraceUsage(const char *program) {
+	fprintf(
+		stderr,
+		"Usage: %s [options] <trace>\n"
+		"  --last <n>            only decode the newest <n> records\n",
+		program
+	);
+}
+
+// Cowgod's mnemonics.
+void TraceDisassemble(uint16_t opcode, char *text, size_t size) {
+	unsigned x = (opcode >> 8) & 0xF;
+	unsigned y = (opcode >> 4) & 0xF;
+	unsigned n = opcode & 0xF;
+	unsigned kk = opcode & 0xFF;
+	unsigned nnn = opcode & 0xFFF;
+
+	static const char *alu[16] = {
+		"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+		NULL, NULL, NULL, NULL, NULL, NULL, "SHL", NULL
+	};
+
+	switch (opcode >> 12) {
+		case 0x0:
+			if (opcode == 0x00E0) {
+				snprintf(text, size, "CLS");
+				return;
+			}
+			if (opcode == 0x00EE) {
+				snprintf(text, size, "RET");
+				return;
+			}
+			break;
+		case 0x1:
+			snprintf(text, size, "JP %03x", nnn);
+			return;
+		case 0x2:
+			snprintf(text, size, "CALL %03x", nnn);
+			return;
+		case 0x3:
+			snprintf(text, size, "SE V%X, %02x", x, kk);
+			return;
+		case 0x4:
+			snprintf(text, size, "SNE V%X, %02x", x, kk);
+			return;
+		case 0x5:
+			if (n == 0) {
+				snprintf(text, size, "SE V%X, V%X", x, y);
+				return;
+			}
+			break;
+		case 0x6:
+			snprintf(text, size, "LD V%X, %02x", x, kk);
+			return;
+		case 0x7:
+			snprintf(text, size, "ADD V%X, %02x", x, kk);
+			return;
+		case 0x8:
+			if (alu[n] != NULL) {
+				snprintf(text, size, "%s V%X, V%X", alu[n], x, y);
+				return;
+			}
+			break;
+		case 0x9:
+			if (n == 0) {
+				snprintf(text, size, "SNE V%X, V%X", x, y);
+				return;
+			}
+			break;
+		case 0xA:
+			snprintf(text, size, "LD I, %03x", nnn);
+			return;
+		case 0xB:
+			snprintf(text, size, "JP V0, %03x", nnn);
+			return;
+		case 0xC:
+			snprintf(text, size, "RND V%X, %02x", x, kk);
+			return;
+		case 0xD:
+			snprintf(text, size, "DRW V%X, V%X, %X", x, y, n);
+			return;
+		case 0xE:
+			if (kk == 0x9E) {
+				snprintf(text, size, "SKP V%X", x);
+				return;
+			}
+			if (kk == 0xA1) {
+				snprintf(text, size, "SKNP V%X", x);
+				return;
+			}
+			break;
+		case 0xF:
+			switch (kk) {
+				case 0x07:
+					snprintf(text, size, "LD V%X, DT", x);
+					return;
+				case 0x0A:
+					snprintf(text, size, "LD V%X, K", x);
+					return;
+				case 0x15:
+					snprintf(text, size, "LD DT, V%X", x);
+					return;
+				case 0x18:
+					snprintf(text, size, "LD ST, V%X", x);
+					return;
+				case 0x1E:
+					snprintf(text, size, "ADD I, V%X", x);
+					return;
+				case 0x29:
+					snprintf(text, size, "LD F, V%X", x);
+					return;
+				case 0x33:
+					snprintf(text, size, "LD B, V%X", x);
+					return;
+				case 0x55:
+					snprintf(text, size, "LD [I], V%X", x);
+					return;
+				case 0x65:
+					snprintf(text, size, "LD V%X, [I]", x);
+					return;
+			}
+			break;
+	}
+
+	snprintf(text, size, "???");
+}
+
+void TraceChanges(const CHIP8TraceRecord *record, char *text, size_t size) {
+	static const struct {
+		uint8_t flag;
+		const char *name;
+	} flags[] = {
+		{ CHIP8_TRACE_CHANGED_I, "I" },
+		{ CHIP8_TRACE_CHANGED_SP, "SP" },
+		{ CHIP8_TRACE_CHANGED_DT, "DT" },
+		{ CHIP8_TRACE_CHANGED_ST, "ST" },
+		{ CHIP8_TRACE_CHANGED_MEMORY, "memory" },
+		{ CHIP8_TRACE_CHANGED_DISPLAY, "display" }
+	};
+
+	size_t length = 0;
+	text[0] = '\0';
+
+	for (unsigned x = 0; x < CHIP8_NUM_V_REGISTERS; ++x) {
+		if ((record->changedV >> x & 1) != 0 && length < size) {
+			length += (size_t) snprintf(text + length, size - length, "%sV%X", length > 0 ? "," : "", x);
+		}
+	}
+
+	for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+		if ((record->changed & flags[f].flag) != 0 && length < size) {
+			length += (size_t) snprintf(text + length, size - length, "%s%s", length > 0 ? "," : "", flags[f].name);
+		}
+	}
+
+	if (length == 0) {
+		snprintf(text, size, "-");
+	}
+}
+
+const char *TraceResultName(int8_t result) {
+	switch (result) {
+		case CHIP8_SUCCESS:
+			return "ok";
+		case CHIP8_ERROR_SEGFAULT:
+			return "segfault";
+		case CHIP8_ERROR_STACK_UNDERFLOW:
+			return "stack-underflow";
+		case CHIP8_ERROR_STACK_OVERFLOW:
+			return "stack-overflow";
+		case CHIP8_ERROR_KEY_NOT_FOUND:
+			return "key-not-found";
+		case CHIP8_ERROR_INSTRUCTION_NOT_FOUND:
+			return "instruction-not-found";
+		case CHIP8_ERROR_OUT_OF_MEMORY:
+			return "out-of-memory";
+		default:
+			return "error";
+	}
+}
@@ -0,0 +1,235 @@
+#include <utils/thread_pool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define THREAD_POOL_CACHE_LINE 64
+
+// A worker's pending indices [begin, end), packed as (begin << 32 | end) so a single CAS can take or split them.
+// Padded so that no two workers' ranges share a cache line.
+typedef struct {
+	_Atomic uint64_t range;
+	char padding[THREAD_POOL_CACHE_LINE - sizeof(uint64_t)];
+} ThreadPoolWorker;
+
+typedef struct {
+	ThreadPool *pool;
+	size_t index;
+} ThreadPoolThread;
+
+struct ThreadPool {
+	size_t numThreads;
+	pthread_t *threads;
+	ThreadPoolThread *threadParameters;
+	ThreadPoolWorker *workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t startCondition;
+	pthread_cond_t doneCondition;
+	uint64_t generation;
+	size_t running;
+	bool quit;
+
+	ThreadPoolTask task;
+	void *context;
+};
+
+static void *threadPoolMain(void *parameter);
+static void threadPoolWork(ThreadPool *pool, size_t worker);
+static bool threadPoolTake(ThreadPoolWorker *worker, size_t *index);
+static bool threadPoolSteal(ThreadPool *pool, size_t thief, size_t *index);
+
+static uint64_t threadPoolPack(uint32_t begin, uint32_t end) {
+	return (uint64_t) begin << 32 | end;
+}
+
+ThreadPool *threadPoolInit(size_t numThreads) {
+	if (numThreads == 0) {
+		#ifdef _WIN32
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		numThreads = systemInfo.dwNumberOfProcessors;
+		#else
+		long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads = numCores > 0 ? (size_t) numCores : 1;
+		#endif
+	}
+
+	ThreadPool *pool = (ThreadPool *) malloc(sizeof(ThreadPool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->numThreads = numThreads;
+	pool->threads = (pthread_t *) malloc(numThreads * sizeof(pthread_t));
+	pool->threadParameters = (ThreadPoolThread *) malloc(numThreads * sizeof(ThreadPoolThread));
+	pool->workers = (ThreadPoolWorker *) malloc(numThreads * sizeof(ThreadPoolWorker));
+
+	if (pool->threads == NULL || pool->threadParameters == NULL || pool->workers == NULL) {
+		free(pool->threads);
+		free(pool->threadParameters);
+		free(pool->workers);
+		free(pool);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < numThreads; ++i) {
+		atomic_init(&pool->workers[i].range, 0);
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->startCondition, NULL);
+	pthread_cond_init(&pool->doneCondition, NULL);
+	pool->generation = 0;
+	pool->running = 0;
+	pool->quit = false;
+
+	// Worker 0 is whichever thread calls threadPoolRun.
+	for (size_t i = 1; i < numThreads; ++i) {
+		pool->threadParameters[i].pool = pool;
+		pool->threadParameters[i].index = i;
+		pthread_create(&pool->threads[i], NULL, threadPoolMain, &pool->threadParameters[i]);
+	}
+
+	return pool;
+}
+
+void threadPoolDestroy(ThreadPool *pool) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->startCondition);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 1; i < pool->numThreads; ++i) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->startCondition);
+	pthread_cond_destroy(&pool->doneCondition);
+
+	free(pool->threads);
+	free(pool->threadParameters);
+	free(pool->workers);
+	free(pool);
+}
+
+size_t threadPoolSize(const ThreadPool *pool) {
+	return pool->numThreads;
+}
+
+void threadPoolRun(ThreadPool *pool, size_t count, ThreadPoolTask task, void *context) {
+	// Start with an even split; stealing evens out instances that run longer than others.
+	for (size_t i = 0; i < pool->numThreads; ++i) {
+		uint32_t begin = (uint32_t) (count * i / pool->numThreads);
+		uint32_t end = (uint32_t) (count * (i + 1) / pool->numThreads);
+		atomic_store(&pool->workers[i].range, threadPoolPack(begin, end));
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->context = context;
+	pool->running = pool->numThreads - 1;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->startCondition);
+	pthread_mutex_unlock(&pool->mutex);
+
+	threadPoolWork(pool, 0);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->running > 0) {
+		pthread_cond_wait(&pool->doneCondition, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void *threadPoolMain(void *parameter) {
+	ThreadPoolThread *thread = (ThreadPoolThread *) parameter;
+	ThreadPool *pool = thread->pool;
+	uint64_t generation = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->mutex);
+		while (!pool->quit && pool->generation == generation) {
+			pthread_cond_wait(&pool->startCondition, &pool->mutex);
+		}
+
+		if (pool->quit) {
+			pthread_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		threadPoolWork(pool, thread->index);
+
+		pthread_mutex_lock(&pool->mutex);
+		--pool->running;
+		if (pool->running == 0) {
+			pthread_cond_signal(&pool->doneCondition);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
+
+void threadPoolWork(ThreadPool *pool, size_t worker) {
+	size_t index;
+
+	while (threadPoolTake(&pool->workers[worker], &index) || threadPoolSteal(pool, worker, &index)) {
+		pool->task(pool->context, index, worker);
+	}
+}
+
+bool threadPoolTake(ThreadPoolWorker *worker, size_t *index) {
+	uint64_t range = atomic_load(&worker->range);
+
+	for (;;) {
+		uint32_t begin = (uint32_t) (range >> 32);
+		uint32_t end = (uint32_t) range;
+
+		if (begin >= end) {
+			return false;
+		}
+
+		if (atomic_compare_exchange_weak(&worker->range, &range, threadPoolPack(begin + 1, end))) {
+			*index = begin;
+			return true;
+		}
+	}
+}
+
+bool threadPoolSteal(ThreadPool *pool, size_t thief, size_t *index) {
+	for (size_t i = 1; i < pool->numThreads; ++i) {
+		ThreadPoolWorker *victim = &pool->workers[(thief + i) % pool->numThreads];
+		uint64_t range = atomic_load(&victim->range);
+
+		for (;;) {
+			uint32_t begin = (uint32_t) (range >> 32);
+			uint32_t end = (uint32_t) range;
+
+			if (begin >= end) {
+				break;
+			}
+
+			// The victim keeps [begin, middle), the thief takes [middle, end).
+			uint32_t middle = begin + (end - begin) / 2;
+
+			if (atomic_compare_exchange_weak(&victim->range, &range, threadPoolPack(begin, middle))) {
+				atomic_store(&pool->workers[thief].range, threadPoolPack(middle + 1, end));
+				*index = middle;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}